@@ -0,0 +1,458 @@
+/* See LICENSE file for license and copyright information */
+
+#define _XOPEN_SOURCE 500
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <girara/datastructures.h>
+
+#include "database.h"
+
+#ifdef WITH_SQLITE
+#define BACKEND "sqlite"
+#else
+#define BACKEND "plain"
+#endif
+
+/* history sizes that are benchmarked if none are given */
+static const unsigned int DEFAULT_SIZES[] = { 10000, 100000, 500000, 1000000 };
+
+/* number of revisits of already known urls */
+#define REVISITS 10000
+/* every nth history entry is bookmarked as well */
+#define BOOKMARK_RATIO 100
+/* number of runs of each completion query */
+#define QUERY_RUNS 20
+/* number of runs of each prefetch query, which scans all links */
+#define PREFETCH_RUNS 5
+/* number of links that are streamed per query, as completion asks for */
+#define MATCH_LIMIT 100
+/* number of tabs of the benchmarked session */
+#define SESSION_TABS 50
+/* number of saves and loads of the session */
+#define SESSION_RUNS 100
+/* number of history cleans */
+#define CLEAN_RUNS 10
+
+/* completion inputs from matching everything to matching nothing */
+static const char* const QUERIES[] = {
+  "example",
+  "site1",
+  "site12345.",
+  "topic 999",
+  "si",
+  "sxmpl",
+  "nomatch"
+};
+
+/* forward declarations */
+static double bench_now(void);
+static int bench_compare_samples(const void* first, const void* second);
+static void bench_report(unsigned int size, const char* name, GArray* samples,
+    double seconds);
+static long bench_rss(void);
+static void bench_url(char* buffer, size_t length, unsigned int index);
+static bool bench_count_link(const char* url, const char* title, int visited,
+    void* data);
+static void bench_count_results(girara_list_t* results, void* data);
+static void bench_remove_dir(const char* path);
+static int bench_startup(const char* dir);
+static void bench_size(const char* program, unsigned int size);
+
+int
+main(int argc, char* argv[])
+{
+  /* child process that measures a cold start */
+  if (argc == 3 && strcmp(argv[1], "--startup") == 0) {
+    return bench_startup(argv[2]);
+  }
+
+  printf("%-7s %8s %-22s %12s %10s %10s\n", "backend", "size", "operation",
+      "ops/s", "p50 us", "p99 us");
+
+  if (argc > 1) {
+    for (int i = 1; i < argc; i++) {
+      bench_size(argv[0], strtoul(argv[i], NULL, 10));
+    }
+  } else {
+    for (unsigned int i = 0; i < G_N_ELEMENTS(DEFAULT_SIZES); i++) {
+      bench_size(argv[0], DEFAULT_SIZES[i]);
+    }
+  }
+
+  return 0;
+}
+
+static void
+bench_size(const char* program, unsigned int size)
+{
+  if (size == 0) {
+    return;
+  }
+
+  char* dir = g_dir_make_tmp("jumanji-bench-XXXXXX", NULL);
+  if (dir == NULL) {
+    fprintf(stderr, "Could not create a temporary directory\n");
+    return;
+  }
+
+  char* sessions = g_build_filename(dir, "sessions", NULL);
+  g_mkdir(sessions, 0700);
+  g_free(sessions);
+
+  jumanji_database_t* database = jumanji_db_init(dir);
+  if (database == NULL) {
+    fprintf(stderr, "Could not open the database in %s\n", dir);
+    goto error_free;
+  }
+
+  char url[128];
+  char title[128];
+  GArray* samples = g_array_sized_new(FALSE, FALSE, sizeof(double), size);
+
+  /* browsing new pages, the synchronous find waits until all are written */
+  double start = bench_now();
+  for (unsigned int i = 0; i < size; i++) {
+    bench_url(url, sizeof(url), i);
+    snprintf(title, sizeof(title), "Page %u about topic %u", i, i % 1000);
+
+    double begin = bench_now();
+    jumanji_db_history_add(database, url, title);
+    if (i % BOOKMARK_RATIO == 0) {
+      jumanji_db_bookmark_add(database, url, title);
+    }
+    double duration = bench_now() - begin;
+    g_array_append_val(samples, duration);
+  }
+  g_free(jumanji_db_quickmark_find(database, 'a'));
+  bench_report(size, "history_add", samples, bench_now() - start);
+
+  /* revisiting known pages */
+  GRand* random = g_rand_new_with_seed(size);
+
+  g_array_set_size(samples, 0);
+  start = bench_now();
+  for (unsigned int i = 0; i < REVISITS; i++) {
+    bench_url(url, sizeof(url), g_rand_int_range(random, 0, size));
+
+    double begin = bench_now();
+    jumanji_db_history_add(database, url, "Visited again");
+    double duration = bench_now() - begin;
+    g_array_append_val(samples, duration);
+  }
+  g_free(jumanji_db_quickmark_find(database, 'a'));
+  bench_report(size, "history_add revisit", samples, bench_now() - start);
+
+  g_rand_free(random);
+
+  /* startup of a separate process, so that its memory use is not mixed up
+   * with this one */
+  jumanji_db_free(database);
+  fflush(stdout);
+
+  char* child[] = { (char*) program, "--startup", dir, NULL };
+  if (g_spawn_sync(NULL, child, NULL, G_SPAWN_CHILD_INHERITS_STDIN, NULL, NULL,
+        NULL, NULL, NULL, NULL) == FALSE) {
+    fprintf(stderr, "Could not run %s\n", program);
+  }
+
+  database = jumanji_db_init(dir);
+  if (database == NULL) {
+    g_array_free(samples, TRUE);
+    goto error_free;
+  }
+
+  /* completion as cc_open runs it */
+  for (unsigned int i = 0; i < G_N_ELEMENTS(QUERIES); i++) {
+    unsigned int results = 0;
+
+    g_array_set_size(samples, 0);
+    start = bench_now();
+    for (unsigned int run = 0; run < QUERY_RUNS; run++) {
+      double begin = bench_now();
+      girara_list_t* bookmarks = jumanji_db_bookmark_find(database, QUERIES[i]);
+      girara_list_t* history   = jumanji_db_history_find(database, QUERIES[i]);
+      double duration = bench_now() - begin;
+      g_array_append_val(samples, duration);
+
+      results = (bookmarks != NULL ? girara_list_size(bookmarks) : 0) +
+        (history != NULL ? girara_list_size(history) : 0);
+
+      if (bookmarks != NULL) {
+        girara_list_free(bookmarks);
+      }
+      if (history != NULL) {
+        girara_list_free(history);
+      }
+    }
+
+    char* name = g_strdup_printf("find \"%s\" (%u)", QUERIES[i], results);
+    bench_report(size, name, samples, bench_now() - start);
+    g_free(name);
+
+    g_array_set_size(samples, 0);
+    start = bench_now();
+    for (unsigned int run = 0; run < QUERY_RUNS; run++) {
+      results = 0;
+
+      double begin = bench_now();
+      jumanji_db_bookmark_match(database, QUERIES[i], MATCH_LIMIT,
+          bench_count_link, &results);
+      jumanji_db_history_match(database, QUERIES[i], MATCH_LIMIT,
+          bench_count_link, &results);
+      double duration = bench_now() - begin;
+      g_array_append_val(samples, duration);
+    }
+
+    name = g_strdup_printf("match \"%s\" (%u)", QUERIES[i], results);
+    bench_report(size, name, samples, bench_now() - start);
+    g_free(name);
+
+    g_array_set_size(samples, 0);
+    start = bench_now();
+    for (unsigned int run = 0; run < QUERY_RUNS; run++) {
+      results = 0;
+
+      double begin = bench_now();
+      jumanji_db_bookmark_match_fuzzy(database, QUERIES[i], MATCH_LIMIT,
+          bench_count_link, &results);
+      jumanji_db_history_match_fuzzy(database, QUERIES[i], MATCH_LIMIT,
+          bench_count_link, &results);
+      double duration = bench_now() - begin;
+      g_array_append_val(samples, duration);
+    }
+
+    name = g_strdup_printf("fuzzy \"%s\" (%u)", QUERIES[i], results);
+    bench_report(size, name, samples, bench_now() - start);
+    g_free(name);
+
+    /* the prefetch of the completion, which is not bounded in time */
+    g_array_set_size(samples, 0);
+    start = bench_now();
+    for (unsigned int run = 0; run < PREFETCH_RUNS; run++) {
+      unsigned int counts[2] = { 0, 2 };
+
+      double begin = bench_now();
+      jumanji_db_bookmark_find_fuzzy_async(database, QUERIES[i], MATCH_LIMIT,
+          NULL, bench_count_results, counts);
+      jumanji_db_history_find_fuzzy_async(database, QUERIES[i], MATCH_LIMIT,
+          NULL, bench_count_results, counts);
+      while (counts[1] > 0) {
+        g_main_context_iteration(NULL, TRUE);
+      }
+      double duration = bench_now() - begin;
+      g_array_append_val(samples, duration);
+
+      results = counts[0];
+    }
+
+    name = g_strdup_printf("prefetch \"%s\" (%u)", QUERIES[i], results);
+    bench_report(size, name, samples, bench_now() - start);
+    g_free(name);
+  }
+
+  /* saving a session of which one tab changes between saves */
+  girara_list_t* tabs = girara_list_new2(jumanji_db_free_result_link);
+  for (unsigned int i = 0; i < SESSION_TABS; i++) {
+    jumanji_db_result_link_t* link = g_malloc0(sizeof(jumanji_db_result_link_t));
+    bench_url(url, sizeof(url), i);
+    link->url   = g_strdup(url);
+    link->title = g_strdup("Tab");
+    girara_list_append(tabs, link);
+  }
+
+  g_array_set_size(samples, 0);
+  start = bench_now();
+  for (unsigned int run = 0; run < SESSION_RUNS; run++) {
+    jumanji_db_result_link_t* link = girara_list_nth(tabs, run % SESSION_TABS);
+    bench_url(url, sizeof(url), size + run);
+    g_free(link->url);
+    link->url = g_strdup(url);
+
+    double begin = bench_now();
+    jumanji_db_save_session(database, "bench", tabs);
+    double duration = bench_now() - begin;
+    g_array_append_val(samples, duration);
+  }
+  bench_report(size, "save_session", samples, bench_now() - start);
+
+  girara_list_free(tabs);
+
+  g_array_set_size(samples, 0);
+  start = bench_now();
+  for (unsigned int run = 0; run < SESSION_RUNS; run++) {
+    double begin = bench_now();
+    girara_list_t* loaded = jumanji_db_load_session(database, "bench");
+    double duration = bench_now() - begin;
+    g_array_append_val(samples, duration);
+
+    if (loaded != NULL) {
+      girara_list_free(loaded);
+    }
+  }
+  bench_report(size, "load_session", samples, bench_now() - start);
+
+  /* a clean that finds nothing to remove, cleans are queued so the
+   * synchronous find waits until it has been written */
+  g_array_set_size(samples, 0);
+  start = bench_now();
+  for (unsigned int run = 0; run < CLEAN_RUNS; run++) {
+    double begin = bench_now();
+    jumanji_db_history_clean(database, 24 * 60 * 60);
+    g_free(jumanji_db_quickmark_find(database, 'a'));
+    double duration = bench_now() - begin;
+    g_array_append_val(samples, duration);
+  }
+  bench_report(size, "history_clean", samples, bench_now() - start);
+
+  g_array_free(samples, TRUE);
+  jumanji_db_free(database);
+
+error_free:
+
+  bench_remove_dir(dir);
+  g_free(dir);
+}
+
+static int
+bench_startup(const char* dir)
+{
+  long rss = bench_rss();
+
+  double start = bench_now();
+  jumanji_database_t* database = jumanji_db_init(dir);
+  double duration = bench_now() - start;
+
+  if (database == NULL) {
+    fprintf(stderr, "Could not open the database in %s\n", dir);
+    return EXIT_FAILURE;
+  }
+
+  /* the first query pays for whatever the backend loads lazily */
+  start = bench_now();
+  girara_list_t* results = jumanji_db_history_find(database, "example");
+  double query = bench_now() - start;
+
+  if (results != NULL) {
+    girara_list_free(results);
+  }
+
+  printf("%-7s %8s %-22s %9.1f ms  first find %.1f ms  rss +%ld KiB\n",
+      BACKEND, "", "startup", duration / 1000, query / 1000, bench_rss() - rss);
+
+  jumanji_db_free(database);
+
+  return EXIT_SUCCESS;
+}
+
+/* monotonic time in microseconds */
+static double
+bench_now(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return now.tv_sec * 1e6 + now.tv_nsec / 1e3;
+}
+
+static int
+bench_compare_samples(const void* first, const void* second)
+{
+  double a = *(const double*) first;
+  double b = *(const double*) second;
+
+  return (a > b) - (a < b);
+}
+
+static void
+bench_report(unsigned int size, const char* name, GArray* samples, double
+    seconds)
+{
+  if (samples->len == 0) {
+    return;
+  }
+
+  g_array_sort(samples, bench_compare_samples);
+
+  double p50 = g_array_index(samples, double, (samples->len - 1) / 2);
+  double p99 = g_array_index(samples, double, (samples->len - 1) * 99 / 100);
+
+  printf("%-7s %8u %-22s %12.0f %10.1f %10.1f\n", BACKEND, size, name,
+      samples->len / (seconds / 1e6), p50, p99);
+}
+
+/* resident memory in KiB, 0 where /proc is not available */
+static long
+bench_rss(void)
+{
+  long pages = 0;
+
+  FILE* file = fopen("/proc/self/statm", "r");
+  if (file == NULL) {
+    return 0;
+  }
+
+  if (fscanf(file, "%*s %ld", &pages) != 1) {
+    pages = 0;
+  }
+
+  fclose(file);
+
+  return pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static void
+bench_url(char* buffer, size_t length, unsigned int index)
+{
+  snprintf(buffer, length, "http://site%u.example.com/path/%u.html", index,
+      index * 7);
+}
+
+static bool
+bench_count_link(const char* url, const char* title, int visited, void* data)
+{
+  (*(unsigned int*) data)++;
+
+  return true;
+}
+
+/* adds the number of results to the first count and decrements the second,
+ * the number of running searches */
+static void
+bench_count_results(girara_list_t* results, void* data)
+{
+  unsigned int* counts = (unsigned int*) data;
+
+  if (results != NULL) {
+    counts[0] += girara_list_size(results);
+    girara_list_free(results);
+  }
+
+  counts[1]--;
+}
+
+static void
+bench_remove_dir(const char* path)
+{
+  GDir* dir = g_dir_open(path, 0, NULL);
+  if (dir != NULL) {
+    const char* name = NULL;
+    while ((name = g_dir_read_name(dir)) != NULL) {
+      char* child = g_build_filename(path, name, NULL);
+      if (g_file_test(child, G_FILE_TEST_IS_DIR) == TRUE) {
+        bench_remove_dir(child);
+      } else {
+        g_unlink(child);
+      }
+      g_free(child);
+    }
+    g_dir_close(dir);
+  }
+
+  g_rmdir(path);
+}
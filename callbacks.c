@@ -10,6 +10,7 @@
 #include <string.h>
 
 #include "callbacks.h"
+#include "completion.h"
 #include "database.h"
 #include "download.h"
 #include "shortcuts.h"
@@ -161,6 +162,18 @@ cb_jumanji_tab_removed(GtkNotebook* tabs, GtkWidget* page, guint page_num, juman
   }
 }
 
+void
+cb_jumanji_inputbar_changed(GtkEditable* editable, jumanji_t* jumanji)
+{
+  if (editable == NULL || jumanji == NULL || jumanji->ui.session == NULL) {
+    return;
+  }
+
+  char* text = gtk_editable_get_chars(editable, 0, -1);
+  cc_open_prefetch(jumanji->ui.session, text);
+  g_free(text);
+}
+
 void
 cb_jumanji_tab_hovering_over_link(WebKitWebView* web_view, char* title, char* link, jumanji_tab_t* tab)
 {
@@ -331,6 +344,31 @@ cb_settings_webkit(girara_session_t* session, const char* name, girara_setting_t
   }
 }
 
+void
+cb_settings_history(girara_session_t* session, const char* name, girara_setting_type_t type, void* value, void* data)
+{
+  g_return_if_fail(session != NULL);
+  g_return_if_fail(session->global.data != NULL);
+  jumanji_t* jumanji = (jumanji_t*) session->global.data;
+
+  /* the configuration file is read before the database is initialized */
+  if (jumanji->database == NULL) {
+    return;
+  }
+
+  /* both limits are passed at once, a limit of 0 disables it */
+  int history_max_age     = 0;
+  int history_max_entries = 0;
+  girara_setting_get(session, "history-max-age", &history_max_age);
+  girara_setting_get(session, "history-max-entries", &history_max_entries);
+
+  unsigned int age = (history_max_age > 0) ? (unsigned int) MIN((guint64)
+      history_max_age * 24 * 60 * 60, G_MAXUINT) : 0;
+
+  jumanji_db_history_expire(jumanji->database, age, MAX(history_max_entries,
+        0));
+}
+
 bool
 cb_statusbar_proxy(GtkWidget* widget, GdkEvent* event, girara_session_t* session)
 {
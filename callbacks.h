@@ -70,6 +70,14 @@ void cb_jumanji_tab_changed(GtkNotebook* tabs, GtkWidget* page, guint page_num,
  */
 void cb_jumanji_tab_removed(GtkNotebook* tabs, GtkWidget* page, guint page_num, jumanji_t* jumanji);
 
+/**
+ * Prefetches the completion while an url is typed into the inputbar
+ *
+ * @param editable The inputbar entry
+ * @param jumanji The jumanji session
+ */
+void cb_jumanji_inputbar_changed(GtkEditable* editable, jumanji_t* jumanji);
+
 /**
  * Update link in statusbar if link has been hovered
  *
@@ -155,6 +163,17 @@ bool cb_jumanji_tab_navigation_policy_decision_requested(WebKitWebView*
  */
 void cb_settings_webkit(girara_session_t* session, const char* name, girara_setting_type_t type, void* value, void* data);
 
+/**
+ * Called when a history limit has been changed, applies both limits
+ *
+ * @param session The girara session
+ * @param name The name of the setting
+ * @param type The type of the setting
+ * @param value The new value
+ * @param data Custom data
+ */
+void cb_settings_history(girara_session_t* session, const char* name, girara_setting_type_t type, void* value, void* data);
+
 /**
  * Executed when someone clicks the statusbar entry
  *
@@ -6,6 +6,7 @@
 #include <girara/session.h>
 #include <girara/shortcuts.h>
 #include <girara/settings.h>
+#include <girara/utils.h>
 
 #include "commands.h"
 #include "database.h"
@@ -110,6 +111,39 @@ cmd_downloads(girara_session_t* session, girara_list_t* argument_list)
   return true;
 }
 
+bool
+cmd_import(girara_session_t* session, girara_list_t* argument_list)
+{
+  g_return_val_if_fail(session != NULL, false);
+  g_return_val_if_fail(session->global.data != NULL, false);
+  jumanji_t* jumanji = (jumanji_t*) session->global.data;
+
+  if (jumanji->database == NULL) {
+    return false;
+  }
+
+  /* the plain backend keeps its files in the data directory */
+  char* dir = NULL;
+  if (girara_list_size(argument_list) > 0) {
+    dir = girara_fix_path(girara_list_nth(argument_list, 0));
+  } else {
+    dir = g_strdup(jumanji->config.data_dir);
+  }
+
+  gchar* escaped_dir = g_markup_escape_text(dir, -1);
+
+  if (jumanji_db_import(jumanji->database, dir) == true) {
+    girara_notify(session, GIRARA_INFO, "Imported: %s", escaped_dir);
+  } else {
+    girara_notify(session, GIRARA_ERROR, "Could not import: %s", escaped_dir);
+  }
+
+  g_free(escaped_dir);
+  g_free(dir);
+
+  return true;
+}
+
 bool
 cmd_open(girara_session_t* session, girara_list_t* argument_list)
 {
@@ -254,38 +288,7 @@ cmd_search_engine(girara_session_t* session, girara_list_t* argument_list)
   char* identifier = (char*) girara_list_nth(argument_list, 0);
   char* url        = (char*) girara_list_nth(argument_list, 1);
 
-  /* search for existing search engine */
-  if (girara_list_size(jumanji->global.search_engines) > 0) {
-    girara_list_iterator_t* iter = girara_list_iterator(jumanji->global.search_engines);
-
-    do {
-      jumanji_search_engine_t* search_engine = (jumanji_search_engine_t*) girara_list_iterator_data(iter);
-      if (search_engine == NULL) {
-        continue;
-      }
-
-      if (!g_strcmp0(search_engine->identifier, identifier)) {
-        g_free(search_engine->url);
-        search_engine->url = g_strdup(url);
-        return true;
-      }
-    } while (girara_list_iterator_next(iter));
-
-    girara_list_iterator_free(iter);
-  }
-
-  /* create new entry */
-  jumanji_search_engine_t* search_engine = malloc(sizeof(jumanji_search_engine_t));
-  if (search_engine == NULL) {
-    return false;
-  }
-
-  search_engine->url        = g_strdup(url);
-  search_engine->identifier = g_strdup(identifier);
-
-  girara_list_append(jumanji->global.search_engines, search_engine);
-
-  return true;
+  return jumanji_search_engine_add(jumanji, identifier, url);
 }
 
 bool
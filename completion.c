@@ -12,6 +12,67 @@
 #include "database.h"
 #include "utils.h"
 
+/* maximal number of bookmarks and of history items that are completed */
+#define COMPLETION_LIMIT 100
+/* milliseconds without a keystroke before the completion is prefetched */
+#define COMPLETION_DELAY 50
+
+/* commands whose argument is completed by cc_open */
+static const char* const OPEN_COMMANDS[] = {
+  "open", "o", "tabopen", "t", "winopen", "w"
+};
+
+/* searches bookmarks or history, false if not all links were scanned */
+typedef bool (*cc_match_function_t)(jumanji_database_t* database, const char*
+    input, unsigned int limit, jumanji_db_link_function_t function, void* data);
+
+typedef struct cc_links_s
+{
+  girara_completion_group_t* group; /**> Group the links are added to */
+  GPtrArray* cache; /**> Copies of the added links */
+} cc_links_t;
+
+/* cached link that only matches an input fuzzily */
+typedef struct cc_scored_link_s
+{
+  int score; /**> Fuzzy score of the link */
+  jumanji_db_result_link_t* link; /**> The link */
+} cc_scored_link_t;
+
+/* background search of bookmarks and history */
+typedef struct cc_prefetch_s
+{
+  jumanji_t* jumanji; /**> The jumanji session */
+  unsigned int generation; /**> Generation the search belongs to */
+  GCancellable* cancellable; /**> Cancelled once the search is superseded */
+  char* input; /**> The searched input */
+  unsigned int revision; /**> Database revision when the search started */
+  girara_list_t* bookmarks; /**> Found bookmarks */
+  girara_list_t* history; /**> Found history items */
+  unsigned int running; /**> Number of searches that have not finished */
+} cc_prefetch_t;
+
+/* forward declarations */
+static bool cc_open_links(girara_session_t* session, girara_completion_t*
+    completion, const char* name, cc_match_function_t match, const char* input,
+    GPtrArray** cache, bool* partial);
+static bool cc_open_add_link(const char* url, const char* title, int visited,
+    void* data);
+static void cc_open_refine(jumanji_database_t* database, GPtrArray** cache,
+    const char* input);
+static gint cc_open_compare_scored(gconstpointer first, gconstpointer second);
+static GPtrArray* cc_open_cache(GPtrArray** cache);
+static bool cc_open_cached(jumanji_t* jumanji, const char* input);
+static bool cc_open_reusable(jumanji_t* jumanji, GPtrArray* cache, const char*
+    input);
+static bool cc_open_candidate(jumanji_t* jumanji, const char* input);
+static const char* cc_open_input(const char* text);
+static gboolean cb_cc_open_prefetch(gpointer data);
+static void cb_cc_open_prefetch_bookmarks(girara_list_t* results, void* data);
+static void cb_cc_open_prefetch_history(girara_list_t* results, void* data);
+static void cc_open_prefetch_done(cc_prefetch_t* prefetch);
+static void cc_open_store(GPtrArray** cache, girara_list_t* links);
+
 girara_completion_t*
 cc_open(girara_session_t* session, const char* input)
 {
@@ -27,94 +88,58 @@ cc_open(girara_session_t* session, const char* input)
   }
 
   /* search keywords */
-  if (jumanji->global.search_engines != NULL && girara_list_size(jumanji->global.search_engines) > 0) {
+  unsigned int first    = 0;
+  unsigned int matching = jumanji_search_engine_prefix(jumanji, input, &first);
+  if (matching > 0) {
     group = girara_completion_group_create(session, "Search keywords");
     if (group == NULL) {
       goto error_free;
     }
 
-    int number_of_matching = 0;
-    girara_list_iterator_t* iter = girara_list_iterator(jumanji->global.search_engines);
-    do {
-      jumanji_search_engine_t* search_engine = (jumanji_search_engine_t*) girara_list_iterator_data(iter);
-      if (search_engine == NULL) {
-        continue;
-      }
-
-      if (strncmp(input, search_engine->identifier, strlen(input)) == 0) {
-        number_of_matching++;
-        girara_completion_group_add_element(group, search_engine->identifier, search_engine->url);
-        break;
-      }
-    } while (girara_list_iterator_next(iter));
-    girara_list_iterator_free(iter);
-
-    if (number_of_matching != 0) {
-      girara_completion_add_group(completion, group);
-    } else {
-      girara_completion_group_free(group);
+    for (unsigned int i = first; i < first + matching; i++) {
+      jumanji_search_engine_t* search_engine =
+        g_ptr_array_index(jumanji->global.search_engine_order, i);
+      girara_completion_group_add_element(group, search_engine->identifier, search_engine->url);
     }
+
+    girara_completion_add_group(completion, group);
   }
 
   group = NULL;
 
-  /* search history */
-  girara_list_t* bookmark_list = jumanji_db_bookmark_find(jumanji->database, input);
-
-  if (bookmark_list != NULL) {
-    int bookmark_length = girara_list_size(bookmark_list);
-
-    /* add group entry */
-    if (bookmark_length > 0) {
-      group = girara_completion_group_create(session, "Bookmarks");
-      if (group == NULL) {
-        goto error_free;
-      } else {
-        for (int i = 0; i < bookmark_length; i++) {
-          jumanji_db_result_link_t* link = (jumanji_db_result_link_t*) girara_list_nth(bookmark_list, i);
-          if (link != NULL) {
-            girara_completion_group_add_element(group, link->url, link->title);
-          }
-        }
-
-        girara_completion_add_group(completion, group);
-      }
-    }
+  /* the prefetch is superseded, unless it has already filled the caches */
+  cc_open_cancel(jumanji);
 
-    girara_list_free(bookmark_list);
-  }
+  unsigned int revision = jumanji_db_revision(jumanji->database);
+  bool partial          = false;
 
   /* search bookmarks */
-  group                       = NULL;
-  girara_list_t* history_list = jumanji_db_history_find(jumanji->database, input);
-
-  if (history_list != NULL) {
-    int history_length = girara_list_size(history_list);
-
-    /* add group entry */
-    if (history_length > 0) {
-      group = girara_completion_group_create(session, "History");
-      if (group == NULL) {
-        goto error_free;
-      } else {
-        for (int i = 0; i < history_length; i++) {
-          jumanji_db_result_link_t* link = (jumanji_db_result_link_t*) girara_list_nth(history_list, i);
-          if (link != NULL) {
-            girara_completion_group_add_element(group, link->url, link->title);
-          }
-        }
-
-        girara_completion_add_group(completion, group);
-      }
-    }
+  if (cc_open_links(session, completion, "Bookmarks",
+        jumanji_db_bookmark_match_fuzzy, input,
+        &jumanji->completion.bookmarks, &partial) == false) {
+    goto error_free;
+  }
 
-    girara_list_free(history_list);
+  /* search history */
+  if (cc_open_links(session, completion, "History",
+        jumanji_db_history_match_fuzzy, input,
+        &jumanji->completion.history, &partial) == false) {
+    goto error_free;
   }
 
+  g_free(jumanji->completion.input);
+  jumanji->completion.input    = g_strdup(input);
+  jumanji->completion.revision = revision;
+  jumanji->completion.partial  = partial;
+
   return completion;
 
 error_free:
 
+  /* the caches may belong to different inputs now */
+  g_free(jumanji->completion.input);
+  jumanji->completion.input = NULL;
+
   if (completion != NULL) {
     girara_completion_free(completion);
   }
@@ -125,3 +150,378 @@ error_free:
 
   return NULL;
 }
+
+static bool
+cc_open_links(girara_session_t* session, girara_completion_t* completion,
+    const char* name, cc_match_function_t match, const char* input,
+    GPtrArray** cache, bool* partial)
+{
+  jumanji_t* jumanji = session->global.data;
+
+  cc_links_t links = { .group = girara_completion_group_create(session, name),
+    .cache = cc_open_cache(cache) };
+  if (links.group == NULL) {
+    return false;
+  }
+
+  if (cc_open_reusable(jumanji, links.cache, input) == true) {
+    /* the links of an unchanged input are used as they are */
+    if (strcmp(input, jumanji->completion.input) != 0) {
+      cc_open_refine(jumanji->database, cache, input);
+      links.cache = *cache;
+    }
+
+    *partial = *partial || jumanji->completion.partial;
+
+    for (guint i = 0; i < links.cache->len; i++) {
+      jumanji_db_result_link_t* link = g_ptr_array_index(links.cache, i);
+      girara_completion_group_add_element(links.group, link->url, link->title);
+    }
+  } else {
+    /* the group copies the links while the database owns them */
+    g_ptr_array_set_size(links.cache, 0);
+    if (match(jumanji->database, input, COMPLETION_LIMIT, cc_open_add_link,
+          &links) == false) {
+      *partial = true;
+    }
+  }
+
+  if (links.cache->len > 0) {
+    girara_completion_add_group(completion, links.group);
+  } else {
+    girara_completion_group_free(links.group);
+  }
+
+  return true;
+}
+
+static bool
+cc_open_add_link(const char* url, const char* title, int visited, void* data)
+{
+  cc_links_t* links = (cc_links_t*) data;
+
+  girara_completion_group_add_element(links->group, url, title);
+
+  /* kept to narrow down the completion of a longer input */
+  jumanji_db_result_link_t* link = malloc(sizeof(jumanji_db_result_link_t));
+  if (link == NULL) {
+    return false;
+  }
+
+  link->url     = g_strdup(url);
+  link->title   = g_strdup(title);
+  link->visited = visited;
+
+  g_ptr_array_add(links->cache, link);
+
+  return true;
+}
+
+void
+cc_open_prefetch(girara_session_t* session, const char* text)
+{
+  g_return_if_fail(session != NULL);
+  g_return_if_fail(session->global.data != NULL);
+  jumanji_t* jumanji = session->global.data;
+
+  /* cycling through the completion writes its candidates into the inputbar,
+   * which is no keystroke */
+  const char* input = cc_open_input(text);
+  if (input != NULL && cc_open_candidate(jumanji, input) == true) {
+    return;
+  }
+
+  /* every keystroke supersedes the pending and the running prefetch */
+  cc_open_cancel(jumanji);
+
+  if (input == NULL || jumanji->database == NULL) {
+    return;
+  }
+
+  /* nothing to search if the caches can be used */
+  if (cc_open_reusable(jumanji, jumanji->completion.bookmarks, input) == true &&
+      cc_open_reusable(jumanji, jumanji->completion.history, input) == true) {
+    return;
+  }
+
+  jumanji->completion.pending = g_strdup(input);
+  jumanji->completion.timeout = g_timeout_add(COMPLETION_DELAY,
+      cb_cc_open_prefetch, jumanji);
+}
+
+void
+cc_open_cancel(jumanji_t* jumanji)
+{
+  g_return_if_fail(jumanji != NULL);
+
+  if (jumanji->completion.timeout != 0) {
+    g_source_remove(jumanji->completion.timeout);
+    jumanji->completion.timeout = 0;
+  }
+
+  g_free(jumanji->completion.pending);
+  jumanji->completion.pending = NULL;
+
+  if (jumanji->completion.cancellable != NULL) {
+    g_cancellable_cancel(jumanji->completion.cancellable);
+    g_object_unref(jumanji->completion.cancellable);
+    jumanji->completion.cancellable = NULL;
+  }
+
+  jumanji->completion.generation++;
+}
+
+static void
+cc_open_refine(jumanji_database_t* database, GPtrArray** cache, const char*
+    input)
+{
+  /* the database passes the links that contain the input first, in their
+   * previous order, and then the fuzzy matches by score */
+  GPtrArray* refined = g_ptr_array_new_with_free_func(jumanji_db_free_result_link);
+  GArray* scored     = g_array_new(FALSE, FALSE, sizeof(cc_scored_link_t));
+
+  for (guint i = 0; i < (*cache)->len; i++) {
+    jumanji_db_result_link_t* link = g_ptr_array_index(*cache, i);
+
+    if (jumanji_db_link_matches(database, link->url, link->title, input) ==
+        true) {
+      g_ptr_array_add(refined, link);
+      continue;
+    }
+
+    cc_scored_link_t item = { .score = jumanji_db_link_score(database,
+        link->url, link->title, input), .link = link };
+    if (item.score >= 0) {
+      g_array_append_val(scored, item);
+    } else {
+      jumanji_db_free_result_link(link);
+    }
+  }
+
+  g_array_sort(scored, cc_open_compare_scored);
+  for (guint i = 0; i < scored->len; i++) {
+    g_ptr_array_add(refined, g_array_index(scored, cc_scored_link_t, i).link);
+  }
+
+  g_array_free(scored, TRUE);
+
+  /* the links have moved into the refined cache */
+  g_ptr_array_set_free_func(*cache, NULL);
+  g_ptr_array_free(*cache, TRUE);
+  *cache = refined;
+}
+
+static gint
+cc_open_compare_scored(gconstpointer first, gconstpointer second)
+{
+  const cc_scored_link_t* a = first;
+  const cc_scored_link_t* b = second;
+
+  /* better scores first, more recent visits break ties */
+  if (a->score != b->score) {
+    return (a->score > b->score) ? -1 : 1;
+  }
+
+  return (a->link->visited < b->link->visited) - (a->link->visited >
+      b->link->visited);
+}
+
+static GPtrArray*
+cc_open_cache(GPtrArray** cache)
+{
+  if (*cache == NULL) {
+    *cache = g_ptr_array_new_with_free_func(jumanji_db_free_result_link);
+  }
+
+  return *cache;
+}
+
+static bool
+cc_open_cached(jumanji_t* jumanji, const char* input)
+{
+  /* links that match an extended input are among the previous ones, unless
+   * the database has changed in between */
+  return jumanji->completion.input != NULL &&
+    g_str_has_prefix(input, jumanji->completion.input) == TRUE &&
+    jumanji->completion.revision == jumanji_db_revision(jumanji->database);
+}
+
+static bool
+cc_open_reusable(jumanji_t* jumanji, GPtrArray* cache, const char* input)
+{
+  if (cc_open_cached(jumanji, input) == false) {
+    return false;
+  }
+
+  if (strcmp(input, jumanji->completion.input) == 0) {
+    return true;
+  }
+
+  /* a result that reached the limit or whose fuzzy search ran out of time
+   * may lack links that match a longer input */
+  return jumanji->completion.partial == false &&
+    (cache == NULL || cache->len < COMPLETION_LIMIT);
+}
+
+static bool
+cc_open_candidate(jumanji_t* jumanji, const char* input)
+{
+  if (jumanji->completion.input == NULL) {
+    return false;
+  }
+
+  GPtrArray* const caches[] = { jumanji->completion.bookmarks,
+    jumanji->completion.history };
+
+  for (unsigned int i = 0; i < G_N_ELEMENTS(caches); i++) {
+    for (guint j = 0; caches[i] != NULL && j < caches[i]->len; j++) {
+      jumanji_db_result_link_t* link = g_ptr_array_index(caches[i], j);
+      if (g_strcmp0(input, link->url) == 0) {
+        return true;
+      }
+    }
+  }
+
+  GPtrArray* search_engines = jumanji->global.search_engine_order;
+  for (guint i = 0; search_engines != NULL && i < search_engines->len; i++) {
+    jumanji_search_engine_t* search_engine = g_ptr_array_index(search_engines,
+        i);
+    if (g_strcmp0(input, search_engine->identifier) == 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static const char*
+cc_open_input(const char* text)
+{
+  if (text == NULL || text[0] != ':') {
+    return NULL;
+  }
+
+  const char* command = text + 1;
+  const char* space   = strchr(command, ' ');
+  if (space == NULL) {
+    return NULL;
+  }
+
+  for (unsigned int i = 0; i < G_N_ELEMENTS(OPEN_COMMANDS); i++) {
+    size_t length = strlen(OPEN_COMMANDS[i]);
+    if (length == (size_t) (space - command) &&
+        strncmp(command, OPEN_COMMANDS[i], length) == 0) {
+      return space + 1;
+    }
+  }
+
+  return NULL;
+}
+
+static gboolean
+cb_cc_open_prefetch(gpointer data)
+{
+  jumanji_t* jumanji = (jumanji_t*) data;
+
+  jumanji->completion.timeout = 0;
+
+  cc_prefetch_t* prefetch = g_malloc0(sizeof(cc_prefetch_t));
+
+  prefetch->jumanji     = jumanji;
+  prefetch->generation  = jumanji->completion.generation;
+  prefetch->cancellable = g_cancellable_new();
+  prefetch->input       = jumanji->completion.pending;
+  prefetch->revision    = jumanji_db_revision(jumanji->database);
+  prefetch->running     = 2;
+
+  jumanji->completion.pending     = NULL;
+  jumanji->completion.cancellable = g_object_ref(prefetch->cancellable);
+
+  /* both searches run on the database thread, a newer keystroke cancels
+   * them */
+  jumanji_db_bookmark_find_fuzzy_async(jumanji->database, prefetch->input,
+      COMPLETION_LIMIT, prefetch->cancellable, cb_cc_open_prefetch_bookmarks,
+      prefetch);
+  jumanji_db_history_find_fuzzy_async(jumanji->database, prefetch->input,
+      COMPLETION_LIMIT, prefetch->cancellable, cb_cc_open_prefetch_history,
+      prefetch);
+
+  return FALSE;
+}
+
+static void
+cb_cc_open_prefetch_bookmarks(girara_list_t* results, void* data)
+{
+  cc_prefetch_t* prefetch = (cc_prefetch_t*) data;
+
+  prefetch->bookmarks = results;
+  cc_open_prefetch_done(prefetch);
+}
+
+static void
+cb_cc_open_prefetch_history(girara_list_t* results, void* data)
+{
+  cc_prefetch_t* prefetch = (cc_prefetch_t*) data;
+
+  prefetch->history = results;
+  cc_open_prefetch_done(prefetch);
+}
+
+static void
+cc_open_prefetch_done(cc_prefetch_t* prefetch)
+{
+  if (--prefetch->running > 0) {
+    return;
+  }
+
+  /* a cancelled prefetch may outlive the jumanji session */
+  if (g_cancellable_is_cancelled(prefetch->cancellable) == FALSE &&
+      prefetch->bookmarks != NULL && prefetch->history != NULL &&
+      prefetch->generation == prefetch->jumanji->completion.generation) {
+    jumanji_t* jumanji = prefetch->jumanji;
+
+    cc_open_store(&jumanji->completion.bookmarks, prefetch->bookmarks);
+    cc_open_store(&jumanji->completion.history, prefetch->history);
+
+    g_free(jumanji->completion.input);
+    jumanji->completion.input    = prefetch->input;
+    jumanji->completion.revision = prefetch->revision;
+    jumanji->completion.partial  = false;
+    prefetch->input              = NULL;
+
+    g_object_unref(jumanji->completion.cancellable);
+    jumanji->completion.cancellable = NULL;
+  }
+
+  if (prefetch->bookmarks != NULL) {
+    girara_list_free(prefetch->bookmarks);
+  }
+
+  if (prefetch->history != NULL) {
+    girara_list_free(prefetch->history);
+  }
+
+  g_object_unref(prefetch->cancellable);
+  g_free(prefetch->input);
+  g_free(prefetch);
+}
+
+static void
+cc_open_store(GPtrArray** cache, girara_list_t* links)
+{
+  GPtrArray* array = cc_open_cache(cache);
+  g_ptr_array_set_size(array, 0);
+
+  if (girara_list_size(links) == 0) {
+    return;
+  }
+
+  /* the links move from the list into the cache */
+  girara_list_set_free_function(links, NULL);
+
+  girara_list_iterator_t* iter = girara_list_iterator(links);
+  do {
+    g_ptr_array_add(array, girara_list_iterator_data(iter));
+  } while (girara_list_iterator_next(iter) != NULL);
+  girara_list_iterator_free(iter);
+}
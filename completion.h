@@ -5,6 +5,8 @@
 
 #include <girara/types.h>
 
+#include "jumanji.h"
+
 /**
  * Completion for the open command
  *
@@ -14,4 +16,22 @@
  */
 girara_completion_t* cc_open(girara_session_t* session, const char* input);
 
+/**
+ * Searches the completion of the open commands in the background once typing
+ * pauses, so that cc_open can answer from the results without blocking.
+ * Texts that show a candidate of the completion are ignored, girara writes
+ * them while the completion is cycled.
+ *
+ * @param session The used girara session
+ * @param text The current text of the inputbar
+ */
+void cc_open_prefetch(girara_session_t* session, const char* text);
+
+/**
+ * Cancels a pending or running prefetch
+ *
+ * @param jumanji The jumanji session
+ */
+void cc_open_cancel(jumanji_t* jumanji);
+
 #endif // COMPLETION_H
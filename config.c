@@ -61,6 +61,10 @@ config_load_default(jumanji_t* jumanji)
   girara_setting_add(gsession, "load-session-at-startup",     &bool_value,  BOOLEAN, true,  "Load the default session at startup", NULL, NULL);
   bool_value = true;
   girara_setting_add(gsession, "focus-new-tabs",              &bool_value,  BOOLEAN, true,  "Focus newly opened tabs",     NULL, NULL);
+  int_value = 0;
+  girara_setting_add(gsession, "history-max-age",             &int_value,   INT,     false, "Days after which history entries are deleted",                       cb_settings_history, NULL);
+  int_value = 0;
+  girara_setting_add(gsession, "history-max-entries",         &int_value,   INT,     false, "Number of history entries beyond which the least frecent are deleted (sqlite only)", cb_settings_history, NULL);
 
   /* hint settings */
   string_value =
@@ -201,6 +205,7 @@ config_load_default(jumanji_t* jumanji)
   girara_inputbar_command_add(gsession, "delmarks",      "delm",  cmd_marks_delete,      NULL,    "Delete the specified marks");
   girara_inputbar_command_add(gsession, "delqmarks",     "delqm", cmd_quickmarks_delete, NULL,    "Add quickmark");
   girara_inputbar_command_add(gsession, "downloads",     NULL,    cmd_downloads,         NULL,    "Show downloads");
+  girara_inputbar_command_add(gsession, "import",        NULL,    cmd_import,            NULL,    "Import the files of the plain database");
   girara_inputbar_command_add(gsession, "mark",          NULL,    cmd_marks_add,         NULL,    "Mark current location within the web page");
   girara_inputbar_command_add(gsession, "open",          "o",     cmd_open,              cc_open, "Open URL in the current tab");
   girara_inputbar_command_add(gsession, "print",         NULL,    cmd_print,             NULL,    "Show print dialog");
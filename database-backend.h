@@ -0,0 +1,107 @@
+/* See LICENSE file for license and copyright information */
+
+#ifndef DATABASE_BACKEND_H
+#define DATABASE_BACKEND_H
+
+#include <stdbool.h>
+#include <girara/types.h>
+
+#include "database-table.h"
+
+/**
+ * Storage backend of the database
+ *
+ * The functions in database.h queue mutations and pass them to the backend
+ * in batches. Every batch is enclosed by a call to begin and commit, so a
+ * backend can write all mutations of a batch at once. The data argument is
+ * the object returned by init.
+ *
+ * All functions except check_location are called from the database thread,
+ * which also runs the main context that was the thread default while init
+ * was called.
+ */
+typedef struct jumanji_db_backend_s
+{
+  const char* name; /**> Name of the backend */
+  bool ignore_case; /**> Searches match inputs regardless of case */
+
+  void* (*init)(const char* dir); /**> Opens the storage in the given directory */
+  void (*free)(void* data); /**> Closes the storage */
+  bool (*check_location)(const char* dir); /**> Checks for files in an old location */
+
+  void (*begin)(void* data); /**> Starts a batch of mutations */
+  void (*commit)(void* data); /**> Writes a batch of mutations */
+
+  void (*bookmark_add)(void* data, const char* url, const char* title);
+  void (*bookmark_remove)(void* data, const char* url);
+  /* calls function for the matching links until it returns false, limit is
+   * a hint for backends that can stop searching early, 0 for no limit */
+  void (*bookmark_match)(void* data, const char* input, unsigned int limit,
+      jumanji_db_link_function_t function, void* function_data);
+  bool (*bookmark_exists)(void* data, const char* url);
+
+  void (*history_add)(void* data, const char* url, const char* title, int visited);
+  void (*history_clean)(void* data, unsigned int age);
+  /* removes at most limit links that are older than age seconds or beyond
+   * the size most frecent ones and stores how many in expired, returns true
+   * if more remain, may be NULL */
+  bool (*history_expire)(void* data, unsigned int age, unsigned int size,
+      unsigned int limit, unsigned int* expired);
+  void (*history_match)(void* data, const char* input, unsigned int limit,
+      jumanji_db_link_function_t function, void* function_data);
+
+  void (*quickmark_add)(void* data, const char identifier, const char* url);
+  void (*quickmark_remove)(void* data, const char identifier);
+  char* (*quickmark_find)(void* data, const char identifier);
+
+  void (*save_session)(void* data, const char* name, girara_list_t* urls);
+  girara_list_t* (*load_session)(void* data, const char* name);
+
+  /* enumerate all stored links without copying them until the function
+   * returns false, the history items that are most likely wanted first, may
+   * be NULL */
+  void (*bookmark_foreach)(void* data, jumanji_db_link_function_t function, void* function_data);
+  void (*history_foreach)(void* data, jumanji_db_link_function_t function, void* function_data);
+
+  bool (*import)(void* data, const char* dir); /**> Imports the files of the plain backend, may be NULL */
+
+  /* performs work that init deferred, a step at a time while no job is
+   * waiting, returns true if more remains, may be NULL */
+  bool (*idle)(void* data);
+} jumanji_db_backend_t;
+
+/**
+ * Backend that keeps everything in plain text files, available in every
+ * build so that its files can be imported
+ */
+extern const jumanji_db_backend_t jumanji_db_plain_backend;
+
+/**
+ * Opens the files of the plain backend for reading only. Nothing is created
+ * or monitored and missing files count as empty.
+ *
+ * @param dir The directory of the files
+ * @return The opened files, to be closed with the free function of
+ *   jumanji_db_plain_backend and not to be written to, or NULL if an error
+ *   occurred
+ */
+void* jumanji_db_plain_open(const char* dir);
+
+#ifdef WITH_SQLITE
+/**
+ * Backend that keeps everything in a sqlite database
+ */
+extern const jumanji_db_backend_t jumanji_db_sqlite_backend;
+
+/* the backend selected at build time */
+#define jumanji_db_backend jumanji_db_sqlite_backend
+#else
+#define jumanji_db_backend jumanji_db_plain_backend
+#endif
+
+/**
+ * Backend that keeps everything in memory, available in every build
+ */
+extern const jumanji_db_backend_t jumanji_db_memory_backend;
+
+#endif // DATABASE_BACKEND_H
@@ -0,0 +1,367 @@
+/* See LICENSE file for license and copyright information */
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "database-fuzzy.h"
+
+/* score of every matched character */
+#define SCORE_MATCH 16
+/* penalty for the first character of a gap, every further one costs one
+ * more */
+#define SCORE_GAP_START -3
+/* bonus for a character at the start of a word ... */
+#define BONUS_BOUNDARY 8
+/* ... at an upper case letter after a lower case one ... */
+#define BONUS_CAMEL 7
+/* ... and right after the previous matched character */
+#define BONUS_CONSECUTIVE 4
+/* score of impossible alignments, low enough not to overflow */
+#define SCORE_NONE (INT_MIN / 2)
+
+/* scored link of a selection */
+typedef struct jumanji_db_fuzzy_link_s
+{
+  int score; /**> Score of the link */
+  jumanji_db_result_link_t* link; /**> Copy of the link */
+} jumanji_db_fuzzy_link_t;
+
+/* forward declarations */
+static int jumanji_db_fuzzy_bonus(const char* text, size_t position);
+static int jumanji_db_fuzzy_compare(const jumanji_db_fuzzy_link_t* first,
+    const jumanji_db_fuzzy_link_t* second);
+static gint jumanji_db_fuzzy_compare_best(gconstpointer first, gconstpointer
+    second);
+static void jumanji_db_fuzzy_top_sift_down(jumanji_db_fuzzy_top_t* top, guint
+    index);
+
+bool
+jumanji_db_fuzzy_init(jumanji_db_fuzzy_t* fuzzy, const char* input)
+{
+  if (fuzzy == NULL || input == NULL) {
+    return false;
+  }
+
+  size_t length = strlen(input);
+  if (length == 0 || length > FUZZY_MAX_LENGTH) {
+    return false;
+  }
+
+  for (size_t i = 0; i < length; i++) {
+    fuzzy->pattern[i] = g_ascii_tolower(input[i]);
+    fuzzy->fold[i]    = g_ascii_islower(fuzzy->pattern[i]) ? 0x20 : 0;
+  }
+
+  memset(fuzzy->wanted, 0, sizeof(fuzzy->wanted));
+  for (size_t i = 0; i < length; i++) {
+    fuzzy->wanted[(guchar) fuzzy->pattern[i]]                  = true;
+    fuzzy->wanted[(guchar) g_ascii_toupper(fuzzy->pattern[i])] = true;
+  }
+
+  fuzzy->length = length;
+
+  return true;
+}
+
+bool
+jumanji_db_fuzzy_match(const jumanji_db_fuzzy_t* fuzzy, const char* text,
+    size_t length)
+{
+  size_t matched  = 0;
+  size_t position = 0;
+
+#ifdef __SSE2__
+  /* compares 16 characters of the text with the wanted one at once and
+   * continues after the first hit with the next wanted character */
+  __m128i wanted = _mm_set1_epi8(fuzzy->pattern[0]);
+  __m128i fold   = _mm_set1_epi8(fuzzy->fold[0]);
+
+  for (; position + 16 <= length; position += 16) {
+    __m128i block = _mm_loadu_si128((const __m128i*) (text + position));
+    unsigned int hits = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_or_si128(block,
+            fold), wanted));
+
+    while (hits != 0) {
+      if (++matched == fuzzy->length) {
+        return true;
+      }
+
+      /* only hits after the current one count for the next character */
+      unsigned int after = ~((2u << g_bit_nth_lsf(hits, -1)) - 1);
+
+      wanted = _mm_set1_epi8(fuzzy->pattern[matched]);
+      fold   = _mm_set1_epi8(fuzzy->fold[matched]);
+      hits   = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_or_si128(block, fold),
+            wanted)) & after;
+    }
+  }
+#endif
+
+  for (; position < length; position++) {
+    if ((text[position] | fuzzy->fold[matched]) == fuzzy->pattern[matched] &&
+        ++matched == fuzzy->length) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+int
+jumanji_db_fuzzy_score(const jumanji_db_fuzzy_t* fuzzy, const char* text)
+{
+  if (text == NULL) {
+    return -1;
+  }
+
+  size_t length = strlen(text);
+  if (jumanji_db_fuzzy_match(fuzzy, text, length) == false) {
+    return -1;
+  }
+
+  /* for every character j of the input, the best score up to j with j at
+   * its latest match, that position, and the best score plus position of any
+   * match of j, since a gap costs one more for every further position */
+  int last[FUZZY_MAX_LENGTH];
+  int position[FUZZY_MAX_LENGTH];
+  int reach[FUZZY_MAX_LENGTH];
+  for (size_t j = 0; j < fuzzy->length; j++) {
+    last[j]     = SCORE_NONE;
+    position[j] = -2;
+    reach[j]    = SCORE_NONE;
+  }
+
+  size_t end = fuzzy->length - 1;
+  int best   = SCORE_NONE;
+
+  for (int i = 0; i < (int) length; i++) {
+    guchar character = text[i];
+
+    /* only characters of the input change the scores */
+    if (fuzzy->wanted[character] == false) {
+      continue;
+    }
+
+    char folded = (character >= 'A' && character <= 'Z') ? character | 0x20 :
+      character;
+    int bonus   = jumanji_db_fuzzy_bonus(text, i);
+
+    /* backwards, so that the scores of j - 1 are still those before i */
+    for (size_t j = end + 1; j-- > 0;) {
+      if (folded != fuzzy->pattern[j]) {
+        continue;
+      }
+
+      int before = 0;
+      if (j > 0) {
+        before = reach[j - 1] - i + SCORE_GAP_START + 2;
+        if (position[j - 1] == i - 1) {
+          before = MAX(before, last[j - 1] + BONUS_CONSECUTIVE);
+        }
+      }
+
+      /* impossible alignments stay far below any real score */
+      if (before <= SCORE_NONE / 2) {
+        continue;
+      }
+
+      last[j]     = before + SCORE_MATCH + bonus;
+      position[j] = i;
+      reach[j]    = MAX(reach[j], last[j] + i);
+    }
+
+    if (position[end] == i) {
+      best = MAX(best, last[end]);
+    }
+  }
+
+  return MAX(best, 0);
+}
+
+int
+jumanji_db_fuzzy_score_link(const jumanji_db_fuzzy_t* fuzzy, const char* url,
+    const char* title)
+{
+  return MAX(jumanji_db_fuzzy_score(fuzzy, url),
+      jumanji_db_fuzzy_score(fuzzy, title));
+}
+
+static int
+jumanji_db_fuzzy_bonus(const char* text, size_t position)
+{
+  if (position == 0 || g_ascii_isalnum(text[position - 1]) == FALSE) {
+    return BONUS_BOUNDARY;
+  }
+
+  if (g_ascii_isupper(text[position]) == TRUE &&
+      g_ascii_islower(text[position - 1]) == TRUE) {
+    return BONUS_CAMEL;
+  }
+
+  return 0;
+}
+
+jumanji_db_fuzzy_top_t*
+jumanji_db_fuzzy_top_new(unsigned int size)
+{
+  jumanji_db_fuzzy_top_t* top = g_malloc0(sizeof(jumanji_db_fuzzy_top_t));
+
+  top->heap = g_array_sized_new(FALSE, FALSE, sizeof(jumanji_db_fuzzy_link_t),
+      (size != 0) ? size : 64);
+  top->size = (size != 0) ? size : G_MAXUINT;
+
+  return top;
+}
+
+void
+jumanji_db_fuzzy_top_free(jumanji_db_fuzzy_top_t* top)
+{
+  if (top == NULL) {
+    return;
+  }
+
+  for (guint i = 0; i < top->heap->len; i++) {
+    jumanji_db_free_result_link(g_array_index(top->heap,
+          jumanji_db_fuzzy_link_t, i).link);
+  }
+
+  g_array_free(top->heap, TRUE);
+  g_free(top);
+}
+
+bool
+jumanji_db_fuzzy_top_accepts(jumanji_db_fuzzy_top_t* top, int score, int
+    visited)
+{
+  if (top->heap->len < top->size) {
+    return true;
+  }
+
+  jumanji_db_fuzzy_link_t* worst = &g_array_index(top->heap,
+      jumanji_db_fuzzy_link_t, 0);
+
+  return score > worst->score || (score == worst->score && visited >
+      worst->link->visited);
+}
+
+void
+jumanji_db_fuzzy_top_add(jumanji_db_fuzzy_top_t* top, int score, const char*
+    url, const char* title, int visited)
+{
+  if (jumanji_db_fuzzy_top_accepts(top, score, visited) == false) {
+    return;
+  }
+
+  jumanji_db_result_link_t* link = malloc(sizeof(jumanji_db_result_link_t));
+  if (link == NULL) {
+    return;
+  }
+
+  link->url     = g_strdup(url);
+  link->title   = g_strdup(title);
+  link->visited = visited;
+
+  jumanji_db_fuzzy_link_t item = { .score = score, .link = link };
+
+  /* a full selection drops its worst link */
+  if (top->heap->len == top->size) {
+    jumanji_db_fuzzy_link_t* worst = &g_array_index(top->heap,
+        jumanji_db_fuzzy_link_t, 0);
+    jumanji_db_free_result_link(worst->link);
+    *worst = item;
+    jumanji_db_fuzzy_top_sift_down(top, 0);
+    return;
+  }
+
+  g_array_append_val(top->heap, item);
+
+  guint index = top->heap->len - 1;
+  while (index > 0) {
+    guint parent = (index - 1) / 2;
+    jumanji_db_fuzzy_link_t* child_item  = &g_array_index(top->heap,
+        jumanji_db_fuzzy_link_t, index);
+    jumanji_db_fuzzy_link_t* parent_item = &g_array_index(top->heap,
+        jumanji_db_fuzzy_link_t, parent);
+
+    if (jumanji_db_fuzzy_compare(child_item, parent_item) >= 0) {
+      break;
+    }
+
+    jumanji_db_fuzzy_link_t swap = *child_item;
+    *child_item  = *parent_item;
+    *parent_item = swap;
+    index        = parent;
+  }
+}
+
+void
+jumanji_db_fuzzy_top_foreach(jumanji_db_fuzzy_top_t* top,
+    jumanji_db_link_function_t function, void* data)
+{
+  if (top == NULL || function == NULL) {
+    return;
+  }
+
+  g_array_sort(top->heap, jumanji_db_fuzzy_compare_best);
+
+  for (guint i = 0; i < top->heap->len; i++) {
+    jumanji_db_result_link_t* link = g_array_index(top->heap,
+        jumanji_db_fuzzy_link_t, i).link;
+    if (function(link->url, link->title, link->visited, data) == false) {
+      break;
+    }
+  }
+}
+
+/* orders worse links first */
+static int
+jumanji_db_fuzzy_compare(const jumanji_db_fuzzy_link_t* first, const
+    jumanji_db_fuzzy_link_t* second)
+{
+  if (first->score != second->score) {
+    return (first->score < second->score) ? -1 : 1;
+  }
+
+  return (first->link->visited > second->link->visited) -
+    (first->link->visited < second->link->visited);
+}
+
+static gint
+jumanji_db_fuzzy_compare_best(gconstpointer first, gconstpointer second)
+{
+  return jumanji_db_fuzzy_compare(second, first);
+}
+
+static void
+jumanji_db_fuzzy_top_sift_down(jumanji_db_fuzzy_top_t* top, guint index)
+{
+  for (;;) {
+    guint smallest = index;
+
+    for (guint child = 2 * index + 1; child <= 2 * index + 2 && child <
+        top->heap->len; child++) {
+      if (jumanji_db_fuzzy_compare(&g_array_index(top->heap,
+              jumanji_db_fuzzy_link_t, child), &g_array_index(top->heap,
+                jumanji_db_fuzzy_link_t, smallest)) < 0) {
+        smallest = child;
+      }
+    }
+
+    if (smallest == index) {
+      return;
+    }
+
+    jumanji_db_fuzzy_link_t swap = g_array_index(top->heap,
+        jumanji_db_fuzzy_link_t, index);
+    g_array_index(top->heap, jumanji_db_fuzzy_link_t, index) =
+      g_array_index(top->heap, jumanji_db_fuzzy_link_t, smallest);
+    g_array_index(top->heap, jumanji_db_fuzzy_link_t, smallest) = swap;
+
+    index = smallest;
+  }
+}
@@ -0,0 +1,122 @@
+/* See LICENSE file for license and copyright information */
+
+#ifndef DATABASE_FUZZY_H
+#define DATABASE_FUZZY_H
+
+#include <stdbool.h>
+#include <glib.h>
+
+#include "database.h"
+
+/* longest input that is matched fuzzily */
+#define FUZZY_MAX_LENGTH 64
+
+/* input whose characters are looked for in order, regardless of ASCII case */
+typedef struct jumanji_db_fuzzy_s
+{
+  char pattern[FUZZY_MAX_LENGTH]; /**> Input folded to lower case */
+  char fold[FUZZY_MAX_LENGTH]; /**> 0x20 for letters, so that or-ing it folds
+                                 a character of the text to lower case */
+  size_t length; /**> Length of the input */
+  bool wanted[G_MAXUINT8 + 1]; /**> Characters of the input in either case */
+} jumanji_db_fuzzy_t;
+
+/* links with the best scores */
+typedef struct jumanji_db_fuzzy_top_s
+{
+  GArray* heap; /**> Scored links, the worst one first */
+  unsigned int size; /**> Maximal number of links */
+} jumanji_db_fuzzy_top_t;
+
+/**
+ * Prepares an input for fuzzy matching
+ *
+ * @param fuzzy The prepared input
+ * @param input The input
+ * @return false if the input is empty or too long
+ */
+bool jumanji_db_fuzzy_init(jumanji_db_fuzzy_t* fuzzy, const char* input);
+
+/**
+ * Checks if a text contains the characters of the input in order
+ *
+ * @param fuzzy The prepared input
+ * @param text The text
+ * @param length Length of the text
+ * @return true if the text matches
+ */
+bool jumanji_db_fuzzy_match(const jumanji_db_fuzzy_t* fuzzy, const char* text,
+    size_t length);
+
+/**
+ * Scores how well a text matches the input. Consecutive characters and
+ * characters at the start of words score higher, gaps between them lower.
+ *
+ * @param fuzzy The prepared input
+ * @param text The text, may be NULL
+ * @return The score or -1 if the text does not match
+ */
+int jumanji_db_fuzzy_score(const jumanji_db_fuzzy_t* fuzzy, const char* text);
+
+/**
+ * Scores a link by the better of its url and its title
+ *
+ * @param fuzzy The prepared input
+ * @param url The url of the link
+ * @param title The title of the link, may be NULL
+ * @return The score or -1 if the link does not match
+ */
+int jumanji_db_fuzzy_score_link(const jumanji_db_fuzzy_t* fuzzy, const char*
+    url, const char* title);
+
+/**
+ * Creates a selection of the best links
+ *
+ * @param size Maximal number of links, 0 for no limit
+ * @return The selection
+ */
+jumanji_db_fuzzy_top_t* jumanji_db_fuzzy_top_new(unsigned int size);
+
+/**
+ * Frees a selection and its links
+ *
+ * @param top The selection
+ */
+void jumanji_db_fuzzy_top_free(jumanji_db_fuzzy_top_t* top);
+
+/**
+ * Checks if a link would be selected, before it is copied
+ *
+ * @param top The selection
+ * @param score The score of the link
+ * @param visited Last time the link has been visited, breaks ties
+ * @return true if the link is better than the worst selected one
+ */
+bool jumanji_db_fuzzy_top_accepts(jumanji_db_fuzzy_top_t* top, int score, int
+    visited);
+
+/**
+ * Adds a copy of a link, replacing the worst selected link if the selection
+ * is full
+ *
+ * @param top The selection
+ * @param score The score of the link
+ * @param url The url of the link
+ * @param title The title of the link, may be NULL
+ * @param visited Last time the link has been visited
+ */
+void jumanji_db_fuzzy_top_add(jumanji_db_fuzzy_top_t* top, int score, const
+    char* url, const char* title, int visited);
+
+/**
+ * Calls a function for the selected links, the best one first, until it
+ * returns false
+ *
+ * @param top The selection
+ * @param function Receives the links
+ * @param data Custom data passed to the function
+ */
+void jumanji_db_fuzzy_top_foreach(jumanji_db_fuzzy_top_t* top,
+    jumanji_db_link_function_t function, void* data);
+
+#endif // DATABASE_FUZZY_H
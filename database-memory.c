@@ -0,0 +1,361 @@
+/* See LICENSE file for license and copyright information */
+
+#include <girara/datastructures.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "database.h"
+#include "database-backend.h"
+#include "database-table.h"
+
+typedef struct jumanji_db_memory_s
+{
+  jumanji_db_store_t* store; /**> Links of the bookmarks and the history */
+  jumanji_db_table_t* bookmarks; /**> Bookmarks */
+  jumanji_db_table_t* history; /**> History */
+  jumanji_db_table_t* quickmarks; /**> Quickmarks */
+  GHashTable* sessions; /**> Maps a session name to its list of links */
+} jumanji_db_memory_t;
+
+/* forward declarations */
+static void jumanji_db_memory_free(void* data);
+static girara_list_t* jumanji_db_memory_copy_links(girara_list_t* links);
+static void jumanji_db_memory_foreach(jumanji_db_table_t* table,
+    jumanji_db_link_function_t function, void* data);
+
+static void*
+jumanji_db_memory_init(const char* dir)
+{
+  jumanji_db_memory_t* database = g_malloc0(sizeof(jumanji_db_memory_t));
+  if (database == NULL) {
+    return NULL;
+  }
+
+  /* create tables, the links of both share one store */
+  database->store = jumanji_db_store_new();
+  database->bookmarks = jumanji_db_table_new(g_str_hash, g_str_equal,
+      jumanji_db_link_key, free);
+  database->history = jumanji_db_table_new(g_str_hash, g_str_equal,
+      jumanji_db_link_key, free);
+  database->quickmarks = jumanji_db_table_new(g_direct_hash, g_direct_equal,
+      jumanji_db_quickmark_key, free);
+  database->sessions = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+      (GDestroyNotify) girara_list_free);
+
+  if (database->store == NULL || database->bookmarks == NULL ||
+      database->history == NULL || database->quickmarks == NULL) {
+    jumanji_db_memory_free(database);
+    return NULL;
+  }
+
+  jumanji_db_store_attach(database->store, database->bookmarks);
+  jumanji_db_store_attach(database->store, database->history);
+
+  database->bookmarks->searchable = true;
+  database->history->searchable   = true;
+
+  return database;
+}
+
+static void
+jumanji_db_memory_free(void* data)
+{
+  jumanji_db_memory_t* database = (jumanji_db_memory_t*) data;
+
+  if (database == NULL) {
+    return;
+  }
+
+  /* the links are freed together with the store */
+  jumanji_db_table_free(database->bookmarks);
+  jumanji_db_table_free(database->history);
+  jumanji_db_table_free(database->quickmarks);
+  jumanji_db_store_free(database->store);
+
+  if (database->sessions != NULL) {
+    g_hash_table_destroy(database->sessions);
+  }
+
+  g_free(database);
+}
+
+static bool
+jumanji_db_memory_check_location(const char* dir)
+{
+  return false;
+}
+
+static void
+jumanji_db_memory_begin(void* data)
+{
+}
+
+static void
+jumanji_db_memory_commit(void* data)
+{
+  jumanji_db_memory_t* database = (jumanji_db_memory_t*) data;
+
+  if (database == NULL) {
+    return;
+  }
+
+  jumanji_db_store_repack(database->store);
+}
+
+static void
+jumanji_db_memory_bookmark_add(void* data, const char* url, const char* title)
+{
+  jumanji_db_memory_t* database = (jumanji_db_memory_t*) data;
+
+  if (database == NULL || url == NULL) {
+    return;
+  }
+
+  jumanji_db_table_insert(database->bookmarks,
+      jumanji_db_link_new(database->store, url, title, 0));
+}
+
+static void
+jumanji_db_memory_bookmark_remove(void* data, const char* url)
+{
+  jumanji_db_memory_t* database = (jumanji_db_memory_t*) data;
+
+  if (database == NULL || url == NULL) {
+    return;
+  }
+
+  jumanji_db_table_remove(database->bookmarks, url);
+}
+
+static void
+jumanji_db_memory_bookmark_match(void* data, const char* input, unsigned int
+    limit, jumanji_db_link_function_t function, void* function_data)
+{
+  jumanji_db_memory_t* database = (jumanji_db_memory_t*) data;
+
+  if (database == NULL || input == NULL || function == NULL) {
+    return;
+  }
+
+  jumanji_db_table_match(database->bookmarks, input, function, function_data);
+}
+
+static bool
+jumanji_db_memory_bookmark_exists(void* data, const char* url)
+{
+  jumanji_db_memory_t* database = (jumanji_db_memory_t*) data;
+
+  if (database == NULL || url == NULL) {
+    return false;
+  }
+
+  return jumanji_db_table_lookup(database->bookmarks, url) != NULL;
+}
+
+static void
+jumanji_db_memory_history_add(void* data, const char* url, const char* title,
+    int visited)
+{
+  jumanji_db_memory_t* database = (jumanji_db_memory_t*) data;
+
+  if (database == NULL || url == NULL) {
+    return;
+  }
+
+  jumanji_db_table_insert(database->history,
+      jumanji_db_link_new(database->store, url, title, visited));
+}
+
+static void
+jumanji_db_memory_history_clean(void* data, unsigned int age)
+{
+  jumanji_db_memory_t* database = (jumanji_db_memory_t*) data;
+
+  if (database == NULL) {
+    return;
+  }
+
+  /* collect urls first, removing may compact the order array */
+  GPtrArray* urls = g_ptr_array_new_with_free_func(g_free);
+
+  int visited = time(NULL) - age;
+  for (unsigned int i = 0; i < database->history->order->len; i++) {
+    jumanji_db_result_link_t* link = g_ptr_array_index(database->history->order, i);
+    if (link != NULL && link->visited < visited) {
+      g_ptr_array_add(urls, g_strdup(link->url));
+    }
+  }
+
+  for (unsigned int i = 0; i < urls->len; i++) {
+    jumanji_db_table_remove(database->history, g_ptr_array_index(urls, i));
+  }
+
+  g_ptr_array_free(urls, TRUE);
+}
+
+static void
+jumanji_db_memory_history_match(void* data, const char* input, unsigned int
+    limit, jumanji_db_link_function_t function, void* function_data)
+{
+  jumanji_db_memory_t* database = (jumanji_db_memory_t*) data;
+
+  if (database == NULL || input == NULL || function == NULL) {
+    return;
+  }
+
+  jumanji_db_table_match(database->history, input, function, function_data);
+}
+
+static void
+jumanji_db_memory_quickmark_add(void* data, const char identifier, const char* url)
+{
+  jumanji_db_memory_t* database = (jumanji_db_memory_t*) data;
+
+  if (database == NULL || url == NULL) {
+    return;
+  }
+
+  jumanji_db_table_insert(database->quickmarks,
+      jumanji_db_quickmark_new(identifier, url));
+}
+
+static void
+jumanji_db_memory_quickmark_remove(void* data, const char identifier)
+{
+  jumanji_db_memory_t* database = (jumanji_db_memory_t*) data;
+
+  if (database == NULL) {
+    return;
+  }
+
+  jumanji_db_table_remove(database->quickmarks, GINT_TO_POINTER(identifier));
+}
+
+static char*
+jumanji_db_memory_quickmark_find(void* data, const char identifier)
+{
+  jumanji_db_memory_t* database = (jumanji_db_memory_t*) data;
+
+  if (database == NULL) {
+    return NULL;
+  }
+
+  jumanji_db_quickmark_t* quickmark = jumanji_db_table_lookup(database->quickmarks,
+      GINT_TO_POINTER(identifier));
+
+  return (quickmark != NULL) ? g_strdup(quickmark->url) : NULL;
+}
+
+static void
+jumanji_db_memory_save_session(void* data, const char* name, girara_list_t* urls)
+{
+  jumanji_db_memory_t* database = (jumanji_db_memory_t*) data;
+
+  if (database == NULL || name == NULL || urls == NULL) {
+    return;
+  }
+
+  g_hash_table_replace(database->sessions, g_strdup(name),
+      jumanji_db_memory_copy_links(urls));
+}
+
+static girara_list_t*
+jumanji_db_memory_load_session(void* data, const char* name)
+{
+  jumanji_db_memory_t* database = (jumanji_db_memory_t*) data;
+
+  if (database == NULL || name == NULL) {
+    return NULL;
+  }
+
+  girara_list_t* links = g_hash_table_lookup(database->sessions, name);
+
+  return (links != NULL) ? jumanji_db_memory_copy_links(links) : NULL;
+}
+
+static void
+jumanji_db_memory_bookmark_foreach(void* data, jumanji_db_link_function_t
+    function, void* function_data)
+{
+  jumanji_db_memory_t* database = (jumanji_db_memory_t*) data;
+
+  if (database == NULL || function == NULL) {
+    return;
+  }
+
+  jumanji_db_memory_foreach(database->bookmarks, function, function_data);
+}
+
+static void
+jumanji_db_memory_history_foreach(void* data, jumanji_db_link_function_t
+    function, void* function_data)
+{
+  jumanji_db_memory_t* database = (jumanji_db_memory_t*) data;
+
+  if (database == NULL || function == NULL) {
+    return;
+  }
+
+  jumanji_db_memory_foreach(database->history, function, function_data);
+}
+
+static void
+jumanji_db_memory_foreach(jumanji_db_table_t* table,
+    jumanji_db_link_function_t function, void* data)
+{
+  for (unsigned int i = 0; i < table->order->len; i++) {
+    jumanji_db_result_link_t* link = g_ptr_array_index(table->order, i);
+    if (link != NULL && function(link->url, link->title, link->visited,
+          data) == false) {
+      return;
+    }
+  }
+}
+
+static girara_list_t*
+jumanji_db_memory_copy_links(girara_list_t* links)
+{
+  girara_list_t* copy = girara_list_new2(jumanji_db_free_result_link);
+  if (copy == NULL || girara_list_size(links) == 0) {
+    return copy;
+  }
+
+  girara_list_iterator_t* iter = girara_list_iterator(links);
+  do {
+    jumanji_db_result_link_t* link     = girara_list_iterator_data(iter);
+    jumanji_db_result_link_t* link_dup = malloc(sizeof(jumanji_db_result_link_t));
+    if (link_dup != NULL) {
+      link_dup->url     = g_strdup(link->url);
+      link_dup->title   = g_strdup(link->title);
+      link_dup->visited = link->visited;
+      girara_list_append(copy, link_dup);
+    }
+  } while (girara_list_iterator_next(iter) != NULL);
+  girara_list_iterator_free(iter);
+
+  return copy;
+}
+
+const jumanji_db_backend_t jumanji_db_memory_backend = {
+  .name             = "memory",
+  .init             = jumanji_db_memory_init,
+  .free             = jumanji_db_memory_free,
+  .check_location   = jumanji_db_memory_check_location,
+  .begin            = jumanji_db_memory_begin,
+  .commit           = jumanji_db_memory_commit,
+  .bookmark_add     = jumanji_db_memory_bookmark_add,
+  .bookmark_remove  = jumanji_db_memory_bookmark_remove,
+  .bookmark_match   = jumanji_db_memory_bookmark_match,
+  .bookmark_exists  = jumanji_db_memory_bookmark_exists,
+  .history_add      = jumanji_db_memory_history_add,
+  .history_clean    = jumanji_db_memory_history_clean,
+  .history_match    = jumanji_db_memory_history_match,
+  .quickmark_add    = jumanji_db_memory_quickmark_add,
+  .quickmark_remove = jumanji_db_memory_quickmark_remove,
+  .quickmark_find   = jumanji_db_memory_quickmark_find,
+  .save_session     = jumanji_db_memory_save_session,
+  .load_session     = jumanji_db_memory_load_session,
+  .bookmark_foreach = jumanji_db_memory_bookmark_foreach,
+  .history_foreach  = jumanji_db_memory_history_foreach
+};
@@ -8,68 +8,156 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/file.h>
+#include <sys/mman.h>
 #include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
 #include <stdio.h>
+#include <time.h>
 #include <glib/gstdio.h>
 
 #include "database.h"
+#include "database-backend.h"
+#include "database-segment.h"
+#include "database-snapshot.h"
+#include "database-table.h"
 
 #define BOOKMARKS "bookmarks"
 #define HISTORY "history"
 #define QUICKMARKS "quickmarks"
 #define SESSION_DIR "sessions"
+#define JOURNAL_SUFFIX ".journal"
+#define SNAPSHOT_SUFFIX ".snapshot"
 
-#ifdef __GNU__
-#include <sys/file.h>
+/* the journal is compacted into the base file once it is larger than half of
+ * the base file, but not before it reached this size */
+#define JOURNAL_COMPACT_MIN_SIZE (64 * 1024)
+
+/* every compaction starts a journal with a new generation, which tells other
+ * instances that their offset into the journal became invalid */
+#define JOURNAL_HEADER "#%u\n"
+
+/* milliseconds until a sync is retried while another writer holds the lock */
+#define JOURNAL_RETRY_INTERVAL 100
+
+/* history links that have not been visited for this many seconds are sealed
+ * into compressed segments by the next compaction */
+#define HISTORY_HOT_AGE (30 * 24 * 60 * 60)
+
+/* a compaction is started once the history holds this many cold links */
+#define HISTORY_SEAL_MIN_COUNT 1024
+
+/* flock() locks belong to the open file description, so unlike fcntl() locks
+ * they also exclude the compaction thread of the same process */
 #define file_lock_set(fd, cmd) flock(fd, cmd)
-#else
-#define file_lock_set(fd, cmd) \
-  { \
-  struct flock lock = { .l_type = cmd, .l_start = 0, .l_whence = SEEK_SET, .l_len = 0}; \
-  fcntl(fd, F_SETLK, lock); \
-  }
-#endif
+
+/* append-only journal of a table */
+typedef struct jumanji_db_journal_s
+{
+  gchar* path; /**> Path to the journal file */
+  gchar* base_path; /**> Path to the file the journal is compacted into */
+  gchar* snapshot_path; /**> Path to the snapshot of the base file */
+  bool visited; /**> The base file stores the last visit */
+  jumanji_db_table_t* table; /**> The table the journal belongs to */
+  jumanji_db_snapshot_t* snapshot; /**> Shared snapshot of the base file, the
+                                     table then only holds newer records */
+  GHashTable* removed; /**> Urls of the snapshot that have been removed since */
+  bool snapshot_missing; /**> The base file has no snapshot yet */
+  int fd; /**> File descriptor of the journal */
+  off_t size; /**> Offset up to which the journal has been applied */
+  unsigned int generation; /**> Generation of the journal */
+  off_t base_size; /**> Size of the base file */
+  bool tiered; /**> Cold links are sealed into segments */
+  unsigned int cold; /**> Number of cold links in the table */
+  GString* pending; /**> Records that have not been written yet */
+  GFileMonitor* monitor; /**> File monitor for the journal */
+  GSource* retry; /**> Retries a sync that found the journal locked */
+  GThread* compaction; /**> Running background compaction */
+  volatile gint compaction_done; /**> Set once the compaction has finished */
+  off_t compacted_size; /**> Journal size merged by the compaction */
+  off_t compacted_base_size; /**> Base file size after the compaction */
+  unsigned int compacted_generation; /**> Generation started by the compaction */
+  unsigned int compacted_sealed; /**> Links sealed by the compaction */
+} jumanji_db_journal_t;
+
+typedef struct jumanji_db_plain_s jumanji_db_plain_t;
+
+/* handles a line of a file, the line is NUL-terminated and may be modified */
+typedef void (*jumanji_db_line_function_t)(char* line, void* data);
 
 /* forward declarations */
+static void* jumanji_db_plain_new(const char* dir, bool read_only);
+static void jumanji_db_plain_free(void* data);
+static jumanji_db_journal_t* jumanji_db_journal_new(const char* base_path,
+    jumanji_db_table_t* table, bool visited, bool read_only);
+static void jumanji_db_journal_free(jumanji_db_journal_t* journal);
+static void jumanji_db_journal_load(jumanji_db_journal_t* journal);
+static void jumanji_db_journal_add(jumanji_db_journal_t* journal,
+    jumanji_db_result_link_t* link);
+static void jumanji_db_journal_remove(jumanji_db_journal_t* journal, const
+    char* url);
+static bool jumanji_db_journal_discard(jumanji_db_journal_t* journal, const
+    char* url);
+static bool jumanji_db_journal_contains(const char* url, void* data);
+static bool jumanji_db_journal_hides(const char* url, void* data);
+static bool jumanji_db_journal_match(jumanji_db_journal_t* journal,
+    const char* input, jumanji_db_link_function_t function, void* data);
+static void jumanji_db_journal_foreach(jumanji_db_journal_t* journal,
+    jumanji_db_link_function_t function, void* data);
+static void jumanji_db_parse_delta_line(char* line, void* data);
+static void jumanji_db_journal_flush(jumanji_db_journal_t* journal, bool wait);
+static void jumanji_db_journal_tail(jumanji_db_journal_t* journal, off_t size);
+static void jumanji_db_journal_apply_pending(jumanji_db_journal_t* journal);
+static unsigned int jumanji_db_journal_generation(int fd);
+static gpointer jumanji_db_journal_compact(gpointer data);
+static gboolean cb_jumanji_db_retry_journal(gpointer data);
+static void cb_jumanji_db_watch_journal(GFileMonitor* monitor, GFile* file,
+    GFile* other_file, GFileMonitorEvent event, jumanji_db_journal_t* journal);
+static bool jumanji_db_parse_file(int fd, jumanji_db_line_function_t function,
+    void* data, off_t* size);
+static void jumanji_db_parse_lines(char* buffer, size_t length,
+    jumanji_db_line_function_t function, void* data);
+static unsigned int jumanji_db_split_fields(char* line, char** fields,
+    unsigned int max);
+static void jumanji_db_parse_link_line(char* line, void* data);
+static char* jumanji_db_parse_removal_line(char* line);
+static void jumanji_db_parse_journal_line(char* line, void* data);
+static void jumanji_db_parse_quickmark_line(char* line, void* data);
+static void jumanji_db_parse_session_line(char* line, void* data);
+static void jumanji_db_table_read(jumanji_db_table_t* table, const char*
+    filename, jumanji_db_line_function_t function);
 static void jumanji_db_write_quickmarks_to_file(const char* filename,
-    girara_list_t* quickmarks);
+    GPtrArray* quickmarks);
 static void cb_jumanji_db_watch_file(GFileMonitor* monitor, GFile* file, GFile*
-    other_file, GFileMonitorEvent event, jumanji_database_t* database);
+    other_file, GFileMonitorEvent event, jumanji_db_plain_t* database);
 static bool jumanji_db_check_file(const char* path);
 static bool jumanji_db_check_dir(const char* path);
 static girara_list_t* jumanji_db_read_urls_from_file(const char* filename);
-static girara_list_t* jumanji_db_read_quickmarks_from_file(const char*
-    filename);
-static void jumanji_db_free_quickmark(void* data);
-static girara_list_t* jumanji_db_filter_url_list(girara_list_t* list, const
-    char* input);
-static void jumanji_db_write_urls_to_file(const char* filename, girara_list_t*
+static void jumanji_db_write_urls_to_file(const char* filename, GPtrArray*
     urls, bool visited);
 
-struct jumanji_database_s
+struct jumanji_db_plain_s
 {
   gchar* bookmark_file; /**> File path to the bookmark file */
-  girara_list_t* bookmarks; /**> Temporary bookmarks */
-  GFileMonitor* bookmark_monitor; /**> File monitor for the bookmark file */
+  jumanji_db_table_t* bookmarks; /**> Temporary bookmarks */
+  jumanji_db_journal_t* bookmark_journal; /**> Journal of the bookmarks */
+
+  jumanji_db_store_t* store; /**> Links of the bookmarks and the history */
 
   gchar* history_file; /**> File path to the history file */
-  girara_list_t* history; /**>  Temporary history */
-  GFileMonitor* history_monitor; /**> File monitor for the history file */
+  jumanji_db_table_t* history; /**>  Temporary history */
+  jumanji_db_journal_t* history_journal; /**> Journal of the history */
+  jumanji_db_segments_t* history_segments; /**> Cold segments of the history */
 
   gchar* quickmarks_file; /**> File path to the quickmarks file */
-  girara_list_t* quickmarks; /**>  Temporary quickmarks */
+  jumanji_db_table_t* quickmarks; /**>  Temporary quickmarks */
   GFileMonitor* quickmarks_monitor; /**> File monitor for the quickmarks file */
+  bool quickmarks_changed; /**> The quickmarks file has to be rewritten */
 
   gchar* session_dir; /**> Path to the session directory */
 };
 
-typedef struct jumanji_db_quickmark_s
-{
-  char identifier; /**> Quickmark identifier */
-  char* url; /**> Url */
-} jumanji_db_quickmark_t;
-
-
 static bool
 jumanji_db_check_file(const char* path)
 {
@@ -101,74 +189,96 @@ jumanji_db_check_dir(const char* path)
   return g_file_test(path, G_FILE_TEST_IS_DIR);
 }
 
-jumanji_database_t*
-jumanji_db_init(const char* dir)
+static void*
+jumanji_db_plain_init(const char* dir)
+{
+  return jumanji_db_plain_new(dir, false);
+}
+
+void*
+jumanji_db_plain_open(const char* dir)
+{
+  return jumanji_db_plain_new(dir, true);
+}
+
+static void*
+jumanji_db_plain_new(const char* dir, bool read_only)
 {
   if (dir == NULL) {
     goto error_ret;
   }
 
-  jumanji_database_t* database = g_malloc0(sizeof(jumanji_database_t));
+  jumanji_db_plain_t* database = g_malloc0(sizeof(jumanji_db_plain_t));
   if (database == NULL) {
     goto error_ret;
   }
 
-  /* get bookmark file path */
-  database->bookmark_file = g_build_filename(dir, BOOKMARKS, NULL);
-  if (database->bookmark_file == NULL ||
-      jumanji_db_check_file(database->bookmark_file) == false) {
-    goto error_free;
-  }
+  /* get file paths, files that are only read may be missing */
+  database->bookmark_file   = g_build_filename(dir, BOOKMARKS, NULL);
+  database->history_file    = g_build_filename(dir, HISTORY, NULL);
+  database->quickmarks_file = g_build_filename(dir, QUICKMARKS, NULL);
+  database->session_dir     = g_build_filename(dir, SESSION_DIR, NULL);
 
-  /* get history file path */
-  database->history_file = g_build_filename(dir, HISTORY, NULL);
-  if (database->history_file == NULL ||
-      jumanji_db_check_file(database->history_file) == false) {
+  if (database->bookmark_file == NULL || database->history_file == NULL ||
+      database->quickmarks_file == NULL || database->session_dir == NULL) {
     goto error_free;
   }
 
-  /* get quickmarks file path */
-  database->quickmarks_file = g_build_filename(dir, QUICKMARKS, NULL);
-  if (database->quickmarks_file == NULL ||
-      jumanji_db_check_file(database->quickmarks_file) == false) {
+  if (read_only == false &&
+      (jumanji_db_check_file(database->bookmark_file)   == false ||
+       jumanji_db_check_file(database->history_file)    == false ||
+       jumanji_db_check_file(database->quickmarks_file) == false ||
+       jumanji_db_check_dir(database->session_dir)      == false)) {
     goto error_free;
   }
 
-  /* get session dir path */
-  database->session_dir = g_build_filename(dir, SESSION_DIR, NULL);
-  if (database->session_dir == NULL ||
-      jumanji_db_check_dir(database->session_dir) == false) {
+  /* create tables, the links of both share one store */
+  database->store = jumanji_db_store_new();
+  database->bookmarks = jumanji_db_table_new(g_str_hash, g_str_equal,
+      jumanji_db_link_key, free);
+  database->history = jumanji_db_table_new(g_str_hash, g_str_equal,
+      jumanji_db_link_key, free);
+  database->quickmarks = jumanji_db_table_new(g_direct_hash, g_direct_equal,
+      jumanji_db_quickmark_key, free);
+
+  if (database->store == NULL || database->bookmarks == NULL ||
+      database->history == NULL || database->quickmarks == NULL) {
     goto error_free;
   }
 
-  /* read files */
-  database->bookmarks  = jumanji_db_read_urls_from_file(database->bookmark_file);
-  database->history    = jumanji_db_read_urls_from_file(database->history_file);
-  database->quickmarks = jumanji_db_read_quickmarks_from_file(database->quickmarks_file);
+  jumanji_db_store_attach(database->store, database->bookmarks);
+  jumanji_db_store_attach(database->store, database->history);
 
-  girara_list_set_free_function(database->bookmarks,  jumanji_db_free_result_link);
-  girara_list_set_free_function(database->history,    jumanji_db_free_result_link);
-  girara_list_set_free_function(database->quickmarks, jumanji_db_free_quickmark);
+  database->bookmarks->searchable = true;
+  database->history->searchable   = true;
 
-  /* setup file monitors */
-  GFile* bookmark_file = g_file_new_for_path(database->bookmark_file);
-  if (bookmark_file != NULL) {
-    database->bookmark_monitor = g_file_monitor(bookmark_file,
-        G_FILE_MONITOR_NONE, NULL, NULL);
-  } else {
+  /* open journals, loading replays them on top of the base files */
+  database->bookmark_journal = jumanji_db_journal_new(database->bookmark_file,
+      database->bookmarks, false, read_only);
+  database->history_journal = jumanji_db_journal_new(database->history_file,
+      database->history, true, read_only);
+
+  if (database->bookmark_journal == NULL || database->history_journal == NULL) {
     goto error_free;
   }
-  g_object_unref(bookmark_file);
 
-  GFile* history_file = g_file_new_for_path(database->history_file);
-  if (history_file != NULL) {
-    database->history_monitor = g_file_monitor(history_file,
-        G_FILE_MONITOR_NONE, NULL, NULL);
-  } else {
+  database->history_journal->tiered = true;
+  database->history_segments = jumanji_db_segments_new(database->history_file);
+  if (database->history_segments == NULL) {
     goto error_free;
   }
-  g_object_unref(history_file);
 
+  /* read files */
+  jumanji_db_journal_load(database->bookmark_journal);
+  jumanji_db_journal_load(database->history_journal);
+  jumanji_db_table_read(database->quickmarks, database->quickmarks_file,
+      jumanji_db_parse_quickmark_line);
+
+  if (read_only == true) {
+    return database;
+  }
+
+  /* setup file monitors */
   GFile* quickmarks_file = g_file_new_for_path(database->quickmarks_file);
   if (quickmarks_file != NULL) {
     database->quickmarks_monitor = g_file_monitor(quickmarks_file,
@@ -178,15 +288,10 @@ jumanji_db_init(const char* dir)
   }
   g_object_unref(quickmarks_file);
 
-  if (database->bookmark_monitor == NULL || database->history_monitor == NULL ||
-      database->quickmarks_monitor == NULL) {
+  if (database->quickmarks_monitor == NULL) {
     goto error_free;
   }
 
-  g_signal_connect(G_OBJECT(database->bookmark_monitor), "changed",
-      G_CALLBACK(cb_jumanji_db_watch_file), database);
-  g_signal_connect(G_OBJECT(database->history_monitor), "changed",
-      G_CALLBACK(cb_jumanji_db_watch_file), database);
   g_signal_connect(G_OBJECT(database->quickmarks_monitor), "changed",
       G_CALLBACK(cb_jumanji_db_watch_file), database);
 
@@ -194,15 +299,15 @@ jumanji_db_init(const char* dir)
 
 error_free:
 
-  jumanji_db_free(database);
+  jumanji_db_plain_free(database);
 
 error_ret:
 
   return NULL;
 }
 
-bool
-jumanji_db_check_location(const char* dir)
+static bool
+jumanji_db_plain_check_location(const char* dir)
 {
   if (dir == NULL) {
     return false;
@@ -241,28 +346,30 @@ jumanji_db_check_location(const char* dir)
   return false;
 }
 
-void
-jumanji_db_free(jumanji_database_t* database)
+static void
+jumanji_db_plain_free(void* data)
 {
+  jumanji_db_plain_t* database = (jumanji_db_plain_t*) data;
+
   if (database == NULL) {
     return;
   }
 
+  /* write outstanding records and wait for running compactions */
+  jumanji_db_journal_free(database->bookmark_journal);
+  jumanji_db_journal_free(database->history_journal);
+  jumanji_db_segments_free(database->history_segments);
+
   g_free(database->bookmark_file);
   g_free(database->history_file);
   g_free(database->quickmarks_file);
+  g_free(database->session_dir);
 
-  girara_list_free(database->bookmarks);
-  girara_list_free(database->history);
-  girara_list_free(database->quickmarks);
-
-  if (database->bookmark_monitor != NULL) {
-    g_object_unref(database->bookmark_monitor);
-  }
-
-  if (database->history_monitor != NULL) {
-    g_object_unref(database->history_monitor);
-  }
+  /* the links are freed together with the store */
+  jumanji_db_table_free(database->bookmarks);
+  jumanji_db_table_free(database->history);
+  jumanji_db_table_free(database->quickmarks);
+  jumanji_db_store_free(database->store);
 
   if (database->quickmarks_monitor != NULL) {
     g_object_unref(database->quickmarks_monitor);
@@ -271,527 +378,1131 @@ jumanji_db_free(jumanji_database_t* database)
   g_free(database);
 }
 
-girara_list_t*
-jumanji_db_bookmark_find(jumanji_database_t* database, const char* input)
+static void
+jumanji_db_plain_begin(void* data)
 {
-  if (database == NULL || database->bookmarks == NULL || input == NULL) {
-    return NULL;
-  }
-
-  return jumanji_db_filter_url_list(database->bookmarks, input);
+  /* records are collected in the pending buffers of the journals */
 }
 
-void
-jumanji_db_bookmark_remove(jumanji_database_t* database, const char* url)
+static void
+jumanji_db_plain_commit(void* data)
 {
-  if (database == NULL || database->bookmarks == NULL || url == NULL) {
+  jumanji_db_plain_t* database = (jumanji_db_plain_t*) data;
+
+  if (database == NULL) {
     return;
   }
 
-  /* remove url from list */
-  if (girara_list_size(database->bookmarks) > 0) {
-    girara_list_iterator_t* iter = girara_list_iterator(database->bookmarks);
+  /* each journal receives the records of the whole batch in one write */
+  jumanji_db_journal_flush(database->bookmark_journal, false);
+  jumanji_db_journal_flush(database->history_journal, false);
 
-    do {
-      jumanji_db_result_link_t* link = (jumanji_db_result_link_t*) girara_list_iterator_data(iter);
+  if (database->quickmarks_changed == true) {
+    jumanji_db_write_quickmarks_to_file(database->quickmarks_file,
+        database->quickmarks->order);
+    database->quickmarks_changed = false;
+  }
 
-      if (strcmp(link->url, url) == 0) {
-        girara_list_remove(database->bookmarks, link);
-      }
-    } while (girara_list_iterator_next(iter) != NULL);
+  jumanji_db_store_repack(database->store);
+}
 
-    girara_list_iterator_free(iter);
+static void
+jumanji_db_plain_bookmark_match(void* data, const char* input, unsigned int
+    limit, jumanji_db_link_function_t function, void* function_data)
+{
+  jumanji_db_plain_t* database = (jumanji_db_plain_t*) data;
+
+  if (database == NULL || database->bookmarks == NULL || input == NULL ||
+      function == NULL) {
+    return;
+  }
+
+  jumanji_db_journal_match(database->bookmark_journal, input, function,
+      function_data);
+}
+
+static bool
+jumanji_db_plain_bookmark_exists(void* data, const char* url)
+{
+  jumanji_db_plain_t* database = (jumanji_db_plain_t*) data;
 
-    jumanji_db_write_urls_to_file(database->bookmark_file, database->bookmarks, false);
-    g_signal_connect(G_OBJECT(database->bookmark_monitor), "changed",
-        G_CALLBACK(cb_jumanji_db_watch_file), database);
+  if (database == NULL || database->bookmarks == NULL || url == NULL) {
+    return false;
   }
+
+  return jumanji_db_journal_contains(url, database->bookmark_journal);
 }
 
-void
-jumanji_db_bookmark_add(jumanji_database_t* database, const char* url, const char* title)
+static void
+jumanji_db_plain_bookmark_remove(void* data, const char* url)
 {
+  jumanji_db_plain_t* database = (jumanji_db_plain_t*) data;
+
   if (database == NULL || database->bookmarks == NULL || url == NULL) {
     return;
   }
 
-  /* search for existing entry and update it */
-  if (girara_list_size(database->bookmarks) > 0) {
-    girara_list_iterator_t* iter = girara_list_iterator(database->bookmarks);
-    do {
-      jumanji_db_result_link_t* link = (jumanji_db_result_link_t*) girara_list_iterator_data(iter);
-      if (link == NULL) {
-        continue;
-      }
+  /* remove url from table and snapshot */
+  if (jumanji_db_journal_discard(database->bookmark_journal, url) == true) {
+    jumanji_db_journal_remove(database->bookmark_journal, url);
+  }
+}
 
-      if (strstr(link->url, url) != NULL) {
-        g_free(link->title);
-        link->title = title ? g_strdup(title) : NULL;
-        jumanji_db_write_urls_to_file(database->bookmark_file, database->bookmarks, false);
-        g_signal_connect(G_OBJECT(database->bookmark_monitor), "changed",
-            G_CALLBACK(cb_jumanji_db_watch_file), database);
-        girara_list_iterator_free(iter);
-        return;
-      }
-    } while (girara_list_iterator_next(iter) != NULL);
-    girara_list_iterator_free(iter);
+static void
+jumanji_db_plain_bookmark_add(void* data, const char* url, const char* title)
+{
+  jumanji_db_plain_t* database = (jumanji_db_plain_t*) data;
+
+  if (database == NULL || database->bookmarks == NULL || url == NULL) {
+    return;
   }
 
-  /* add url to list */
-  jumanji_db_result_link_t* link = (jumanji_db_result_link_t*) malloc(sizeof(jumanji_db_result_link_t));
+  /* add url to table, this replaces an existing entry */
+  jumanji_db_result_link_t* link = jumanji_db_link_new(database->store, url, title, 0);
   if (link == NULL) {
     return;
   }
 
-  link->url     = g_strdup(url);
-  link->title   = g_strdup(title);
-  link->visited = 0;
+  jumanji_db_table_insert(database->bookmarks, link);
 
-  girara_list_append(database->bookmarks, link);
+  /* write to journal */
+  jumanji_db_journal_add(database->bookmark_journal, link);
+}
 
-  /* write to file */
-  jumanji_db_write_urls_to_file(database->bookmark_file, database->bookmarks, false);
-  g_signal_connect(G_OBJECT(database->bookmark_monitor), "changed",
-      G_CALLBACK(cb_jumanji_db_watch_file), database);
+static void
+jumanji_db_plain_history_match(void* data, const char* input, unsigned int
+    limit, jumanji_db_link_function_t function, void* function_data)
+{
+  jumanji_db_plain_t* database = (jumanji_db_plain_t*) data;
+
+  if (database == NULL || database->history == NULL || input == NULL ||
+      function == NULL) {
+    return;
+  }
+
+  if (jumanji_db_journal_match(database->history_journal, input, function,
+        function_data) == false) {
+    return;
+  }
+
+  /* hot links are newer than their sealed versions */
+  jumanji_db_segments_match(database->history_segments, input,
+      jumanji_db_journal_contains, database->history_journal, function,
+      function_data);
 }
 
-girara_list_t*
-jumanji_db_history_find(jumanji_database_t* database, const char* input)
+static void
+jumanji_db_plain_bookmark_foreach(void* data, jumanji_db_link_function_t
+    function, void* function_data)
 {
-  if (database == NULL || database->history == NULL || input == NULL) {
-    return NULL;
+  jumanji_db_plain_t* database = (jumanji_db_plain_t*) data;
+
+  if (database == NULL || database->bookmarks == NULL || function == NULL) {
+    return;
   }
 
-  return jumanji_db_filter_url_list(database->history, input);
+  jumanji_db_journal_foreach(database->bookmark_journal, function,
+      function_data);
 }
 
-void
-jumanji_db_history_add(jumanji_database_t* database, const char* url, const char* title)
+static void
+jumanji_db_plain_history_foreach(void* data, jumanji_db_link_function_t
+    function, void* function_data)
 {
-  if (database == NULL || database->history == NULL || url == NULL) {
+  jumanji_db_plain_t* database = (jumanji_db_plain_t*) data;
+
+  if (database == NULL || database->history == NULL || function == NULL) {
     return;
   }
 
-  /* search for existing entry and update it */
-  if (girara_list_size(database->history) > 0) {
-    girara_list_iterator_t* iter = girara_list_iterator(database->history);
-    do {
-      jumanji_db_result_link_t* link = (jumanji_db_result_link_t*) girara_list_iterator_data(iter);
-      if (link == NULL) {
-        continue;
-      }
+  jumanji_db_journal_foreach(database->history_journal, function,
+      function_data);
 
-      if (strstr(link->url, url) != NULL) {
-        g_free(link->title);
-        link->title   = title ? g_strdup(title) : NULL;
-        link->visited = time(NULL);
-        jumanji_db_write_urls_to_file(database->history_file, database->history, false);
-        g_signal_connect(G_OBJECT(database->history_monitor), "changed",
-            G_CALLBACK(cb_jumanji_db_watch_file), database);
-        girara_list_iterator_free(iter);
-        return;
-      }
-    } while (girara_list_iterator_next(iter) != NULL);
-    girara_list_iterator_free(iter);
+  /* hot links are newer than their sealed versions */
+  jumanji_db_segments_foreach(database->history_segments,
+      jumanji_db_journal_contains, database->history_journal, function,
+      function_data);
+}
+
+static void
+jumanji_db_plain_history_add(void* data, const char* url, const char* title,
+    int visited)
+{
+  jumanji_db_plain_t* database = (jumanji_db_plain_t*) data;
+
+  if (database == NULL || database->history == NULL || url == NULL) {
+    return;
   }
 
-  /* add url to list */
-  jumanji_db_result_link_t* link = (jumanji_db_result_link_t*) malloc(sizeof(jumanji_db_result_link_t));
+  /* add url to table, this replaces an existing entry */
+  jumanji_db_result_link_t* link = jumanji_db_link_new(database->store, url, title,
+      visited);
   if (link == NULL) {
     return;
   }
 
-  link->url     = g_strdup(url);
-  link->title   = g_strdup(title);
-  link->visited = time(NULL);
-
-  girara_list_append(database->history, link);
+  jumanji_db_table_insert(database->history, link);
 
-  /* write to file */
-  jumanji_db_write_urls_to_file(database->history_file, database->history, false);
-  g_signal_connect(G_OBJECT(database->history_monitor), "changed",
-      G_CALLBACK(cb_jumanji_db_watch_file), database);
+  /* write to journal */
+  jumanji_db_journal_add(database->history_journal, link);
 }
 
-void
-jumanji_db_history_clean(jumanji_database_t* database, unsigned int age)
+static void
+jumanji_db_plain_history_clean(void* data, unsigned int age)
 {
+  jumanji_db_plain_t* database = (jumanji_db_plain_t*) data;
+
   if (database == NULL || database->history == NULL) {
     return;
   }
 
-  /* remove urls from list */
-  if (girara_list_size(database->history) > 0) {
-    girara_list_iterator_t* iter = girara_list_iterator(database->history);
+  /* collect urls first, removing may compact the order array */
+  girara_list_t* urls = girara_list_new2(g_free);
+  if (urls == NULL) {
+    return;
+  }
 
-    int visited = time(NULL) - age;
-    do {
-      jumanji_db_result_link_t* link = (jumanji_db_result_link_t*) girara_list_iterator_data(iter);
+  int visited = time(NULL) - age;
+  for (unsigned int i = 0; i < database->history->order->len; i++) {
+    jumanji_db_result_link_t* link = g_ptr_array_index(database->history->order, i);
+    if (link != NULL && link->visited < visited) {
+      girara_list_append(urls, g_strdup(link->url));
+    }
+  }
 
-      if (link->visited >= visited) {
-        girara_list_remove(database->history, link);
-      }
-    } while (girara_list_iterator_next(iter) != NULL);
+  jumanji_db_journal_t* journal = database->history_journal;
+  for (unsigned int i = 0; i < jumanji_db_snapshot_size(journal->snapshot); i++) {
+    jumanji_db_result_link_t link;
+    jumanji_db_snapshot_get(journal->snapshot, i, &link);
+    if (link.visited < visited &&
+        jumanji_db_journal_hides(link.url, journal) == false) {
+      girara_list_append(urls, g_strdup(link.url));
+    }
+  }
 
+  /* remove urls from table and snapshot */
+  if (girara_list_size(urls) > 0) {
+    girara_list_iterator_t* iter = girara_list_iterator(urls);
+    do {
+      char* url = girara_list_iterator_data(iter);
+      jumanji_db_journal_discard(journal, url);
+      jumanji_db_journal_remove(journal, url);
+    } while (girara_list_iterator_next(iter) != NULL);
     girara_list_iterator_free(iter);
-
-    jumanji_db_write_urls_to_file(database->history_file, database->history, false);
-    g_signal_connect(G_OBJECT(database->history_monitor), "changed",
-        G_CALLBACK(cb_jumanji_db_watch_file), database);
   }
+
+  girara_list_free(urls);
+
+  /* sealed links have not been visited for HISTORY_HOT_AGE seconds, the
+   * segments are only rewritten if they hold links visited before */
+  int fd = database->history_journal->fd;
+  file_lock_set(fd, LOCK_EX);
+  jumanji_db_segments_seal(database->history_file, NULL, visited);
+  file_lock_set(fd, LOCK_UN);
 }
 
-void
-jumanji_db_quickmark_add(jumanji_database_t* database, const char identifier, const char* url)
+static void
+jumanji_db_plain_quickmark_add(void* data, const char identifier, const char* url)
 {
+  jumanji_db_plain_t* database = (jumanji_db_plain_t*) data;
+
   if (database == NULL || database->quickmarks == NULL || url == NULL) {
     return;
   }
 
-  /* search for existing entry and update it */
-  if (girara_list_size(database->quickmarks) > 0) {
-    girara_list_iterator_t* iter = girara_list_iterator(database->quickmarks);
-    do {
-      jumanji_db_quickmark_t* quickmark = (jumanji_db_quickmark_t*) girara_list_iterator_data(iter);
-      if (quickmark == NULL) {
-        continue;
-      }
+  /* add url to table, this replaces an existing entry */
+  jumanji_db_quickmark_t* quickmark = jumanji_db_quickmark_new(identifier, url);
+  if (quickmark == NULL) {
+    return;
+  }
 
-      if (quickmark->identifier == identifier) {
-        g_free(quickmark->url);
-        quickmark->url = g_strdup(url);
+  jumanji_db_table_insert(database->quickmarks, quickmark);
 
-        jumanji_db_write_quickmarks_to_file(database->quickmarks_file, database->quickmarks);
-        g_signal_connect(G_OBJECT(database->quickmarks_monitor), "changed",
-            G_CALLBACK(cb_jumanji_db_watch_file), database);
-        girara_list_iterator_free(iter);
-        return;
-      }
-    } while (girara_list_iterator_next(iter) != NULL);
-    girara_list_iterator_free(iter);
+  /* the file is rewritten once the batch is committed */
+  database->quickmarks_changed = true;
+}
+
+static char*
+jumanji_db_plain_quickmark_find(void* data, const char identifier)
+{
+  jumanji_db_plain_t* database = (jumanji_db_plain_t*) data;
+
+  if (database == NULL || database->quickmarks == NULL) {
+    return NULL;
   }
 
-  /* add url to list */
-  jumanji_db_quickmark_t* quickmark = (jumanji_db_quickmark_t*) malloc(sizeof(jumanji_db_quickmark_t));
-  if (quickmark == NULL) {
+  jumanji_db_quickmark_t* quickmark = jumanji_db_table_lookup(database->quickmarks,
+      GINT_TO_POINTER(identifier));
+
+  return (quickmark != NULL) ? g_strdup(quickmark->url) : NULL;
+}
+
+static void
+jumanji_db_plain_quickmark_remove(void* data, const char identifier)
+{
+  jumanji_db_plain_t* database = (jumanji_db_plain_t*) data;
+
+  if (database == NULL || database->quickmarks == NULL) {
     return;
   }
 
-  quickmark->url        = g_strdup(url);
-  quickmark->identifier = identifier;
+  if (jumanji_db_table_remove(database->quickmarks, GINT_TO_POINTER(identifier)) == true) {
+    database->quickmarks_changed = true;
+  }
+}
 
-  girara_list_append(database->quickmarks, quickmark);
+static jumanji_db_journal_t*
+jumanji_db_journal_new(const char* base_path, jumanji_db_table_t* table, bool
+    visited, bool read_only)
+{
+  jumanji_db_journal_t* journal = g_malloc0(sizeof(jumanji_db_journal_t));
+  if (journal == NULL) {
+    return NULL;
+  }
 
-  /* write to file */
-  jumanji_db_write_quickmarks_to_file(database->quickmarks_file, database->quickmarks);
-  g_signal_connect(G_OBJECT(database->quickmarks_monitor), "changed",
-      G_CALLBACK(cb_jumanji_db_watch_file), database);
+  journal->base_path     = g_strdup(base_path);
+  journal->path          = g_strconcat(base_path, JOURNAL_SUFFIX, NULL);
+  journal->snapshot_path = g_strconcat(base_path, SNAPSHOT_SUFFIX, NULL);
+  journal->removed       = g_hash_table_new_full(g_str_hash, g_str_equal,
+      g_free, NULL);
+  journal->table         = table;
+  journal->visited   = visited;
+  journal->pending   = g_string_new(NULL);
+  journal->fd        = -1;
+
+  /* loading opens the journal by itself, it is only kept open for writes */
+  if (read_only == true) {
+    return journal;
+  }
+
+  journal->fd = open(journal->path, O_RDWR | O_APPEND | O_CREAT, 0666);
+
+  if (journal->fd == -1) {
+    girara_error("Could not open journal: %s", journal->path);
+    jumanji_db_journal_free(journal);
+    return NULL;
+  }
+
+  GFile* file = g_file_new_for_path(journal->path);
+  if (file != NULL) {
+    journal->monitor = g_file_monitor(file, G_FILE_MONITOR_NONE, NULL, NULL);
+    g_object_unref(file);
+  }
+
+  if (journal->monitor == NULL) {
+    jumanji_db_journal_free(journal);
+    return NULL;
+  }
+
+  g_signal_connect(G_OBJECT(journal->monitor), "changed",
+      G_CALLBACK(cb_jumanji_db_watch_journal), journal);
+
+  return journal;
+}
+
+static void
+jumanji_db_journal_free(jumanji_db_journal_t* journal)
+{
+  if (journal == NULL) {
+    return;
+  }
+
+  if (journal->monitor != NULL) {
+    g_signal_handlers_disconnect_by_data(G_OBJECT(journal->monitor), journal);
+    g_object_unref(journal->monitor);
+  }
+
+  if (journal->retry != NULL) {
+    g_source_destroy(journal->retry);
+    g_source_unref(journal->retry);
+  }
+
+  /* the flush also waits for a running compaction and collects it */
+  if (journal->fd != -1) {
+    jumanji_db_journal_flush(journal, true);
+    close(journal->fd);
+  }
+
+  jumanji_db_snapshot_free(journal->snapshot);
+  g_hash_table_destroy(journal->removed);
+  g_string_free(journal->pending, TRUE);
+  g_free(journal->base_path);
+  g_free(journal->snapshot_path);
+  g_free(journal->path);
+  g_free(journal);
 }
 
-char*
-jumanji_db_quickmark_find(jumanji_database_t* database, const char identifier)
+static void
+jumanji_db_journal_load(jumanji_db_journal_t* journal)
 {
-  if (database == NULL || database->quickmarks == NULL) {
-    return NULL;
+  jumanji_db_table_clear(journal->table);
+  g_hash_table_remove_all(journal->removed);
+  jumanji_db_snapshot_free(journal->snapshot);
+  journal->snapshot = NULL;
+
+  /* hold the journal lock, so that no compaction replaces the base file while
+   * it is read */
+  int fd = open(journal->path, O_RDONLY);
+  if (fd != -1) {
+    file_lock_set(fd, LOCK_SH);
+    journal->generation = jumanji_db_journal_generation(fd);
   }
 
-  /* search for existing entry */
-  if (girara_list_size(database->quickmarks) > 0) {
-    char* url = NULL;
-    girara_list_iterator_t* iter = girara_list_iterator(database->quickmarks);
-    do {
-      jumanji_db_quickmark_t* quickmark = (jumanji_db_quickmark_t*) girara_list_iterator_data(iter);
-      if (quickmark == NULL) {
-        continue;
+  struct stat buf;
+  journal->base_size = (stat(journal->base_path, &buf) == 0) ? buf.st_size : 0;
+
+  /* a snapshot written together with the base file replaces reading it, the
+   * table then only holds the records of the journal */
+  journal->snapshot = jumanji_db_snapshot_open(journal->snapshot_path);
+  if (jumanji_db_snapshot_matches(journal->snapshot, journal->generation,
+        journal->base_size) == false) {
+    jumanji_db_snapshot_free(journal->snapshot);
+    journal->snapshot = NULL;
+
+    jumanji_db_table_read(journal->table, journal->base_path,
+        jumanji_db_parse_link_line);
+  }
+
+  journal->snapshot_missing = (journal->snapshot == NULL && journal->base_size > 0);
+
+  if (fd != -1) {
+    jumanji_db_parse_file(fd, jumanji_db_parse_delta_line, journal,
+        &journal->size);
+
+    file_lock_set(fd, LOCK_UN);
+    close(fd);
+  }
+
+  jumanji_db_journal_apply_pending(journal);
+
+  if (journal->tiered == true) {
+    int threshold = time(NULL) - HISTORY_HOT_AGE;
+
+    journal->cold = 0;
+    for (unsigned int i = 0; i < journal->table->order->len; i++) {
+      jumanji_db_result_link_t* link = g_ptr_array_index(journal->table->order, i);
+      if (link != NULL && link->visited < threshold) {
+        journal->cold++;
       }
+    }
 
-      if (quickmark->identifier == identifier) {
-        url = g_strdup(quickmark->url);
-        break;
+    for (unsigned int i = 0; i < jumanji_db_snapshot_size(journal->snapshot); i++) {
+      jumanji_db_result_link_t link;
+      jumanji_db_snapshot_get(journal->snapshot, i, &link);
+      if (link.visited < threshold) {
+        journal->cold++;
       }
-    } while (girara_list_iterator_next(iter) != NULL);
-    girara_list_iterator_free(iter);
+    }
+  }
+}
+
+static void
+jumanji_db_parse_delta_line(char* line, void* data)
+{
+  jumanji_db_journal_t* journal = (jumanji_db_journal_t*) data;
 
-    return url;
+  if (line[0] == '-') {
+    char* url = jumanji_db_parse_removal_line(line + 1);
+    if (url != NULL) {
+      jumanji_db_journal_discard(journal, url);
+    }
   } else {
-    return NULL;
+    jumanji_db_parse_journal_line(line, journal->table);
   }
 }
 
-void
-jumanji_db_quickmark_remove(jumanji_database_t* database, const char identifier)
+static void
+jumanji_db_parse_journal_line(char* line, void* data)
 {
-  if (database == NULL || database->quickmarks == NULL) {
+  if (line[0] == '+') {
+    jumanji_db_parse_link_line(line + 1, data);
+  } else if (line[0] == '-') {
+    char* url = jumanji_db_parse_removal_line(line + 1);
+    if (url != NULL) {
+      jumanji_db_table_remove((jumanji_db_table_t*) data, url);
+    }
+  }
+}
+
+static void
+jumanji_db_journal_add(jumanji_db_journal_t* journal,
+    jumanji_db_result_link_t* link)
+{
+  if (journal == NULL || link == NULL) {
     return;
   }
 
-  /* search for existing entry */
-  if (girara_list_size(database->quickmarks) > 0) {
-    girara_list_iterator_t* iter = girara_list_iterator(database->quickmarks);
-    do {
-      jumanji_db_quickmark_t* quickmark = (jumanji_db_quickmark_t*) girara_list_iterator_data(iter);
-      if (quickmark == NULL) {
-        continue;
+  char* url_quoted   = g_shell_quote(link->url);
+  char* title_quoted = g_shell_quote(link->title ? link->title : "");
+  g_string_append_printf(journal->pending, "+%s %s %d\n", url_quoted,
+      title_quoted, link->visited);
+  g_free(url_quoted);
+  g_free(title_quoted);
+}
+
+static void
+jumanji_db_journal_remove(jumanji_db_journal_t* journal, const char* url)
+{
+  if (journal == NULL || url == NULL) {
+    return;
+  }
+
+  char* url_quoted = g_shell_quote(url);
+  g_string_append_printf(journal->pending, "-%s\n", url_quoted);
+  g_free(url_quoted);
+}
+
+static bool
+jumanji_db_journal_discard(jumanji_db_journal_t* journal, const char* url)
+{
+  bool removed = jumanji_db_table_remove(journal->table, url);
+
+  if (jumanji_db_snapshot_contains(journal->snapshot, url) == true &&
+      g_hash_table_lookup_extended(journal->removed, url, NULL, NULL) == FALSE) {
+    g_hash_table_insert(journal->removed, g_strdup(url), NULL);
+    removed = true;
+  }
+
+  return removed;
+}
+
+static bool
+jumanji_db_journal_contains(const char* url, void* data)
+{
+  jumanji_db_journal_t* journal = (jumanji_db_journal_t*) data;
+
+  return jumanji_db_table_lookup(journal->table, url) != NULL ||
+    (jumanji_db_snapshot_contains(journal->snapshot, url) == true &&
+     g_hash_table_lookup_extended(journal->removed, url, NULL, NULL) == FALSE);
+}
+
+static bool
+jumanji_db_journal_hides(const char* url, void* data)
+{
+  jumanji_db_journal_t* journal = (jumanji_db_journal_t*) data;
+
+  /* the table holds the newer version of a link */
+  return jumanji_db_table_lookup(journal->table, url) != NULL ||
+    g_hash_table_lookup_extended(journal->removed, url, NULL, NULL) == TRUE;
+}
+
+static bool
+jumanji_db_journal_match(jumanji_db_journal_t* journal, const char* input,
+    jumanji_db_link_function_t function, void* data)
+{
+  if (jumanji_db_table_match(journal->table, input, function, data) == false) {
+    return false;
+  }
+
+  return jumanji_db_snapshot_match(journal->snapshot, input,
+      jumanji_db_journal_hides, journal, function, data);
+}
+
+static void
+jumanji_db_journal_foreach(jumanji_db_journal_t* journal,
+    jumanji_db_link_function_t function, void* data)
+{
+  for (unsigned int i = 0; i < journal->table->order->len; i++) {
+    jumanji_db_result_link_t* link = g_ptr_array_index(journal->table->order, i);
+    if (link != NULL && function(link->url, link->title, link->visited,
+          data) == false) {
+      return;
+    }
+  }
+
+  for (unsigned int i = 0; i < jumanji_db_snapshot_size(journal->snapshot); i++) {
+    jumanji_db_result_link_t link;
+    jumanji_db_snapshot_get(journal->snapshot, i, &link);
+    if (jumanji_db_journal_hides(link.url, journal) == false &&
+        function(link.url, link.title, link.visited, data) == false) {
+      return;
+    }
+  }
+}
+
+static void
+jumanji_db_journal_flush(jumanji_db_journal_t* journal, bool wait)
+{
+  bool reload = false;
+
+  /* collect a finished compaction, or wait for a running one if asked to,
+   * unless the journal has been reloaded since */
+  if (journal->compaction != NULL && (wait == true ||
+        g_atomic_int_get(&journal->compaction_done) == 1)) {
+    g_thread_join(journal->compaction);
+    journal->compaction      = NULL;
+    journal->compaction_done = 0;
+
+    if (journal->compacted_size >= 0 &&
+        journal->compacted_generation != journal->generation) {
+      /* the new snapshot replaces the table, which also drops sealed links
+       * and records of other instances that were never read */
+      reload              = true;
+      journal->generation = journal->compacted_generation;
+      journal->size       = 0;
+      journal->base_size  = journal->compacted_base_size;
+    }
+  }
+
+  /* while a compaction holds the lock, the records are kept in memory */
+  int lock = (journal->pending->len > 0) ? LOCK_EX : LOCK_SH;
+  if (file_lock_set(journal->fd, wait ? lock : lock | LOCK_NB) == 0) {
+    /* apply the records other instances appended since the last sync, a new
+     * generation means the journal has been compacted into the base file;
+     * after a compaction the reload reads them anyway, but the pending
+     * records still have to be written */
+    struct stat buf;
+    if (reload == false && fstat(journal->fd, &buf) == 0 &&
+        buf.st_size != journal->size) {
+      if (jumanji_db_journal_generation(journal->fd) != journal->generation ||
+          buf.st_size < journal->size) {
+        reload = true;
+      } else {
+        jumanji_db_journal_tail(journal, buf.st_size);
       }
+    }
 
-      if (quickmark->identifier == identifier) {
-        girara_list_remove(database->quickmarks, quickmark);
-        break;
+    if (journal->pending->len > 0) {
+      if (write(journal->fd, journal->pending->str, journal->pending->len) ==
+          (ssize_t) journal->pending->len) {
+        g_string_truncate(journal->pending, 0);
+      } else {
+        girara_error("Could not write to journal: %s", journal->path);
       }
-    } while (girara_list_iterator_next(iter) != NULL);
 
-    jumanji_db_write_quickmarks_to_file(database->quickmarks_file, database->quickmarks);
-    g_signal_connect(G_OBJECT(database->quickmarks_monitor), "changed",
-        G_CALLBACK(cb_jumanji_db_watch_file), database);
-    girara_list_iterator_free(iter);
+      if (fstat(journal->fd, &buf) == 0) {
+        journal->size = buf.st_size;
+      }
+    }
+
+    file_lock_set(journal->fd, LOCK_UN);
+  } else if (journal->retry == NULL) {
+    /* the lock holder may have been the last writer for a while */
+    journal->retry = g_timeout_source_new(JOURNAL_RETRY_INTERVAL);
+    g_source_set_callback(journal->retry, cb_jumanji_db_retry_journal, journal,
+        NULL);
+    g_source_attach(journal->retry, g_main_context_get_thread_default());
+  }
+
+  if (reload == true && wait == false) {
+    jumanji_db_journal_load(journal);
+  }
+
+  /* compact in the background once the journal grew large enough */
+  if (wait == false && journal->compaction == NULL &&
+      (journal->size > MAX(journal->base_size / 2, JOURNAL_COMPACT_MIN_SIZE) ||
+       journal->cold >= HISTORY_SEAL_MIN_COUNT || journal->snapshot_missing)) {
+    journal->compacted_size   = -1;
+    journal->compacted_sealed = 0;
+    journal->cold             = 0;
+    journal->snapshot_missing = false;
+    journal->compaction     = g_thread_new("journal-compaction",
+        jumanji_db_journal_compact, journal);
   }
 }
 
-static girara_list_t*
-jumanji_db_read_urls_from_file(const char* filename)
+static void
+jumanji_db_journal_tail(jumanji_db_journal_t* journal, off_t size)
 {
-  if (filename == NULL) {
-    return NULL;
+  size_t length = size - journal->size;
+  char* buffer  = g_malloc(length);
+
+  if (pread(journal->fd, buffer, length, journal->size) != (ssize_t) length) {
+    g_free(buffer);
+    return;
   }
 
-  /* open file */
-  FILE* file = fopen(filename, "r");
-  if (file == NULL) {
-    return NULL;
+  jumanji_db_parse_lines(buffer, length, jumanji_db_parse_delta_line,
+      journal);
+  g_free(buffer);
+
+  jumanji_db_journal_apply_pending(journal);
+
+  journal->size = size;
+}
+
+static void
+jumanji_db_journal_apply_pending(jumanji_db_journal_t* journal)
+{
+  /* the pending records of this instance are newer, so they have to win */
+  if (journal->pending->len > 0) {
+    char* pending = g_strndup(journal->pending->str, journal->pending->len);
+    jumanji_db_parse_lines(pending, journal->pending->len,
+        jumanji_db_parse_delta_line, journal);
+    g_free(pending);
   }
+}
 
-  girara_list_t* list = girara_list_new2(jumanji_db_free_result_link);
-  if (list == NULL) {
-    fclose(file);
-    return NULL;
+static unsigned int
+jumanji_db_journal_generation(int fd)
+{
+  /* journals without a header have not been compacted yet */
+  char header[32] = { 0 };
+  if (pread(fd, header, sizeof(header) - 1, 0) <= 0 || header[0] != '#') {
+    return 0;
   }
 
-  file_lock_set(fileno(file), F_WRLCK);
+  return strtoul(header + 1, NULL, 10);
+}
 
-  /* read lines */
-  char* line = NULL;
-  while ((line = girara_file_read_line(file)) != NULL) {
-    /* skip empty lines */
-    if (strlen(line) == 0) {
-      g_free(line);
-      continue;
-    }
+static gpointer
+jumanji_db_journal_compact(gpointer data)
+{
+  jumanji_db_journal_t* journal = (jumanji_db_journal_t*) data;
+
+  /* the lock is held until the journal has been truncated, writers keep their
+   * records in memory meanwhile */
+  int fd = open(journal->path, O_RDWR);
+  if (fd == -1) {
+    goto out;
+  }
+
+  file_lock_set(fd, LOCK_EX);
+
+  jumanji_db_table_t* table = jumanji_db_table_new(g_str_hash, g_str_equal,
+      jumanji_db_link_key, free);
+  if (table == NULL) {
+    goto out_unlock;
+  }
+
+  jumanji_db_table_read(table, journal->base_path, jumanji_db_parse_link_line);
+
+  unsigned int generation = jumanji_db_journal_generation(fd) + 1;
+  off_t journal_size      = 0;
+  if (jumanji_db_parse_file(fd, jumanji_db_parse_journal_line, table,
+        &journal_size) == false) {
+    jumanji_db_table_free(table);
+    goto out_unlock;
+  }
 
-    /* parse line */
-    gchar** argv = NULL;
-    gint    argc = 0;
+  /* seal cold links, only the hot ones remain in the base file */
+  GPtrArray* links = table->order;
+  unsigned int sealed = 0;
 
-    if (g_shell_parse_argv(line, &argc, &argv, NULL) != FALSE) {
-      jumanji_db_result_link_t* link = malloc(sizeof(jumanji_db_result_link_t));
-      if (link == NULL) {
-        g_strfreev(argv);
-        g_free(line);
-        continue;
+  if (journal->tiered == true) {
+    int threshold   = time(NULL) - HISTORY_HOT_AGE;
+    GPtrArray* cold = g_ptr_array_new();
+    GPtrArray* hot  = g_ptr_array_sized_new(table->order->len);
+
+    for (unsigned int i = 0; i < table->order->len; i++) {
+      jumanji_db_result_link_t* link = g_ptr_array_index(table->order, i);
+      if (link != NULL) {
+        g_ptr_array_add(link->visited < threshold ? cold : hot, link);
       }
+    }
+
+    if (cold->len > 0 &&
+        jumanji_db_segments_seal(journal->base_path, cold, 0) == true) {
+      links  = hot;
+      sealed = cold->len;
+    } else {
+      g_ptr_array_free(hot, TRUE);
+    }
+
+    g_ptr_array_free(cold, TRUE);
+  }
 
-      link->url     = g_strdup(argv[0]);
-      link->title   = (argc > 1) ? g_strdup(argv[1]) : NULL;
-      link->visited = (argc > 2) ? atoi(argv[2])     : 0;
+  /* replace the base file and start a new journal */
+  char* tmp_path = g_strconcat(journal->base_path, ".tmp", NULL);
+  jumanji_db_write_urls_to_file(tmp_path, links, journal->visited);
 
-      girara_list_append(list, link);
+  /* the snapshot only matches once the journal carries the new generation */
+  struct stat buf;
+  if (stat(tmp_path, &buf) == 0) {
+    jumanji_db_snapshot_write(journal->snapshot_path, links, generation,
+        buf.st_size);
+  }
+
+  if (links != table->order) {
+    g_ptr_array_free(links, TRUE);
+  }
+  jumanji_db_table_free(table);
+
+  if (g_rename(tmp_path, journal->base_path) != 0) {
+    girara_error("Could not replace %s", journal->base_path);
+    g_remove(tmp_path);
+  } else if (ftruncate(fd, 0) != 0) {
+    girara_error("Could not truncate journal: %s", journal->path);
+  } else {
+    char* header = g_strdup_printf(JOURNAL_HEADER, generation);
+    if (pwrite(fd, header, strlen(header), 0) != (ssize_t) strlen(header)) {
+      girara_error("Could not write journal header: %s", journal->path);
     }
+    g_free(header);
 
-    g_strfreev(argv);
-    g_free(line);
+    if (stat(journal->base_path, &buf) == 0) {
+      journal->compacted_base_size = buf.st_size;
+    }
+    journal->compacted_generation = generation;
+    journal->compacted_size       = journal_size;
+    journal->compacted_sealed     = sealed;
   }
+  g_free(tmp_path);
 
-  file_lock_set(fileno(file), F_UNLCK);
-  fclose(file);
+out_unlock:
 
-  return list;
+  file_lock_set(fd, LOCK_UN);
+  close(fd);
+
+out:
+
+  g_atomic_int_set(&journal->compaction_done, 1);
+
+  return NULL;
 }
 
-static girara_list_t*
-jumanji_db_read_quickmarks_from_file(const char* filename)
+static gboolean
+cb_jumanji_db_retry_journal(gpointer data)
 {
-  if (filename == NULL) {
-    return NULL;
+  jumanji_db_journal_t* journal = (jumanji_db_journal_t*) data;
+
+  g_source_unref(journal->retry);
+  journal->retry = NULL;
+
+  jumanji_db_journal_flush(journal, false);
+
+  return FALSE;
+}
+
+static void
+cb_jumanji_db_watch_journal(GFileMonitor* monitor, GFile* file, GFile*
+    other_file, GFileMonitorEvent event, jumanji_db_journal_t* journal)
+{
+  if ((event != G_FILE_MONITOR_EVENT_CHANGED &&
+      event != G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT) || journal == NULL) {
+    return;
   }
 
-  /* open file */
-  FILE* file = fopen(filename, "r");
-  if (file == NULL) {
-    return NULL;
+  /* applies the records of other instances, own writes are known already */
+  jumanji_db_journal_flush(journal, false);
+}
+
+static bool
+jumanji_db_parse_file(int fd, jumanji_db_line_function_t function, void* data,
+    off_t* size)
+{
+  struct stat buf;
+  if (fstat(fd, &buf) != 0) {
+    return false;
   }
 
-  girara_list_t* list = girara_list_new2(jumanji_db_free_quickmark);
-  if (list == NULL) {
-    fclose(file);
-    return NULL;
+  if (buf.st_size > 0) {
+    /* a private mapping can be unquoted in place without touching the file */
+    char* buffer = mmap(NULL, buf.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+        fd, 0);
+    if (buffer == MAP_FAILED) {
+      girara_error("Could not map file: %s", strerror(errno));
+      return false;
+    }
+
+    jumanji_db_parse_lines(buffer, buf.st_size, function, data);
+    munmap(buffer, buf.st_size);
   }
 
-  file_lock_set(fileno(file), F_WRLCK);
+  if (size != NULL) {
+    *size = buf.st_size;
+  }
+
+  return true;
+}
+
+static void
+jumanji_db_parse_lines(char* buffer, size_t length, jumanji_db_line_function_t
+    function, void* data)
+{
+  char* line = buffer;
+  char* end  = buffer + length;
+
+  while (line < end) {
+    char* newline = memchr(line, '\n', end - line);
+    if (newline == NULL) {
+      /* the last line is not terminated and there is no room behind it */
+      char* last = g_strndup(line, end - line);
+      function(last, data);
+      g_free(last);
+      break;
+    }
 
-  /* read lines */
-  char* line = NULL;
-  while ((line = girara_file_read_line(file)) != NULL) {
     /* skip empty lines */
-    if (strlen(line) == 0) {
-      g_free(line);
-      continue;
+    if (newline != line) {
+      *newline = '\0';
+      function(line, data);
     }
 
-    /* parse line */
-    gchar** argv = NULL;
-    gint    argc = 0;
+    line = newline + 1;
+  }
+}
+
+static unsigned int
+jumanji_db_split_fields(char* line, char** fields, unsigned int max)
+{
+  /* understands the quoting of g_shell_quote() and the simple cases of
+   * hand-written files, the fields are unquoted in place */
+  unsigned int count = 0;
+  char* input        = line;
+
+  while (count < max) {
+    while (*input == ' ' || *input == '\t') {
+      input++;
+    }
 
-    if (g_shell_parse_argv(line, &argc, &argv, NULL) != FALSE) {
-      if (argc < 2) {
-        g_free(line);
-        continue;
-      }
+    if (*input == '\0') {
+      break;
+    }
 
-      jumanji_db_quickmark_t* quickmark = malloc(sizeof(jumanji_db_quickmark_t));
-      if (quickmark == NULL) {
-        g_free(line);
-        continue;
+    char* output    = input;
+    fields[count++] = output;
+
+    while (*input != '\0' && *input != ' ' && *input != '\t') {
+      if (*input == '\'') {
+        char* quote = strchr(input + 1, '\'');
+        if (quote == NULL) {
+          return 0;
+        }
+
+        size_t length = quote - input - 1;
+        memmove(output, input + 1, length);
+        output += length;
+        input   = quote + 1;
+      } else if (*input == '"') {
+        input++;
+        while (*input != '"') {
+          if (*input == '\0') {
+            return 0;
+          }
+
+          if (*input == '\\' && input[1] != '\0' && strchr("$`\"\\", input[1]) != NULL) {
+            input++;
+          }
+          *output++ = *input++;
+        }
+        input++;
+      } else if (*input == '\\' && input[1] != '\0') {
+        input++;
+        *output++ = *input++;
+      } else {
+        *output++ = *input++;
       }
+    }
 
-      quickmark->identifier = argv[0][0];
-      quickmark->url        = g_strdup(argv[1]);
+    /* the output never overtakes the input, so the separator can be replaced */
+    bool last = (*input == '\0');
+    *output   = '\0';
 
-      girara_list_append(list, quickmark);
+    if (last == true) {
+      break;
     }
+    input++;
+  }
 
-    g_strfreev(argv);
-    g_free(line);
+  return count;
+}
+
+static void
+jumanji_db_parse_link_line(char* line, void* data)
+{
+  char* fields[3];
+  unsigned int count = jumanji_db_split_fields(line, fields, 3);
+  if (count == 0) {
+    return;
   }
 
-  file_lock_set(fileno(file), F_UNLCK);
-  fclose(file);
+  jumanji_db_table_t* table      = (jumanji_db_table_t*) data;
+  jumanji_db_result_link_t* link = jumanji_db_link_new(table->store, fields[0],
+      (count > 1) ? fields[1]       : NULL,
+      (count > 2) ? atoi(fields[2]) : 0);
 
-  return list;
+  if (link != NULL) {
+    jumanji_db_table_insert(table, link);
+  }
+}
+
+static char*
+jumanji_db_parse_removal_line(char* line)
+{
+  char* fields[1];
+  if (jumanji_db_split_fields(line, fields, 1) == 0) {
+    return NULL;
+  }
+
+  return fields[0];
 }
 
 static void
-jumanji_db_write_urls_to_file(const char* filename, girara_list_t* urls, bool visited)
+jumanji_db_parse_quickmark_line(char* line, void* data)
 {
-  if (filename == NULL || urls == NULL) {
+  char* fields[2];
+  if (jumanji_db_split_fields(line, fields, 2) < 2) {
     return;
   }
 
-  int fd = open(filename, O_RDWR);
-  if (fd == -1) {
+  jumanji_db_quickmark_t* quickmark = jumanji_db_quickmark_new(fields[0][0],
+      fields[1]);
+
+  if (quickmark != NULL) {
+    jumanji_db_table_insert((jumanji_db_table_t*) data, quickmark);
+  }
+}
+
+static void
+jumanji_db_parse_session_line(char* line, void* data)
+{
+  char* fields[2];
+  unsigned int count = jumanji_db_split_fields(line, fields, 2);
+  if (count == 0) {
     return;
   }
 
-  file_lock_set(fd, F_WRLCK);
+  /* session links are handed to the caller, who frees them separately */
+  jumanji_db_result_link_t* link = malloc(sizeof(jumanji_db_result_link_t));
+  if (link == NULL) {
+    return;
+  }
 
-  if (girara_list_size(urls) > 0) {
-    girara_list_iterator_t* iter = girara_list_iterator(urls);
-    do {
-      jumanji_db_result_link_t* link = (jumanji_db_result_link_t*) girara_list_iterator_data(iter);
-      if (link == NULL || link->url == NULL) {
-        continue;
-      }
+  link->url     = g_strdup(fields[0]);
+  link->title   = (count > 1) ? g_strdup(fields[1]) : NULL;
+  link->visited = 0;
+
+  girara_list_append((girara_list_t*) data, link);
+}
 
-      /* write url */
-      if (write(fd, link->url, strlen(link->url)) != strlen(link->url)) continue;
+static void
+jumanji_db_table_read(jumanji_db_table_t* table, const char* filename,
+    jumanji_db_line_function_t function)
+{
+  if (table == NULL || filename == NULL) {
+    return;
+  }
 
-      /* write title */
-      char* title_quoted = g_shell_quote(link->title ? link->title : "");
-      char* text = g_strdup_printf(" %s", title_quoted);
-      if (write(fd, text, strlen(text)) != strlen(text)) continue;
-      g_free(title_quoted);
-      g_free(text);
+  int fd = open(filename, O_RDONLY);
+  if (fd == -1) {
+    return;
+  }
 
-      /* write last visit */
-      if (visited == true) {
-        char* text = g_strdup_printf(" %d", link->visited);
-        if (write(fd, text, strlen(text)) != strlen(text)) continue;
-        g_free(text);
-      }
+  file_lock_set(fd, LOCK_SH);
+  jumanji_db_parse_file(fd, function, table, NULL);
+  file_lock_set(fd, LOCK_UN);
 
-      if (write(fd, "\n", 1) != 1) continue;
-    } while (girara_list_iterator_next(iter) != NULL);
-    girara_list_iterator_free(iter);
+  close(fd);
+}
+
+static girara_list_t*
+jumanji_db_read_urls_from_file(const char* filename)
+{
+  if (filename == NULL) {
+    return NULL;
+  }
+
+  int fd = open(filename, O_RDONLY);
+  if (fd == -1) {
+    return NULL;
+  }
+
+  girara_list_t* list = girara_list_new2(jumanji_db_free_result_link);
+  if (list == NULL) {
+    close(fd);
+    return NULL;
   }
 
-  file_lock_set(fd, F_UNLCK);
+  file_lock_set(fd, LOCK_SH);
+  jumanji_db_parse_file(fd, jumanji_db_parse_session_line, list, NULL);
+  file_lock_set(fd, LOCK_UN);
 
   close(fd);
+
+  return list;
 }
 
 static void
-jumanji_db_write_quickmarks_to_file(const char* filename, girara_list_t* quickmarks)
+jumanji_db_write_urls_to_file(const char* filename, GPtrArray* urls, bool visited)
 {
-  if (filename == NULL || quickmarks == NULL) {
+  if (filename == NULL || urls == NULL) {
     return;
   }
 
-  /* open file */
-  int fd = open(filename, O_RDWR);
+  int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
   if (fd == -1) {
     return;
   }
 
-  file_lock_set(fd, F_WRLCK);
+  file_lock_set(fd, LOCK_EX);
 
-  if (girara_list_size(quickmarks) > 0) {
-    girara_list_iterator_t* iter = girara_list_iterator(quickmarks);
-    do {
-      jumanji_db_quickmark_t* quickmark = (jumanji_db_quickmark_t*) girara_list_iterator_data(iter);
-      if (quickmark == NULL) {
-        continue;
-      }
+  for (unsigned int i = 0; i < urls->len; i++) {
+    jumanji_db_result_link_t* link = (jumanji_db_result_link_t*) g_ptr_array_index(urls, i);
+    if (link == NULL || link->url == NULL) {
+      continue;
+    }
 
-      char* text = g_strdup_printf("%c %s", quickmark->identifier, quickmark->url);
+    /* write url, quoted like the title since both are read with
+     * jumanji_db_split_fields() */
+    char* url_quoted = g_shell_quote(link->url);
+    bool url_written = (write(fd, url_quoted, strlen(url_quoted)) ==
+        strlen(url_quoted));
+    g_free(url_quoted);
+    if (url_written == false) continue;
+
+    /* write title */
+    char* title_quoted = g_shell_quote(link->title ? link->title : "");
+    char* text = g_strdup_printf(" %s", title_quoted);
+    if (write(fd, text, strlen(text)) != strlen(text)) continue;
+    g_free(title_quoted);
+    g_free(text);
+
+    /* write last visit */
+    if (visited == true) {
+      char* text = g_strdup_printf(" %d", link->visited);
       if (write(fd, text, strlen(text)) != strlen(text)) continue;
       g_free(text);
+    }
 
-      if (write(fd, "\n", 1) != 1) continue;
-    } while (girara_list_iterator_next(iter) != NULL);
-    girara_list_iterator_free(iter);
+    if (write(fd, "\n", 1) != 1) continue;
   }
 
-  file_lock_set(fd, F_UNLCK);
+  /* the file may replace another one, make sure it is complete */
+  fsync(fd);
+
+  file_lock_set(fd, LOCK_UN);
+
   close(fd);
 }
 
-static girara_list_t*
-jumanji_db_filter_url_list(girara_list_t* list, const char* input)
+static void
+jumanji_db_write_quickmarks_to_file(const char* filename, GPtrArray* quickmarks)
 {
-  if (list == NULL || girara_list_size(list) == 0) {
-    return NULL;
+  if (filename == NULL || quickmarks == NULL) {
+    return;
   }
 
-  girara_list_t* new_list = girara_list_new();
-  if (new_list == NULL) {
-    girara_list_free(list);
-    return NULL;
+  /* open file */
+  int fd = open(filename, O_WRONLY | O_TRUNC);
+  if (fd == -1) {
+    return;
   }
 
-  girara_list_set_free_function(new_list, jumanji_db_free_result_link);
-  girara_list_iterator_t* iter = girara_list_iterator(list);
-
-  do {
-    jumanji_db_result_link_t* link = (jumanji_db_result_link_t*) girara_list_iterator_data(iter);
+  file_lock_set(fd, LOCK_EX);
 
-    if (strstr(link->url, input) != NULL || (link->title && strstr(link->title, input)) ) {
-      /* duplicate entry */
-      jumanji_db_result_link_t* link_dup = malloc(sizeof(jumanji_db_result_link_t));
-      if (link_dup != NULL) {
-        link_dup->url     = g_strdup(link->url);
-        link_dup->title   = g_strdup(link->title);
-        link_dup->visited = link->visited;
-        girara_list_append(new_list, link_dup);
-      }
+  for (unsigned int i = 0; i < quickmarks->len; i++) {
+    jumanji_db_quickmark_t* quickmark = (jumanji_db_quickmark_t*) g_ptr_array_index(quickmarks, i);
+    if (quickmark == NULL) {
+      continue;
     }
-  } while (girara_list_iterator_next(iter) != NULL);
 
-  girara_list_iterator_free(iter);
+    char* url_quoted = g_shell_quote(quickmark->url);
+    char* text = g_strdup_printf("%c %s", quickmark->identifier, url_quoted);
+    g_free(url_quoted);
+    if (write(fd, text, strlen(text)) != strlen(text)) continue;
+    g_free(text);
+
+    if (write(fd, "\n", 1) != 1) continue;
+  }
 
-  return new_list;
+  file_lock_set(fd, LOCK_UN);
+  close(fd);
 }
 
 static void
 cb_jumanji_db_watch_file(GFileMonitor* monitor, GFile* file, GFile* other_file,
-    GFileMonitorEvent event, jumanji_database_t* database)
+    GFileMonitorEvent event, jumanji_db_plain_t* database)
 {
   if (event != G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT || database == NULL) {
     return;
@@ -803,38 +1514,20 @@ cb_jumanji_db_watch_file(GFileMonitor* monitor, GFile* file, GFile* other_file,
     return;
   }
 
-  if (database->bookmark_file && strcmp(database->bookmark_file, path) == 0) {
-    girara_list_free(database->bookmarks);
-    database->bookmarks = jumanji_db_read_urls_from_file(database->bookmark_file);
-    girara_list_set_free_function(database->bookmarks,  jumanji_db_free_result_link);
-  } else if (database->history_file && strcmp(database->history_file, path) == 0) {
-    girara_list_free(database->history);
-    database->history = jumanji_db_read_urls_from_file(database->history_file);
-    girara_list_set_free_function(database->history,    jumanji_db_free_result_link);
-  } else if (database->quickmarks_file && strcmp(database->quickmarks_file, path) == 0) {
-    girara_list_free(database->quickmarks);
-    database->quickmarks = jumanji_db_read_quickmarks_from_file(database->quickmarks_file);
-    girara_list_set_free_function(database->quickmarks, jumanji_db_free_quickmark);
+  if (database->quickmarks_file && strcmp(database->quickmarks_file, path) == 0) {
+    jumanji_db_table_clear(database->quickmarks);
+    jumanji_db_table_read(database->quickmarks, database->quickmarks_file,
+        jumanji_db_parse_quickmark_line);
   }
 
   g_free(path);
 }
 
 static void
-jumanji_db_free_quickmark(void* data)
+jumanji_db_plain_save_session(void* data, const char* name, girara_list_t* urls)
 {
-  if (data == NULL) {
-    return;
-  }
+  jumanji_db_plain_t* database = (jumanji_db_plain_t*) data;
 
-  jumanji_db_quickmark_t* quickmark = (jumanji_db_quickmark_t*) data;
-  g_free(quickmark->url);
-  free(quickmark);
-}
-
-void
-jumanji_db_save_session(jumanji_database_t* database, const char* name, girara_list_t* urls)
-{
   char* session_path = g_build_filename(database->session_dir, name, NULL);
 
   /* Removes the session file, so closed tabs won't be opened on next startup
@@ -843,13 +1536,26 @@ jumanji_db_save_session(jumanji_database_t* database, const char* name, girara_l
    * for session, this removal shouldn't be needed. */
   g_remove(session_path);
   jumanji_db_check_file(session_path);
-  jumanji_db_write_urls_to_file(session_path, urls, false);
+
+  GPtrArray* links = g_ptr_array_sized_new(girara_list_size(urls));
+  if (girara_list_size(urls) > 0) {
+    girara_list_iterator_t* iter = girara_list_iterator(urls);
+    do {
+      g_ptr_array_add(links, girara_list_iterator_data(iter));
+    } while (girara_list_iterator_next(iter) != NULL);
+    girara_list_iterator_free(iter);
+  }
+
+  jumanji_db_write_urls_to_file(session_path, links, false);
+  g_ptr_array_free(links, TRUE);
   free(session_path);
 }
 
-girara_list_t*
-jumanji_db_load_session(jumanji_database_t* database, const char* name)
+static girara_list_t*
+jumanji_db_plain_load_session(void* data, const char* name)
 {
+  jumanji_db_plain_t* database = (jumanji_db_plain_t*) data;
+
   char* session_path = g_build_filename(database->session_dir, name, NULL);
   girara_list_t* url_list;
 
@@ -857,3 +1563,26 @@ jumanji_db_load_session(jumanji_database_t* database, const char* name)
   free(session_path);
   return url_list;
 }
+
+const jumanji_db_backend_t jumanji_db_plain_backend = {
+  .name             = "plain",
+  .init             = jumanji_db_plain_init,
+  .free             = jumanji_db_plain_free,
+  .check_location   = jumanji_db_plain_check_location,
+  .begin            = jumanji_db_plain_begin,
+  .commit           = jumanji_db_plain_commit,
+  .bookmark_add     = jumanji_db_plain_bookmark_add,
+  .bookmark_remove  = jumanji_db_plain_bookmark_remove,
+  .bookmark_match   = jumanji_db_plain_bookmark_match,
+  .bookmark_exists  = jumanji_db_plain_bookmark_exists,
+  .history_add      = jumanji_db_plain_history_add,
+  .history_clean    = jumanji_db_plain_history_clean,
+  .history_match    = jumanji_db_plain_history_match,
+  .quickmark_add    = jumanji_db_plain_quickmark_add,
+  .quickmark_remove = jumanji_db_plain_quickmark_remove,
+  .quickmark_find   = jumanji_db_plain_quickmark_find,
+  .save_session     = jumanji_db_plain_save_session,
+  .load_session     = jumanji_db_plain_load_session,
+  .bookmark_foreach = jumanji_db_plain_bookmark_foreach,
+  .history_foreach  = jumanji_db_plain_history_foreach
+};
@@ -0,0 +1,1076 @@
+/* See LICENSE file for license and copyright information */
+
+#define _POSIX_SOURCE
+#define _XOPEN_SOURCE 500
+
+#include <girara/datastructures.h>
+#include <girara/utils.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
+#include "database.h"
+#include "database-segment.h"
+#include "database-table.h"
+
+#define MANIFEST_SUFFIX ".segments"
+#define SEGMENT_SUFFIX ".segment"
+#define SEGMENT_MAGIC 0x3247534a
+
+/* uncompressed size of a block, a search decompresses whole blocks */
+#define SEGMENT_BLOCK_SIZE (8 * 1024)
+/* size of the trigram filter of a block in bytes */
+#define SEGMENT_BLOOM_SIZE 512
+#define SEGMENT_BLOOM_BITS (SEGMENT_BLOOM_SIZE * 8)
+/* all segments are merged once there are more than this */
+#define SEGMENT_MAX 8
+/* deflate expands a block to at most this many times its compressed size */
+#define SEGMENT_MAX_RATIO 1032
+
+/* line of the manifest */
+typedef struct jumanji_db_segment_entry_s
+{
+  guint sequence; /**> Sequence number of the segment */
+  int oldest; /**> Earliest last visit in the segment, 0 if unknown */
+} jumanji_db_segment_entry_t;
+
+/* entry of the sparse index at the end of a segment file */
+typedef struct jumanji_db_segment_block_s
+{
+  guint64 offset; /**> Offset of the compressed block */
+  guint32 compressed_size; /**> Size of the compressed block */
+  guint32 size; /**> Size of the block after decompression */
+  guint8 bloom[SEGMENT_BLOOM_SIZE]; /**> Bloom filter of the trigrams in the block */
+} jumanji_db_segment_block_t;
+
+typedef struct jumanji_db_segment_footer_s
+{
+  guint64 index_offset; /**> Offset of the sparse index */
+  guint64 keys_offset; /**> Offset of the first urls of the blocks */
+  guint32 block_count; /**> Number of blocks */
+  guint32 magic; /**> Identifies segment files */
+} jumanji_db_segment_footer_t;
+
+typedef struct jumanji_db_segment_s
+{
+  unsigned int sequence; /**> Sequence number of the segment */
+  int fd; /**> File descriptor of the segment file */
+  guint32 block_count; /**> Number of blocks */
+  jumanji_db_segment_block_t* blocks; /**> Sparse index */
+  char* key_data; /**> First urls of the blocks, NUL-separated */
+  const char** keys; /**> First url of every block */
+  guint32 cached_block; /**> Block that has last been looked up by url */
+  char* cached; /**> Decompressed cached block, segments never change */
+} jumanji_db_segment_t;
+
+struct jumanji_db_segments_s
+{
+  gchar* base_path; /**> Path to the history file */
+  gchar* manifest_path; /**> Path to the manifest */
+  GPtrArray* segments; /**> Open segments, the oldest first */
+  ino_t manifest_inode; /**> Inode of the manifest as last read */
+  time_t manifest_mtime; /**> Modification time of the manifest as last read */
+};
+
+/* writes a segment block by block */
+typedef struct jumanji_db_segment_writer_s
+{
+  int fd; /**> File descriptor of the new segment */
+  guint64 offset; /**> Current end of the file */
+  GByteArray* block; /**> Records of the current block */
+  jumanji_db_segment_block_t current; /**> Index entry of the current block */
+  GArray* blocks; /**> Index entries of the written blocks */
+  GByteArray* keys; /**> First urls of the written blocks */
+  GConverter* compressor; /**> Compresses the blocks */
+  int oldest; /**> Earliest last visit among the records */
+  bool failed; /**> A write failed */
+} jumanji_db_segment_writer_t;
+
+/* iterates over the records of a segment or of an array of links */
+typedef struct jumanji_db_segment_iterator_s
+{
+  jumanji_db_segment_t* segment; /**> Segment, NULL for links */
+  guint32 block; /**> Next block to read */
+  char* buffer; /**> Current decompressed block */
+  gsize size; /**> Size of the buffer */
+  gsize position; /**> Position of the next record in the buffer */
+  GPtrArray* links; /**> Links, NULL for segments */
+  guint link; /**> Next link */
+  const char* url; /**> Url of the current record */
+  const char* title; /**> Title of the current record */
+  int visited; /**> Last visit of the current record */
+} jumanji_db_segment_iterator_t;
+
+/* passes merged links through the filter of a seal into the new segment */
+typedef struct jumanji_db_segment_seal_s
+{
+  jumanji_db_segment_writer_t* writer; /**> Writes the new segment */
+  int visited; /**> Links last visited before are dropped */
+} jumanji_db_segment_seal_t;
+
+/* passes merged links that have no newer version to a link function */
+typedef struct jumanji_db_segment_foreach_s
+{
+  jumanji_db_exclude_function_t exclude; /**> Skips urls of newer links */
+  void* data; /**> Custom data passed to exclude */
+  jumanji_db_link_function_t function; /**> Receives the links */
+  void* function_data; /**> Custom data passed to function */
+} jumanji_db_segment_foreach_t;
+
+/* forward declarations */
+static gchar* jumanji_db_segment_path(const char* base_path, unsigned int
+    sequence);
+static GArray* jumanji_db_segment_read_manifest(const char* manifest_path);
+static bool jumanji_db_segment_write_manifest(const char* manifest_path,
+    GArray* entries);
+static jumanji_db_segment_t* jumanji_db_segment_open(const char* base_path,
+    unsigned int sequence);
+static void jumanji_db_segment_free(void* data);
+static char* jumanji_db_segment_read_block(jumanji_db_segment_t* segment,
+    guint32 index);
+static bool jumanji_db_segment_contains(jumanji_db_segment_t* segment, const
+    char* url);
+static guint8* jumanji_db_segment_convert(GConverter* converter, const void*
+    input, gsize input_size, gsize output_size, gsize* converted_size);
+static void jumanji_db_segment_bloom_add(guint8* bloom, const char* text);
+static bool jumanji_db_segment_bloom_match(const guint8* bloom, const char*
+    input);
+static void jumanji_db_segments_refresh(jumanji_db_segments_t* segments);
+static jumanji_db_segment_writer_t* jumanji_db_segment_writer_new(const char*
+    path);
+static void jumanji_db_segment_writer_add(jumanji_db_segment_writer_t* writer,
+    const char* url, const char* title, int visited);
+static void jumanji_db_segment_writer_flush(jumanji_db_segment_writer_t*
+    writer);
+static bool jumanji_db_segment_writer_close(jumanji_db_segment_writer_t*
+    writer);
+static bool jumanji_db_segment_iterator_next(jumanji_db_segment_iterator_t*
+    iterator);
+static bool jumanji_db_segment_merge(GArray* iterators,
+    jumanji_db_link_function_t function, void* data);
+static bool cb_jumanji_db_segment_seal(const char* url, const char* title, int
+    visited, void* data);
+static bool cb_jumanji_db_segment_foreach(const char* url, const char* title,
+    int visited, void* data);
+
+jumanji_db_segments_t*
+jumanji_db_segments_new(const char* base_path)
+{
+  if (base_path == NULL) {
+    return NULL;
+  }
+
+  jumanji_db_segments_t* segments = g_malloc0(sizeof(jumanji_db_segments_t));
+  if (segments == NULL) {
+    return NULL;
+  }
+
+  segments->base_path     = g_strdup(base_path);
+  segments->manifest_path = g_strconcat(base_path, MANIFEST_SUFFIX, NULL);
+  segments->segments      = g_ptr_array_new_with_free_func(jumanji_db_segment_free);
+
+  return segments;
+}
+
+void
+jumanji_db_segments_free(jumanji_db_segments_t* segments)
+{
+  if (segments == NULL) {
+    return;
+  }
+
+  g_ptr_array_free(segments->segments, TRUE);
+  g_free(segments->manifest_path);
+  g_free(segments->base_path);
+  g_free(segments);
+}
+
+bool
+jumanji_db_segments_match(jumanji_db_segments_t* segments, const char* input,
+    jumanji_db_exclude_function_t exclude, void* data,
+    jumanji_db_link_function_t function, void* function_data)
+{
+  if (segments == NULL || input == NULL || function == NULL) {
+    return true;
+  }
+
+  /* inputs without a trigram would decompress everything, they are answered
+   * from the hot table alone */
+  if (strlen(input) < 3) {
+    return true;
+  }
+
+  jumanji_db_segments_refresh(segments);
+
+  bool more = true;
+
+  for (guint i = segments->segments->len; i > 0 && more == true; i--) {
+    jumanji_db_segment_t* segment = g_ptr_array_index(segments->segments, i - 1);
+
+    for (guint32 j = 0; j < segment->block_count && more == true; j++) {
+      if (jumanji_db_segment_bloom_match(segment->blocks[j].bloom, input) == false) {
+        continue;
+      }
+
+      jumanji_db_segment_iterator_t iterator = { .segment = segment, .block = j };
+      iterator.buffer = jumanji_db_segment_read_block(segment, j);
+      iterator.size   = segment->blocks[j].size;
+      if (iterator.buffer == NULL) {
+        continue;
+      }
+
+      while (more == true && iterator.position < iterator.size &&
+          jumanji_db_segment_iterator_next(&iterator) == true) {
+        if (strstr(iterator.url, input) == NULL &&
+            strstr(iterator.title, input) == NULL) {
+          continue;
+        }
+
+        if (exclude != NULL && exclude(iterator.url, data) == true) {
+          continue;
+        }
+
+        /* a link may have been sealed more than once, the newest segment
+         * wins even if its version no longer matches */
+        bool newer = false;
+        for (guint k = i; k < segments->segments->len && newer == false; k++) {
+          newer = jumanji_db_segment_contains(g_ptr_array_index(
+                segments->segments, k), iterator.url);
+        }
+
+        if (newer == false) {
+          more = function(iterator.url, iterator.title, iterator.visited,
+              function_data);
+        }
+      }
+
+      g_free(iterator.buffer);
+    }
+  }
+
+  return more;
+}
+
+void
+jumanji_db_segments_foreach(jumanji_db_segments_t* segments,
+    jumanji_db_exclude_function_t exclude, void* data,
+    jumanji_db_link_function_t function, void* function_data)
+{
+  if (segments == NULL || function == NULL) {
+    return;
+  }
+
+  jumanji_db_segments_refresh(segments);
+
+  /* the segments are merged by url, so that only one block of each is held
+   * in memory */
+  GArray* iterators = g_array_new(FALSE, TRUE, sizeof(jumanji_db_segment_iterator_t));
+  for (guint i = 0; i < segments->segments->len; i++) {
+    jumanji_db_segment_iterator_t iterator = {
+      .segment = g_ptr_array_index(segments->segments, i)
+    };
+    g_array_append_val(iterators, iterator);
+  }
+
+  jumanji_db_segment_foreach_t foreach = {
+    .exclude       = exclude,
+    .data          = data,
+    .function      = function,
+    .function_data = function_data
+  };
+
+  jumanji_db_segment_merge(iterators, cb_jumanji_db_segment_foreach, &foreach);
+
+  for (guint i = 0; i < iterators->len; i++) {
+    g_free(g_array_index(iterators, jumanji_db_segment_iterator_t, i).buffer);
+  }
+
+  g_array_free(iterators, TRUE);
+}
+
+static gint
+jumanji_db_segment_compare_links(gconstpointer a, gconstpointer b)
+{
+  return strcmp((*(jumanji_db_result_link_t**) a)->url,
+      (*(jumanji_db_result_link_t**) b)->url);
+}
+
+bool
+jumanji_db_segments_seal(const char* base_path, GPtrArray* links, int visited)
+{
+  if (base_path == NULL) {
+    return false;
+  }
+
+  bool has_links = (links != NULL && links->len > 0);
+  if (has_links == false && visited == 0) {
+    return true;
+  }
+
+  gchar* manifest_path = g_strconcat(base_path, MANIFEST_SUFFIX, NULL);
+  GArray* entries      = jumanji_db_segment_read_manifest(manifest_path);
+
+  unsigned int sequence = 1;
+  bool expired          = false;
+  for (guint i = 0; i < entries->len; i++) {
+    jumanji_db_segment_entry_t* entry = &g_array_index(entries,
+        jumanji_db_segment_entry_t, i);
+    sequence = MAX(sequence, entry->sequence + 1);
+    expired  = expired || entry->oldest < visited;
+  }
+
+  /* segments are only rewritten if they may hold links to drop */
+  if (has_links == false && expired == false) {
+    g_array_free(entries, TRUE);
+    g_free(manifest_path);
+    return true;
+  }
+
+  bool merge = (expired == true || entries->len + 1 > SEGMENT_MAX);
+
+  /* the sources are ordered from the oldest to the newest */
+  GArray* iterators = g_array_new(FALSE, TRUE, sizeof(jumanji_db_segment_iterator_t));
+  bool result       = false;
+
+  if (merge == true) {
+    for (guint i = 0; i < entries->len; i++) {
+      jumanji_db_segment_t* segment = jumanji_db_segment_open(base_path,
+          g_array_index(entries, jumanji_db_segment_entry_t, i).sequence);
+      if (segment == NULL) {
+        goto error_free;
+      }
+
+      jumanji_db_segment_iterator_t iterator = { .segment = segment };
+      g_array_append_val(iterators, iterator);
+    }
+  }
+
+  if (has_links == true) {
+    g_ptr_array_sort(links, jumanji_db_segment_compare_links);
+
+    jumanji_db_segment_iterator_t iterator = { .links = links };
+    g_array_append_val(iterators, iterator);
+  }
+
+  gchar* path = jumanji_db_segment_path(base_path, sequence);
+  jumanji_db_segment_writer_t* writer = jumanji_db_segment_writer_new(path);
+  if (writer == NULL) {
+    g_free(path);
+    goto error_free;
+  }
+
+  jumanji_db_segment_seal_t seal = {
+    .writer  = writer,
+    .visited = visited
+  };
+
+  jumanji_db_segment_merge(iterators, cb_jumanji_db_segment_seal, &seal);
+
+  jumanji_db_segment_entry_t new_entry = { .sequence = sequence, .oldest =
+    writer->oldest };
+
+  if (jumanji_db_segment_writer_close(writer) == false) {
+    girara_error("Could not write segment: %s", path);
+    g_remove(path);
+    g_free(path);
+    goto error_free;
+  }
+
+  /* publish the new segment, merged segments are removed afterwards */
+  GArray* new_entries = g_array_new(FALSE, FALSE,
+      sizeof(jumanji_db_segment_entry_t));
+  if (merge == false) {
+    g_array_append_vals(new_entries, entries->data, entries->len);
+  }
+
+  /* a merge that dropped every link leaves no segment */
+  if (new_entry.oldest != G_MAXINT) {
+    g_array_append_val(new_entries, new_entry);
+  } else {
+    g_remove(path);
+  }
+  g_free(path);
+
+  result = jumanji_db_segment_write_manifest(manifest_path, new_entries);
+  g_array_free(new_entries, TRUE);
+
+  if (result == true && merge == true) {
+    for (guint i = 0; i < entries->len; i++) {
+      gchar* old_path = jumanji_db_segment_path(base_path,
+          g_array_index(entries, jumanji_db_segment_entry_t, i).sequence);
+      g_remove(old_path);
+      g_free(old_path);
+    }
+  }
+
+error_free:
+
+  for (guint i = 0; i < iterators->len; i++) {
+    jumanji_db_segment_iterator_t* iterator = &g_array_index(iterators,
+        jumanji_db_segment_iterator_t, i);
+    g_free(iterator->buffer);
+    jumanji_db_segment_free(iterator->segment);
+  }
+
+  g_array_free(iterators, TRUE);
+  g_array_free(entries, TRUE);
+  g_free(manifest_path);
+
+  return result;
+}
+
+static bool
+jumanji_db_segment_merge(GArray* iterators, jumanji_db_link_function_t
+    function, void* data)
+{
+  /* merge the sorted sources, for equal urls the newest source wins */
+  GArray* active = g_array_new(FALSE, FALSE, sizeof(guint));
+  for (guint i = 0; i < iterators->len; i++) {
+    if (jumanji_db_segment_iterator_next(&g_array_index(iterators,
+            jumanji_db_segment_iterator_t, i)) == true) {
+      g_array_append_val(active, i);
+    }
+  }
+
+  bool more = true;
+
+  while (active->len > 0 && more == true) {
+    jumanji_db_segment_iterator_t* next = NULL;
+    for (guint i = 0; i < active->len; i++) {
+      jumanji_db_segment_iterator_t* iterator = &g_array_index(iterators,
+          jumanji_db_segment_iterator_t, g_array_index(active, guint, i));
+      if (next == NULL || strcmp(iterator->url, next->url) <= 0) {
+        next = iterator;
+      }
+    }
+
+    more = function(next->url, next->title, next->visited, data);
+
+    /* the url of next is owned by its source, so advance that one last */
+    gchar* url = g_strdup(next->url);
+    guint count = 0;
+    for (guint i = 0; i < active->len; i++) {
+      guint index = g_array_index(active, guint, i);
+      jumanji_db_segment_iterator_t* iterator = &g_array_index(iterators,
+          jumanji_db_segment_iterator_t, index);
+      if (strcmp(iterator->url, url) != 0 ||
+          jumanji_db_segment_iterator_next(iterator) == true) {
+        g_array_index(active, guint, count++) = index;
+      }
+    }
+    g_array_set_size(active, count);
+    g_free(url);
+  }
+
+  g_array_free(active, TRUE);
+
+  return more;
+}
+
+static bool
+cb_jumanji_db_segment_seal(const char* url, const char* title, int visited,
+    void* data)
+{
+  jumanji_db_segment_seal_t* seal = (jumanji_db_segment_seal_t*) data;
+
+  if (visited >= seal->visited) {
+    jumanji_db_segment_writer_add(seal->writer, url, title, visited);
+  }
+
+  return true;
+}
+
+static bool
+cb_jumanji_db_segment_foreach(const char* url, const char* title, int visited,
+    void* data)
+{
+  jumanji_db_segment_foreach_t* foreach = (jumanji_db_segment_foreach_t*) data;
+
+  if (foreach->exclude != NULL && foreach->exclude(url, foreach->data) == true) {
+    return true;
+  }
+
+  return foreach->function(url, title, visited, foreach->function_data);
+}
+
+static gchar*
+jumanji_db_segment_path(const char* base_path, unsigned int sequence)
+{
+  return g_strdup_printf("%s.%u" SEGMENT_SUFFIX, base_path, sequence);
+}
+
+static GArray*
+jumanji_db_segment_read_manifest(const char* manifest_path)
+{
+  GArray* entries = g_array_new(FALSE, FALSE,
+      sizeof(jumanji_db_segment_entry_t));
+
+  gchar* content = NULL;
+  if (g_file_get_contents(manifest_path, &content, NULL, NULL) == FALSE) {
+    return entries;
+  }
+
+  /* lines hold the sequence number and the earliest visit, which older
+   * manifests lack */
+  char* position = content;
+  while (*position != '\0') {
+    char* end = NULL;
+    jumanji_db_segment_entry_t entry = { .sequence = strtoul(position, &end,
+        10) };
+    if (end == position) {
+      break;
+    }
+
+    if (*end == ' ') {
+      position     = end;
+      entry.oldest = strtol(position, &end, 10);
+    }
+
+    g_array_append_val(entries, entry);
+    position = end + strspn(end, "\n");
+  }
+
+  g_free(content);
+
+  return entries;
+}
+
+static bool
+jumanji_db_segment_write_manifest(const char* manifest_path, GArray* entries)
+{
+  GString* content = g_string_new(NULL);
+  for (guint i = 0; i < entries->len; i++) {
+    jumanji_db_segment_entry_t* entry = &g_array_index(entries,
+        jumanji_db_segment_entry_t, i);
+    g_string_append_printf(content, "%u %d\n", entry->sequence,
+        entry->oldest);
+  }
+
+  /* replacing the manifest changes its inode, which other instances check */
+  gchar* tmp_path = g_strconcat(manifest_path, ".tmp", NULL);
+  bool result     = false;
+
+  int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (fd != -1) {
+    result = (write(fd, content->str, content->len) == (ssize_t) content->len &&
+        fsync(fd) == 0);
+    close(fd);
+  }
+
+  if (result == true && g_rename(tmp_path, manifest_path) != 0) {
+    result = false;
+  }
+
+  if (result == false) {
+    girara_error("Could not write segment manifest: %s", manifest_path);
+    g_remove(tmp_path);
+  }
+
+  g_free(tmp_path);
+  g_string_free(content, TRUE);
+
+  return result;
+}
+
+static jumanji_db_segment_t*
+jumanji_db_segment_open(const char* base_path, unsigned int sequence)
+{
+  gchar* path = jumanji_db_segment_path(base_path, sequence);
+  int fd      = open(path, O_RDONLY);
+  g_free(path);
+
+  if (fd == -1) {
+    return NULL;
+  }
+
+  jumanji_db_segment_t* segment = g_malloc0(sizeof(jumanji_db_segment_t));
+  segment->sequence = sequence;
+  segment->fd       = fd;
+
+  struct stat buf;
+  jumanji_db_segment_footer_t footer;
+  if (fstat(fd, &buf) != 0 || buf.st_size < (off_t) sizeof(footer) ||
+      pread(fd, &footer, sizeof(footer), buf.st_size - sizeof(footer)) !=
+      sizeof(footer) || footer.magic != SEGMENT_MAGIC) {
+    goto error_free;
+  }
+
+  /* the index and the keys follow the blocks, a truncated or corrupt segment
+   * must not make us allocate more than the file holds */
+  guint64 end        = buf.st_size - sizeof(footer);
+  guint64 index_size = (guint64) footer.block_count *
+    sizeof(jumanji_db_segment_block_t);
+  if (footer.index_offset > end || footer.keys_offset > end ||
+      footer.keys_offset < footer.index_offset ||
+      footer.keys_offset - footer.index_offset != index_size) {
+    goto error_free;
+  }
+
+  gsize keys_size      = end - footer.keys_offset;
+  segment->block_count = footer.block_count;
+  segment->blocks      = g_malloc(index_size);
+  segment->key_data    = g_malloc(keys_size + 1);
+  segment->keys        = g_new(const char*, footer.block_count);
+
+  if (pread(fd, segment->blocks, index_size, footer.index_offset) !=
+      (ssize_t) index_size ||
+      pread(fd, segment->key_data, keys_size, footer.keys_offset) !=
+      (ssize_t) keys_size) {
+    goto error_free;
+  }
+
+  segment->key_data[keys_size] = '\0';
+
+  gsize position = 0;
+  for (guint32 i = 0; i < segment->block_count; i++) {
+    jumanji_db_segment_block_t* block = &segment->blocks[i];
+    if (position >= keys_size || block->offset > footer.index_offset ||
+        block->compressed_size > footer.index_offset - block->offset) {
+      goto error_free;
+    }
+
+    /* the size of a block is allocated before it is decompressed */
+    if ((guint64) block->size > (guint64) block->compressed_size *
+        SEGMENT_MAX_RATIO) {
+      goto error_free;
+    }
+
+    segment->keys[i] = segment->key_data + position;
+    position        += strlen(segment->keys[i]) + 1;
+  }
+
+  return segment;
+
+error_free:
+
+  girara_error("Invalid segment %u of %s", sequence, base_path);
+  jumanji_db_segment_free(segment);
+
+  return NULL;
+}
+
+static void
+jumanji_db_segment_free(void* data)
+{
+  if (data == NULL) {
+    return;
+  }
+
+  jumanji_db_segment_t* segment = (jumanji_db_segment_t*) data;
+  close(segment->fd);
+  g_free(segment->cached);
+  g_free(segment->keys);
+  g_free(segment->key_data);
+  g_free(segment->blocks);
+  g_free(segment);
+}
+
+static char*
+jumanji_db_segment_read_block(jumanji_db_segment_t* segment, guint32 index)
+{
+  jumanji_db_segment_block_t* block = &segment->blocks[index];
+
+  char* compressed = g_malloc(block->compressed_size);
+  if (pread(segment->fd, compressed, block->compressed_size, block->offset) !=
+      (ssize_t) block->compressed_size) {
+    g_free(compressed);
+    return NULL;
+  }
+
+  GConverter* decompressor = G_CONVERTER(g_zlib_decompressor_new(
+        G_ZLIB_COMPRESSOR_FORMAT_RAW));
+
+  gsize size   = 0;
+  char* buffer = (char*) jumanji_db_segment_convert(decompressor, compressed,
+      block->compressed_size, block->size, &size);
+
+  g_object_unref(decompressor);
+  g_free(compressed);
+
+  if (buffer != NULL && size != block->size) {
+    g_free(buffer);
+    return NULL;
+  }
+
+  return buffer;
+}
+
+static bool
+jumanji_db_segment_contains(jumanji_db_segment_t* segment, const char* url)
+{
+  /* the only block that may contain the url is the last one whose first url
+   * is not larger */
+  guint32 begin = 0;
+  guint32 end   = segment->block_count;
+  while (begin < end) {
+    guint32 middle = begin + (end - begin) / 2;
+    if (strcmp(segment->keys[middle], url) <= 0) {
+      begin = middle + 1;
+    } else {
+      end = middle;
+    }
+  }
+
+  if (begin == 0) {
+    return false;
+  }
+
+  guint32 index = begin - 1;
+  if (strcmp(segment->keys[index], url) == 0) {
+    return true;
+  }
+
+  if (jumanji_db_segment_bloom_match(segment->blocks[index].bloom, url) == false) {
+    return false;
+  }
+
+  if (segment->cached == NULL || segment->cached_block != index) {
+    g_free(segment->cached);
+    segment->cached       = jumanji_db_segment_read_block(segment, index);
+    segment->cached_block = index;
+    if (segment->cached == NULL) {
+      return false;
+    }
+  }
+
+  /* records are sorted by url, which is the first of their three fields */
+  gsize size     = segment->blocks[index].size;
+  gsize position = 0;
+  for (unsigned int field = 0; position < size; field = (field + 1) % 3) {
+    char* field_end = memchr(segment->cached + position, '\0', size - position);
+    if (field_end == NULL) {
+      return false;
+    }
+
+    if (field == 0) {
+      int order = strcmp(segment->cached + position, url);
+      if (order >= 0) {
+        return order == 0;
+      }
+    }
+
+    position = field_end - segment->cached + 1;
+  }
+
+  return false;
+}
+
+static guint8*
+jumanji_db_segment_convert(GConverter* converter, const void* input, gsize
+    input_size, gsize output_size, gsize* converted_size)
+{
+  gsize capacity = MAX(output_size, 64);
+  guint8* output = g_malloc(capacity);
+  gsize length   = 0;
+
+  for (;;) {
+    gsize bytes_read    = 0;
+    gsize bytes_written = 0;
+    GError* error       = NULL;
+
+    GConverterResult result = g_converter_convert(converter, input, input_size,
+        output + length, capacity - length, G_CONVERTER_INPUT_AT_END,
+        &bytes_read, &bytes_written, &error);
+
+    if (result == G_CONVERTER_ERROR) {
+      bool no_space = g_error_matches(error, G_IO_ERROR, G_IO_ERROR_NO_SPACE);
+      g_error_free(error);
+
+      if (no_space == false) {
+        g_free(output);
+        return NULL;
+      }
+    }
+
+    input       = (const guint8*) input + bytes_read;
+    input_size -= bytes_read;
+    length     += bytes_written;
+
+    if (result == G_CONVERTER_FINISHED) {
+      break;
+    }
+
+    if (capacity - length < 64) {
+      capacity *= 2;
+      output    = g_realloc(output, capacity);
+    }
+  }
+
+  *converted_size = length;
+
+  return output;
+}
+
+static void
+jumanji_db_segment_bloom_set(guint8* bloom, guint trigram)
+{
+  guint hash = trigram * 2654435761u;
+
+  guint first  = hash >> 20;
+  guint second = (hash >> 8) % SEGMENT_BLOOM_BITS;
+
+  bloom[first / 8]  |= 1 << (first % 8);
+  bloom[second / 8] |= 1 << (second % 8);
+}
+
+static bool
+jumanji_db_segment_bloom_test(const guint8* bloom, guint trigram)
+{
+  guint hash = trigram * 2654435761u;
+
+  guint first  = hash >> 20;
+  guint second = (hash >> 8) % SEGMENT_BLOOM_BITS;
+
+  return (bloom[first / 8] & (1 << (first % 8))) != 0 &&
+    (bloom[second / 8] & (1 << (second % 8))) != 0;
+}
+
+static void
+jumanji_db_segment_bloom_add(guint8* bloom, const char* text)
+{
+  for (; text[0] != '\0' && text[1] != '\0' && text[2] != '\0'; text++) {
+    jumanji_db_segment_bloom_set(bloom, TRIGRAM(text));
+  }
+}
+
+static bool
+jumanji_db_segment_bloom_match(const guint8* bloom, const char* input)
+{
+  for (; input[0] != '\0' && input[1] != '\0' && input[2] != '\0'; input++) {
+    if (jumanji_db_segment_bloom_test(bloom, TRIGRAM(input)) == false) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static void
+jumanji_db_segments_refresh(jumanji_db_segments_t* segments)
+{
+  struct stat buf;
+  if (stat(segments->manifest_path, &buf) != 0) {
+    g_ptr_array_set_size(segments->segments, 0);
+    segments->manifest_inode = 0;
+    return;
+  }
+
+  if (buf.st_ino == segments->manifest_inode &&
+      buf.st_mtime == segments->manifest_mtime) {
+    return;
+  }
+
+  segments->manifest_inode = buf.st_ino;
+  segments->manifest_mtime = buf.st_mtime;
+
+  /* keep segments that are still listed open */
+  GArray* entries    = jumanji_db_segment_read_manifest(segments->manifest_path);
+  GPtrArray* current = g_ptr_array_new_with_free_func(jumanji_db_segment_free);
+
+  for (guint i = 0; i < entries->len; i++) {
+    guint sequence = g_array_index(entries, jumanji_db_segment_entry_t,
+        i).sequence;
+    jumanji_db_segment_t* segment = NULL;
+
+    for (guint j = 0; j < segments->segments->len; j++) {
+      jumanji_db_segment_t* old = g_ptr_array_index(segments->segments, j);
+      if (old != NULL && old->sequence == sequence) {
+        segment = old;
+        g_ptr_array_index(segments->segments, j) = NULL;
+        break;
+      }
+    }
+
+    if (segment == NULL) {
+      segment = jumanji_db_segment_open(segments->base_path, sequence);
+    }
+
+    if (segment != NULL) {
+      g_ptr_array_add(current, segment);
+    }
+  }
+
+  g_ptr_array_free(segments->segments, TRUE);
+  segments->segments = current;
+
+  g_array_free(entries, TRUE);
+}
+
+static jumanji_db_segment_writer_t*
+jumanji_db_segment_writer_new(const char* path)
+{
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (fd == -1) {
+    return NULL;
+  }
+
+  jumanji_db_segment_writer_t* writer = g_malloc0(sizeof(jumanji_db_segment_writer_t));
+
+  writer->fd         = fd;
+  writer->block      = g_byte_array_sized_new(SEGMENT_BLOCK_SIZE + 1024);
+  writer->blocks     = g_array_new(FALSE, FALSE, sizeof(jumanji_db_segment_block_t));
+  writer->keys       = g_byte_array_new();
+  writer->compressor = G_CONVERTER(g_zlib_compressor_new(
+        G_ZLIB_COMPRESSOR_FORMAT_RAW, -1));
+  writer->oldest     = G_MAXINT;
+
+  return writer;
+}
+
+static void
+jumanji_db_segment_writer_add(jumanji_db_segment_writer_t* writer, const char*
+    url, const char* title, int visited)
+{
+  /* records are NUL-separated: url, title and last visit */
+  char number[16];
+  int number_length = g_snprintf(number, sizeof(number), "%d", visited);
+
+  if (title == NULL) {
+    title = "";
+  }
+
+  /* the first url of a block locates urls without decompressing it */
+  if (writer->block->len == 0) {
+    g_byte_array_append(writer->keys, (const guint8*) url, strlen(url) + 1);
+  }
+
+  g_byte_array_append(writer->block, (const guint8*) url, strlen(url) + 1);
+  g_byte_array_append(writer->block, (const guint8*) title, strlen(title) + 1);
+  g_byte_array_append(writer->block, (const guint8*) number, number_length + 1);
+
+  jumanji_db_segment_bloom_add(writer->current.bloom, url);
+  jumanji_db_segment_bloom_add(writer->current.bloom, title);
+
+  writer->oldest = MIN(writer->oldest, visited);
+
+  if (writer->block->len >= SEGMENT_BLOCK_SIZE) {
+    jumanji_db_segment_writer_flush(writer);
+  }
+}
+
+static void
+jumanji_db_segment_writer_flush(jumanji_db_segment_writer_t* writer)
+{
+  if (writer->block->len == 0) {
+    return;
+  }
+
+  gsize size = 0;
+  guint8* compressed = jumanji_db_segment_convert(writer->compressor,
+      writer->block->data, writer->block->len, writer->block->len / 2, &size);
+  g_converter_reset(writer->compressor);
+
+  if (compressed == NULL ||
+      write(writer->fd, compressed, size) != (ssize_t) size) {
+    writer->failed = true;
+  }
+  g_free(compressed);
+
+  writer->current.offset          = writer->offset;
+  writer->current.compressed_size = size;
+  writer->current.size            = writer->block->len;
+  g_array_append_val(writer->blocks, writer->current);
+
+  writer->offset += size;
+  memset(&writer->current, 0, sizeof(writer->current));
+  g_byte_array_set_size(writer->block, 0);
+}
+
+static bool
+jumanji_db_segment_writer_close(jumanji_db_segment_writer_t* writer)
+{
+  jumanji_db_segment_writer_flush(writer);
+
+  /* the sparse index, the first urls of the blocks and the footer follow the
+   * blocks */
+  gsize index_size = writer->blocks->len * sizeof(jumanji_db_segment_block_t);
+
+  jumanji_db_segment_footer_t footer = {
+    .index_offset = writer->offset,
+    .keys_offset  = writer->offset + index_size,
+    .block_count  = writer->blocks->len,
+    .magic        = SEGMENT_MAGIC
+  };
+
+  if (write(writer->fd, writer->blocks->data, index_size) != (ssize_t) index_size ||
+      write(writer->fd, writer->keys->data, writer->keys->len) !=
+      (ssize_t) writer->keys->len ||
+      write(writer->fd, &footer, sizeof(footer)) != sizeof(footer) ||
+      fsync(writer->fd) != 0) {
+    writer->failed = true;
+  }
+
+  bool result = (writer->failed == false);
+
+  close(writer->fd);
+  g_object_unref(writer->compressor);
+  g_byte_array_free(writer->block, TRUE);
+  g_array_free(writer->blocks, TRUE);
+  g_byte_array_free(writer->keys, TRUE);
+  g_free(writer);
+
+  return result;
+}
+
+static bool
+jumanji_db_segment_iterator_next(jumanji_db_segment_iterator_t* iterator)
+{
+  if (iterator->links != NULL) {
+    if (iterator->link >= iterator->links->len) {
+      return false;
+    }
+
+    jumanji_db_result_link_t* link = g_ptr_array_index(iterator->links,
+        iterator->link++);
+
+    iterator->url     = link->url;
+    iterator->title   = link->title ? link->title : "";
+    iterator->visited = link->visited;
+
+    return true;
+  }
+
+  /* continue with the next block once the current one is exhausted */
+  while (iterator->buffer == NULL || iterator->position >= iterator->size) {
+    g_free(iterator->buffer);
+    iterator->buffer = NULL;
+
+    if (iterator->segment == NULL ||
+        iterator->block >= iterator->segment->block_count) {
+      return false;
+    }
+
+    iterator->size     = iterator->segment->blocks[iterator->block].size;
+    iterator->position = 0;
+    iterator->buffer   = jumanji_db_segment_read_block(iterator->segment,
+        iterator->block++);
+
+    if (iterator->buffer == NULL) {
+      return false;
+    }
+  }
+
+  const char* fields[3];
+  for (unsigned int i = 0; i < 3; i++) {
+    char* end = memchr(iterator->buffer + iterator->position, '\0',
+        iterator->size - iterator->position);
+    if (end == NULL) {
+      iterator->position = iterator->size;
+      return false;
+    }
+
+    fields[i]          = iterator->buffer + iterator->position;
+    iterator->position = end - iterator->buffer + 1;
+  }
+
+  iterator->url     = fields[0];
+  iterator->title   = fields[1];
+  iterator->visited = atoi(fields[2]);
+
+  return true;
+}
@@ -0,0 +1,83 @@
+/* See LICENSE file for license and copyright information */
+
+#ifndef DATABASE_SEGMENT_H
+#define DATABASE_SEGMENT_H
+
+#include <stdbool.h>
+#include <glib.h>
+#include <girara/types.h>
+
+#include "database-table.h"
+
+/**
+ * Cold segments of a history file
+ *
+ * Segments are immutable, compressed files of links sorted by url. The first
+ * url of every block tells which block may hold a url. They are listed in a
+ * manifest next to the history file, which is re-read whenever another
+ * instance changed it.
+ */
+typedef struct jumanji_db_segments_s jumanji_db_segments_t;
+
+/**
+ * Opens the segments of a history file
+ *
+ * @param base_path Path to the history file
+ * @return The segments or NULL if an error occured
+ */
+jumanji_db_segments_t* jumanji_db_segments_new(const char* base_path);
+
+/**
+ * Closes the segments
+ *
+ * @param segments The segments
+ */
+void jumanji_db_segments_free(jumanji_db_segments_t* segments);
+
+/**
+ * Calls a function for every link whose url or title contains the input, each
+ * url only once. Only blocks whose trigram filter matches the input are
+ * decompressed.
+ *
+ * @param segments The segments
+ * @param input The data that the links should match
+ * @param exclude Skips urls of which a newer version exists, may be NULL
+ * @param data Custom data passed to exclude
+ * @param function Receives the links
+ * @param function_data Custom data passed to function
+ * @return false if the function stopped the search
+ */
+bool jumanji_db_segments_match(jumanji_db_segments_t* segments, const char*
+    input, jumanji_db_exclude_function_t exclude, void* data,
+    jumanji_db_link_function_t function, void* function_data);
+
+/**
+ * Calls a function for every link of the segments, each url only once and in
+ * the order of the urls. Only one block of every segment is held in memory.
+ *
+ * @param segments The segments
+ * @param exclude Skips urls of which a newer version exists, may be NULL
+ * @param data Custom data passed to exclude
+ * @param function Function called for every link
+ * @param function_data Custom data passed to function
+ */
+void jumanji_db_segments_foreach(jumanji_db_segments_t* segments,
+    jumanji_db_exclude_function_t exclude, void* data,
+    jumanji_db_link_function_t function, void* function_data);
+
+/**
+ * Seals links into a new segment. Once too many segments exist, or a segment
+ * holds links visited before the given time, all segments are merged into a
+ * single one without those links. The caller has to hold the lock of the
+ * history journal.
+ *
+ * @param base_path Path to the history file
+ * @param links Array of jumanji_db_result_link_t, sorted by this function,
+ *        may be NULL
+ * @param visited Links last visited before are dropped, 0 keeps all
+ * @return true if no error occured
+ */
+bool jumanji_db_segments_seal(const char* base_path, GPtrArray* links, int
+    visited);
+
+#endif // DATABASE_SEGMENT_H
@@ -0,0 +1,454 @@
+/* See LICENSE file for license and copyright information */
+
+#define _POSIX_SOURCE
+#define _XOPEN_SOURCE 500
+
+#include <girara/datastructures.h>
+#include <girara/utils.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+#include "database.h"
+#include "database-snapshot.h"
+#include "database-table.h"
+
+#define SNAPSHOT_MAGIC 0x4e53454a
+#define SNAPSHOT_NO_TITLE G_MAXUINT32
+
+/* the file starts with the header, followed by the records, the trigram
+ * table, the postings and the strings. The postings of a trigram are the
+ * ascending indices of its records, stored as varint-encoded differences. */
+typedef struct jumanji_db_snapshot_header_s
+{
+  guint32 magic; /**> Identifies snapshot files */
+  guint32 generation; /**> Generation of the journal of the base file */
+  guint64 base_size; /**> Size of the base file */
+  guint32 count; /**> Number of records */
+  guint32 trigram_count; /**> Number of trigrams */
+  guint64 trigrams_offset; /**> Offset of the trigram table */
+  guint64 postings_offset; /**> Offset of the postings */
+  guint64 strings_offset; /**> Offset of the strings */
+} jumanji_db_snapshot_header_t;
+
+typedef struct jumanji_db_snapshot_record_s
+{
+  guint32 url; /**> Offset of the url in the strings */
+  guint32 title; /**> Offset of the title in the strings */
+  gint32 visited; /**> Last visit */
+} jumanji_db_snapshot_record_t;
+
+typedef struct jumanji_db_snapshot_trigram_s
+{
+  guint32 trigram; /**> The trigram */
+  guint32 postings; /**> Offset of the postings in the postings area */
+  guint32 count; /**> Number of records containing the trigram */
+} jumanji_db_snapshot_trigram_t;
+
+struct jumanji_db_snapshot_s
+{
+  char* data; /**> Mapping of the file */
+  size_t size; /**> Size of the mapping */
+  const jumanji_db_snapshot_header_t* header; /**> Header */
+  const jumanji_db_snapshot_record_t* records; /**> Records sorted by url */
+  const jumanji_db_snapshot_trigram_t* trigrams; /**> Trigrams in ascending order */
+  const guint8* postings; /**> Encoded record indices per trigram */
+  size_t postings_size; /**> Size of the postings */
+  const char* strings; /**> NUL-terminated strings */
+  size_t strings_size; /**> Size of the strings */
+};
+
+/* forward declarations */
+static const char* jumanji_db_snapshot_string(jumanji_db_snapshot_t* snapshot,
+    guint32 offset);
+static const jumanji_db_snapshot_trigram_t* jumanji_db_snapshot_trigram(
+    jumanji_db_snapshot_t* snapshot, guint trigram);
+static guint32 jumanji_db_snapshot_add_string(GString* strings, GHashTable*
+    offsets, const char* string);
+
+jumanji_db_snapshot_t*
+jumanji_db_snapshot_open(const char* path)
+{
+  int fd = open(path, O_RDONLY);
+  if (fd == -1) {
+    return NULL;
+  }
+
+  struct stat buf;
+  if (fstat(fd, &buf) != 0 ||
+      buf.st_size < (off_t) sizeof(jumanji_db_snapshot_header_t)) {
+    close(fd);
+    return NULL;
+  }
+
+  /* the mapping is shared, so that every instance uses the same pages */
+  char* data = mmap(NULL, buf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (data == MAP_FAILED) {
+    return NULL;
+  }
+
+  jumanji_db_snapshot_t* snapshot = g_malloc0(sizeof(jumanji_db_snapshot_t));
+  snapshot->data   = data;
+  snapshot->size   = buf.st_size;
+  snapshot->header = (const jumanji_db_snapshot_header_t*) data;
+
+  const jumanji_db_snapshot_header_t* header = snapshot->header;
+  guint64 records_end = sizeof(*header) + (guint64) header->count *
+    sizeof(jumanji_db_snapshot_record_t);
+
+  if (header->magic != SNAPSHOT_MAGIC ||
+      header->trigrams_offset < records_end ||
+      header->postings_offset < header->trigrams_offset +
+      (guint64) header->trigram_count * sizeof(jumanji_db_snapshot_trigram_t) ||
+      header->strings_offset < header->postings_offset ||
+      header->strings_offset >= snapshot->size ||
+      data[snapshot->size - 1] != '\0') {
+    girara_error("Invalid snapshot: %s", path);
+    jumanji_db_snapshot_free(snapshot);
+    return NULL;
+  }
+
+  snapshot->records      = (const jumanji_db_snapshot_record_t*) (data + sizeof(*header));
+  snapshot->trigrams     = (const jumanji_db_snapshot_trigram_t*) (data + header->trigrams_offset);
+  snapshot->postings      = (const guint8*) (data + header->postings_offset);
+  snapshot->postings_size = header->strings_offset - header->postings_offset;
+  snapshot->strings      = data + header->strings_offset;
+  snapshot->strings_size = snapshot->size - header->strings_offset;
+
+  return snapshot;
+}
+
+void
+jumanji_db_snapshot_free(jumanji_db_snapshot_t* snapshot)
+{
+  if (snapshot == NULL) {
+    return;
+  }
+
+  munmap(snapshot->data, snapshot->size);
+  g_free(snapshot);
+}
+
+bool
+jumanji_db_snapshot_matches(jumanji_db_snapshot_t* snapshot, unsigned int
+    generation, off_t base_size)
+{
+  return snapshot != NULL && snapshot->header->generation == generation &&
+    snapshot->header->base_size == (guint64) base_size;
+}
+
+unsigned int
+jumanji_db_snapshot_size(jumanji_db_snapshot_t* snapshot)
+{
+  return (snapshot != NULL) ? snapshot->header->count : 0;
+}
+
+void
+jumanji_db_snapshot_get(jumanji_db_snapshot_t* snapshot, unsigned int index,
+    jumanji_db_result_link_t* link)
+{
+  const jumanji_db_snapshot_record_t* record = &snapshot->records[index];
+
+  link->url     = (char*) jumanji_db_snapshot_string(snapshot, record->url);
+  link->title   = (record->title != SNAPSHOT_NO_TITLE) ?
+    (char*) jumanji_db_snapshot_string(snapshot, record->title) : NULL;
+  link->visited = record->visited;
+}
+
+bool
+jumanji_db_snapshot_contains(jumanji_db_snapshot_t* snapshot, const char* url)
+{
+  if (snapshot == NULL || url == NULL) {
+    return false;
+  }
+
+  guint32 low  = 0;
+  guint32 high = snapshot->header->count;
+
+  while (low < high) {
+    guint32 middle = low + (high - low) / 2;
+    int result = strcmp(jumanji_db_snapshot_string(snapshot,
+          snapshot->records[middle].url), url);
+
+    if (result == 0) {
+      return true;
+    } else if (result < 0) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  return false;
+}
+
+bool
+jumanji_db_snapshot_match(jumanji_db_snapshot_t* snapshot, const char* input,
+    jumanji_db_exclude_function_t exclude, void* data,
+    jumanji_db_link_function_t function, void* function_data)
+{
+  if (snapshot == NULL || input == NULL || function == NULL) {
+    return true;
+  }
+
+  /* inputs with a trigram only verify the records of their rarest trigram */
+  const jumanji_db_snapshot_trigram_t* shortest = NULL;
+  if (strlen(input) >= 3) {
+    for (const char* text = input; text[2] != '\0'; text++) {
+      const jumanji_db_snapshot_trigram_t* trigram =
+        jumanji_db_snapshot_trigram(snapshot, TRIGRAM(text));
+      if (trigram == NULL) {
+        return true;
+      }
+
+      if (shortest == NULL || trigram->count < shortest->count) {
+        shortest = trigram;
+      }
+    }
+  }
+
+  size_t position = (shortest != NULL) ? shortest->postings : 0;
+  guint32 count   = (shortest != NULL) ? shortest->count : snapshot->header->count;
+  guint32 index   = 0;
+
+  for (guint32 i = 0; i < count; i++) {
+    if (shortest != NULL) {
+      guint32 delta = 0;
+      for (unsigned int shift = 0; position < snapshot->postings_size && shift < 32; shift += 7) {
+        guint8 byte = snapshot->postings[position++];
+        delta |= (guint32) (byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+          break;
+        }
+      }
+      index = (i == 0) ? delta : index + delta;
+    } else {
+      index = i;
+    }
+
+    if (index >= snapshot->header->count) {
+      break;
+    }
+
+    jumanji_db_result_link_t link;
+    jumanji_db_snapshot_get(snapshot, index, &link);
+
+    if (strstr(link.url, input) == NULL &&
+        (link.title == NULL || strstr(link.title, input) == NULL)) {
+      continue;
+    }
+
+    if (exclude != NULL && exclude(link.url, data) == true) {
+      continue;
+    }
+
+    if (function(link.url, link.title, link.visited, function_data) == false) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static gint
+jumanji_db_snapshot_compare_links(gconstpointer a, gconstpointer b)
+{
+  return strcmp((*(jumanji_db_result_link_t**) a)->url,
+      (*(jumanji_db_result_link_t**) b)->url);
+}
+
+static gint
+jumanji_db_snapshot_compare_trigrams(gconstpointer a, gconstpointer b)
+{
+  guint first  = GPOINTER_TO_UINT(*(gconstpointer*) a);
+  guint second = GPOINTER_TO_UINT(*(gconstpointer*) b);
+
+  return (first > second) - (first < second);
+}
+
+bool
+jumanji_db_snapshot_write(const char* path, GPtrArray* links, unsigned int
+    generation, off_t base_size)
+{
+  GPtrArray* sorted = g_ptr_array_sized_new(links->len);
+  for (unsigned int i = 0; i < links->len; i++) {
+    if (g_ptr_array_index(links, i) != NULL) {
+      g_ptr_array_add(sorted, g_ptr_array_index(links, i));
+    }
+  }
+  g_ptr_array_sort(sorted, jumanji_db_snapshot_compare_links);
+
+  /* strings that occur more than once are stored once */
+  GString* strings    = g_string_new(NULL);
+  GHashTable* offsets = g_hash_table_new(g_str_hash, g_str_equal);
+  GArray* records     = g_array_sized_new(FALSE, FALSE,
+      sizeof(jumanji_db_snapshot_record_t), sorted->len);
+  GHashTable* index   = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+      NULL, (GDestroyNotify) jumanji_db_free_positions);
+
+  for (guint i = 0; i < sorted->len; i++) {
+    jumanji_db_result_link_t* link = g_ptr_array_index(sorted, i);
+
+    jumanji_db_snapshot_record_t record = {
+      .url     = jumanji_db_snapshot_add_string(strings, offsets, link->url),
+      .title   = (link->title != NULL) ?
+        jumanji_db_snapshot_add_string(strings, offsets, link->title) :
+        SNAPSHOT_NO_TITLE,
+      .visited = link->visited
+    };
+    g_array_append_val(records, record);
+
+    jumanji_db_trigrams_add(index, link->url, i);
+    if (link->title != NULL) {
+      jumanji_db_trigrams_add(index, link->title, i);
+    }
+  }
+
+  /* an empty snapshot ends with a NUL byte as well */
+  g_string_append_c(strings, '\0');
+
+  GPtrArray* keys = g_ptr_array_sized_new(g_hash_table_size(index));
+  GHashTableIter iter;
+  gpointer key;
+  g_hash_table_iter_init(&iter, index);
+  while (g_hash_table_iter_next(&iter, &key, NULL) == TRUE) {
+    g_ptr_array_add(keys, key);
+  }
+  g_ptr_array_sort(keys, jumanji_db_snapshot_compare_trigrams);
+
+  GArray* trigrams = g_array_sized_new(FALSE, FALSE,
+      sizeof(jumanji_db_snapshot_trigram_t), keys->len);
+  GByteArray* postings = g_byte_array_new();
+
+  for (guint i = 0; i < keys->len; i++) {
+    GArray* positions = g_hash_table_lookup(index, g_ptr_array_index(keys, i));
+
+    jumanji_db_snapshot_trigram_t trigram = {
+      .trigram  = GPOINTER_TO_UINT(g_ptr_array_index(keys, i)),
+      .postings = postings->len,
+      .count    = positions->len
+    };
+    g_array_append_val(trigrams, trigram);
+
+    guint previous = 0;
+    for (guint j = 0; j < positions->len; j++) {
+      guint delta = g_array_index(positions, guint, j) - previous;
+      previous    = g_array_index(positions, guint, j);
+
+      while (delta >= 0x80) {
+        guint8 byte = (delta & 0x7f) | 0x80;
+        g_byte_array_append(postings, &byte, 1);
+        delta >>= 7;
+      }
+
+      guint8 byte = delta;
+      g_byte_array_append(postings, &byte, 1);
+    }
+  }
+
+  jumanji_db_snapshot_header_t header = {
+    .magic         = SNAPSHOT_MAGIC,
+    .generation    = generation,
+    .base_size     = base_size,
+    .count         = records->len,
+    .trigram_count = trigrams->len
+  };
+
+  header.trigrams_offset = sizeof(header) + (guint64) records->len *
+    sizeof(jumanji_db_snapshot_record_t);
+  header.postings_offset = header.trigrams_offset + (guint64) trigrams->len *
+    sizeof(jumanji_db_snapshot_trigram_t);
+  header.strings_offset  = header.postings_offset + postings->len;
+
+  /* written next to the snapshot and renamed, mappings of the old file stay
+   * valid */
+  char* tmp_path = g_strconcat(path, ".tmp", NULL);
+  bool result    = false;
+
+  int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (fd != -1) {
+    gsize records_size  = records->len * sizeof(jumanji_db_snapshot_record_t);
+    gsize trigrams_size = trigrams->len * sizeof(jumanji_db_snapshot_trigram_t);
+    gsize postings_size = postings->len;
+
+    result = write(fd, &header, sizeof(header)) == sizeof(header) &&
+      write(fd, records->data, records_size) == (ssize_t) records_size &&
+      write(fd, trigrams->data, trigrams_size) == (ssize_t) trigrams_size &&
+      write(fd, postings->data, postings_size) == (ssize_t) postings_size &&
+      write(fd, strings->str, strings->len) == (ssize_t) strings->len &&
+      fsync(fd) == 0;
+    close(fd);
+  }
+
+  if (result == true && g_rename(tmp_path, path) != 0) {
+    result = false;
+  }
+
+  if (result == false) {
+    girara_error("Could not write snapshot: %s", path);
+    g_remove(tmp_path);
+  }
+
+  g_free(tmp_path);
+  g_byte_array_free(postings, TRUE);
+  g_array_free(trigrams, TRUE);
+  g_ptr_array_free(keys, TRUE);
+  g_hash_table_destroy(index);
+  g_array_free(records, TRUE);
+  g_hash_table_destroy(offsets);
+  g_string_free(strings, TRUE);
+  g_ptr_array_free(sorted, TRUE);
+
+  return result;
+}
+
+static const char*
+jumanji_db_snapshot_string(jumanji_db_snapshot_t* snapshot, guint32 offset)
+{
+  return (offset < snapshot->strings_size) ? snapshot->strings + offset : "";
+}
+
+static const jumanji_db_snapshot_trigram_t*
+jumanji_db_snapshot_trigram(jumanji_db_snapshot_t* snapshot, guint trigram)
+{
+  guint32 low  = 0;
+  guint32 high = snapshot->header->trigram_count;
+
+  while (low < high) {
+    guint32 middle = low + (high - low) / 2;
+    const jumanji_db_snapshot_trigram_t* entry = &snapshot->trigrams[middle];
+
+    if (entry->trigram == trigram) {
+      /* postings outside of the file are treated as a missing trigram */
+      return (entry->postings < snapshot->postings_size) ? entry : NULL;
+    } else if (entry->trigram < trigram) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  return NULL;
+}
+
+static guint32
+jumanji_db_snapshot_add_string(GString* strings, GHashTable* offsets, const
+    char* string)
+{
+  gpointer offset = NULL;
+  if (g_hash_table_lookup_extended(offsets, string, NULL, &offset) == TRUE) {
+    return GPOINTER_TO_UINT(offset);
+  }
+
+  guint32 position = strings->len;
+  g_string_append_len(strings, string, strlen(string) + 1);
+  g_hash_table_insert(offsets, (gpointer) string, GUINT_TO_POINTER(position));
+
+  return position;
+}
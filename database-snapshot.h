@@ -0,0 +1,104 @@
+/* See LICENSE file for license and copyright information */
+
+#ifndef DATABASE_SNAPSHOT_H
+#define DATABASE_SNAPSHOT_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include <glib.h>
+#include <girara/types.h>
+
+#include "database.h"
+#include "database-table.h"
+
+/**
+ * Read-only snapshot of a base file
+ *
+ * A snapshot holds the links of a base file sorted by url, together with
+ * a trigram index over them. It is mapped shared, so all instances that
+ * open it use the same pages.
+ */
+typedef struct jumanji_db_snapshot_s jumanji_db_snapshot_t;
+
+/**
+ * Maps a snapshot
+ *
+ * @param path Path to the snapshot
+ * @return The snapshot or NULL if it does not exist or is invalid
+ */
+jumanji_db_snapshot_t* jumanji_db_snapshot_open(const char* path);
+
+/**
+ * Unmaps a snapshot
+ *
+ * @param snapshot The snapshot
+ */
+void jumanji_db_snapshot_free(jumanji_db_snapshot_t* snapshot);
+
+/**
+ * Checks whether a snapshot mirrors a base file
+ *
+ * @param snapshot The snapshot
+ * @param generation Generation of the journal of the base file
+ * @param base_size Size of the base file
+ * @return true if the snapshot was written together with the base file
+ */
+bool jumanji_db_snapshot_matches(jumanji_db_snapshot_t* snapshot, unsigned int
+    generation, off_t base_size);
+
+/**
+ * Returns the number of links in a snapshot
+ *
+ * @param snapshot The snapshot
+ * @return Number of links
+ */
+unsigned int jumanji_db_snapshot_size(jumanji_db_snapshot_t* snapshot);
+
+/**
+ * Reads a link of a snapshot, the strings point into the mapping
+ *
+ * @param snapshot The snapshot
+ * @param index Index of the link
+ * @param link Link that is filled
+ */
+void jumanji_db_snapshot_get(jumanji_db_snapshot_t* snapshot, unsigned int
+    index, jumanji_db_result_link_t* link);
+
+/**
+ * Checks whether a snapshot contains an url
+ *
+ * @param snapshot The snapshot
+ * @param url The url
+ * @return true if the url is in the snapshot
+ */
+bool jumanji_db_snapshot_contains(jumanji_db_snapshot_t* snapshot, const char*
+    url);
+
+/**
+ * Calls a function for every link whose url or title contains the input
+ *
+ * @param snapshot The snapshot
+ * @param input The data that the links should match
+ * @param exclude Hides links, may be NULL
+ * @param data Custom data passed to exclude
+ * @param function Receives the links
+ * @param function_data Custom data passed to function
+ * @return false if the function stopped the search
+ */
+bool jumanji_db_snapshot_match(jumanji_db_snapshot_t* snapshot, const char*
+    input, jumanji_db_exclude_function_t exclude, void* data,
+    jumanji_db_link_function_t function, void* function_data);
+
+/**
+ * Writes a snapshot, replacing an existing one atomically
+ *
+ * @param path Path to the snapshot
+ * @param links Array of jumanji_db_result_link_t, may contain NULL
+ * @param generation Generation of the journal of the base file
+ * @param base_size Size of the base file
+ * @return true if no error occured
+ */
+bool jumanji_db_snapshot_write(const char* path, GPtrArray* links, unsigned
+    int generation, off_t base_size);
+
+#endif // DATABASE_SNAPSHOT_H
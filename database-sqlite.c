@@ -3,20 +3,279 @@
 #include <girara/datastructures.h>
 #include <girara/utils.h>
 #include <stdlib.h>
+#include <math.h>
 #include <time.h>
 #include <sqlite3.h>
 
 #include "database.h"
+#include "database-backend.h"
 
 #define DATABASE "jumanji.sqlite"
 
-struct jumanji_database_s
-{
-  sqlite3* session;
+/* directory in which the plain backend keeps its sessions */
+#define PLAIN_SESSION_DIR "sessions"
+
+/* page cache size in KiB */
+#define CACHE_SIZE 8192
+/* size of the memory mapped part of the database file */
+#define MMAP_SIZE (64 * 1024 * 1024)
+/* time in ms to wait for a lock held by another instance */
+#define BUSY_TIMEOUT 5000
+/* pages of the full text index merged per expired chunk */
+#define MERGE_PAGES 64
+/* free pages returned to the file system per expired chunk */
+#define VACUUM_PAGES 256
+
+/* time in seconds after which the weight of a visit is halved */
+#define FRECENCY_HALF_LIFE (30 * 24 * 60 * 60)
+
+/* rows added to a full text index per idle step */
+#define SEARCH_FILL_ROWS 4096
+/* fill position of a full text index that covers every row */
+#define SEARCH_COMPLETE G_MAXINT64
+/* minimal length of an input that can be searched in the full text index */
+#define SEARCH_MIN_LENGTH 3
+
+/* prepared statements */
+enum {
+  STATEMENT_BOOKMARK_ADD,
+  STATEMENT_BOOKMARK_REMOVE,
+  STATEMENT_BOOKMARK_FIND,
+  STATEMENT_BOOKMARK_SEARCH,
+  STATEMENT_BOOKMARK_ALL,
+  STATEMENT_HISTORY_ADD,
+  STATEMENT_HISTORY_IMPORT,
+  STATEMENT_HISTORY_CLEAN,
+  STATEMENT_HISTORY_EXPIRE_AGE,
+  STATEMENT_HISTORY_EXPIRE_SIZE,
+  STATEMENT_HISTORY_FIND,
+  STATEMENT_HISTORY_SEARCH,
+  STATEMENT_HISTORY_ALL,
+  STATEMENT_QUICKMARK_ADD,
+  STATEMENT_QUICKMARK_REMOVE,
+  STATEMENT_QUICKMARK_ALL,
+  STATEMENT_DATA_VERSION,
+  STATEMENT_SESSION_ADD,
+  STATEMENT_SESSION_FIND,
+  STATEMENT_SESSION_TABS,
+  STATEMENT_SESSION_CLEAR,
+  STATEMENT_TAB_ADD,
+  STATEMENT_TAB_UPDATE,
+  STATEMENT_TAB_REMOVE,
+  STATEMENT_COUNT
+};
+
+/* the full text search statements take the input as a single quoted phrase,
+ * the trigram tokenizer then matches it as a substring like LIKE does */
+static const char* const SQL_STATEMENTS[STATEMENT_COUNT] = {
+  [STATEMENT_BOOKMARK_ADD] =
+    "INSERT INTO bookmarks (url, title) VALUES (?, ?) "
+    "ON CONFLICT (url) DO UPDATE SET title = excluded.title;",
+  [STATEMENT_BOOKMARK_REMOVE] =
+    "DELETE FROM bookmarks WHERE url = ?;",
+  [STATEMENT_BOOKMARK_FIND] =
+    "SELECT b.url, b.title, 0 FROM bookmarks b "
+    "LEFT JOIN history h ON h.url = b.url WHERE "
+    "b.url LIKE (SELECT '%' || ?1 || '%') OR "
+    "b.title LIKE (SELECT '%' || ?1 || '%') "
+    "ORDER BY h.frecency DESC LIMIT ?2;",
+  [STATEMENT_BOOKMARK_SEARCH] =
+    "SELECT b.url, b.title, 0 FROM bookmarks_search "
+    "JOIN bookmarks b ON b.rowid = bookmarks_search.rowid "
+    "LEFT JOIN history h ON h.url = b.url WHERE "
+    "bookmarks_search MATCH '\"' || replace(?1, '\"', '\"\"') || '\"' "
+    "ORDER BY h.frecency DESC, rank LIMIT ?2;",
+  [STATEMENT_BOOKMARK_ALL] =
+    "SELECT url, title FROM bookmarks;",
+  [STATEMENT_HISTORY_ADD] =
+    "INSERT INTO history (url, title, visited, visit_count, frecency) "
+    "VALUES (?1, ?2, ?3, 1, ?3) "
+    "ON CONFLICT (url) DO UPDATE SET title = excluded.title, "
+    "visited = excluded.visited, visit_count = visit_count + 1, "
+    "frecency = frecency(frecency, excluded.visited);",
+  /* imported visits only count if they are newer than the stored one */
+  [STATEMENT_HISTORY_IMPORT] =
+    "INSERT INTO history (url, title, visited, visit_count, frecency) "
+    "VALUES (?1, ?2, ?3, 1, ?3) "
+    "ON CONFLICT (url) DO UPDATE SET title = excluded.title, "
+    "visited = excluded.visited, visit_count = visit_count + 1, "
+    "frecency = frecency(frecency, excluded.visited) "
+    "WHERE excluded.visited > visited;",
+  [STATEMENT_HISTORY_CLEAN] =
+    "DELETE FROM history WHERE visited < ?;",
+  [STATEMENT_HISTORY_EXPIRE_AGE] =
+    "DELETE FROM history WHERE rowid IN ("
+    "SELECT rowid FROM history WHERE visited < ?1 LIMIT ?2);",
+  [STATEMENT_HISTORY_EXPIRE_SIZE] =
+    "DELETE FROM history WHERE rowid IN ("
+    "SELECT rowid FROM history ORDER BY frecency DESC LIMIT ?2 OFFSET ?1);",
+  [STATEMENT_HISTORY_FIND] =
+    "SELECT url, title, visited FROM history WHERE "
+    "url LIKE (SELECT '%' || ?1 || '%') OR "
+    "title LIKE (SELECT '%' || ?1 || '%') "
+    "ORDER BY frecency DESC LIMIT ?2;",
+  [STATEMENT_HISTORY_SEARCH] =
+    "SELECT h.url, h.title, h.visited FROM history_search "
+    "JOIN history h ON h.rowid = history_search.rowid WHERE "
+    "history_search MATCH '\"' || replace(?1, '\"', '\"\"') || '\"' "
+    "ORDER BY h.frecency DESC LIMIT ?2;",
+  [STATEMENT_HISTORY_ALL] =
+    "SELECT url, title, visited FROM history ORDER BY frecency DESC;",
+  [STATEMENT_QUICKMARK_ADD] =
+    "REPLACE INTO quickmarks (identifier, url) VALUES (?, ?);",
+  [STATEMENT_QUICKMARK_REMOVE] =
+    "DELETE FROM quickmarks WHERE identifier = ?;",
+  [STATEMENT_QUICKMARK_ALL] =
+    "SELECT identifier, url FROM quickmarks;",
+  [STATEMENT_DATA_VERSION] =
+    "PRAGMA data_version;",
+  [STATEMENT_SESSION_ADD] =
+    "INSERT OR IGNORE INTO sessions (name) VALUES (?);",
+  [STATEMENT_SESSION_FIND] =
+    "SELECT id FROM sessions WHERE name = ?;",
+  [STATEMENT_SESSION_TABS] =
+    "SELECT id, position, url, title FROM tabs WHERE session = ? "
+    "ORDER BY position;",
+  [STATEMENT_SESSION_CLEAR] =
+    "DELETE FROM tabs WHERE session = ?;",
+  [STATEMENT_TAB_ADD] =
+    "INSERT INTO tabs (session, position, url, title) VALUES (?, ?, ?, ?);",
+  [STATEMENT_TAB_UPDATE] =
+    "UPDATE tabs SET url = ?, title = ? WHERE id = ?;",
+  [STATEMENT_TAB_REMOVE] =
+    "DELETE FROM tabs WHERE id = ?;"
 };
 
-jumanji_database_t*
-jumanji_db_init(const char* dir)
+/* full text index over url and title of $table, kept in sync by triggers. It
+ * is filled in chunks of rows ordered by rowid, so the triggers only cover the
+ * rows up to the recorded position, later rows are picked up by the fill. */
+static const char SQL_SEARCH_INIT[] =
+  "INSERT OR REPLACE INTO search_progress (name, position) "
+    "VALUES ('$table', 0);"
+  "CREATE VIRTUAL TABLE $table_search USING fts5("
+    "url, title, content = '$table', content_rowid = 'rowid', "
+    "tokenize = 'trigram'"
+    ");"
+  "CREATE TRIGGER $table_search_insert AFTER INSERT ON $table "
+    "WHEN new.rowid <= (SELECT position FROM search_progress WHERE name = "
+    "'$table') BEGIN "
+    "INSERT INTO $table_search (rowid, url, title) "
+    "VALUES (new.rowid, new.url, new.title); "
+    "END;"
+  "CREATE TRIGGER $table_search_delete AFTER DELETE ON $table "
+    "WHEN old.rowid <= (SELECT position FROM search_progress WHERE name = "
+    "'$table') BEGIN "
+    "INSERT INTO $table_search ($table_search, rowid, url, title) "
+    "VALUES ('delete', old.rowid, old.url, old.title); "
+    "END;"
+  "CREATE TRIGGER $table_search_update AFTER UPDATE ON $table "
+    "WHEN (old.url IS NOT new.url OR old.title IS NOT new.title) AND "
+    "old.rowid <= (SELECT position FROM search_progress WHERE name = "
+    "'$table') BEGIN "
+    "INSERT INTO $table_search ($table_search, rowid, url, title) "
+    "VALUES ('delete', old.rowid, old.url, old.title); "
+    "INSERT INTO $table_search (rowid, url, title) "
+    "VALUES (new.rowid, new.url, new.title); "
+    "END;";
+
+/* last row of the next chunk to fill, or of the table if it ends before */
+static const char SQL_SEARCH_CHUNK[] =
+  "SELECT coalesce((SELECT rowid FROM $table WHERE rowid > %" G_GINT64_FORMAT
+  " ORDER BY rowid LIMIT 1 OFFSET %d), (SELECT max(rowid) FROM $table), 0);";
+
+static const char SQL_SEARCH_FILL[] =
+  "INSERT INTO $table_search (rowid, url, title) SELECT rowid, url, title "
+  "FROM $table WHERE rowid > %" G_GINT64_FORMAT " AND rowid <= %"
+  G_GINT64_FORMAT ";"
+  "UPDATE search_progress SET position = %" G_GINT64_FORMAT " WHERE name = "
+  "'$table';";
+
+static const char SQL_SEARCH_DROP[] =
+  "DROP TRIGGER IF EXISTS $table_search_insert;"
+  "DROP TRIGGER IF EXISTS $table_search_delete;"
+  "DROP TRIGGER IF EXISTS $table_search_update;"
+  "DROP TABLE IF EXISTS $table_search;"
+  "DELETE FROM search_progress WHERE name = '$table';";
+
+typedef struct jumanji_db_sqlite_s
+{
+  sqlite3* session; /**> Database connection */
+  sqlite3_stmt* statements[STATEMENT_COUNT]; /**> Prepared statements */
+  bool search; /**> Full text indices are available */
+  bool search_pending; /**> Full text indices are filled by the idle steps */
+  char* import_dir; /**> Directory of plain files left to import when idle */
+  bool incremental; /**> Free pages can be returned incrementally */
+  bool merge; /**> Expired links are still marked in the full text index */
+
+  /* bookmarks and quickmarks are few and looked up one at a time, so they
+   * are mirrored in memory and written through to the database */
+  GHashTable* bookmarks; /**> Titles of the bookmarks by url */
+  char* quickmarks[G_MAXUINT8 + 1]; /**> Urls of the quickmarks by identifier */
+  int data_version; /**> Version of the database the mirror was loaded from */
+} jumanji_db_sqlite_t;
+
+/* stored tab of a session */
+typedef struct jumanji_db_sqlite_tab_s
+{
+  sqlite3_int64 id; /**> Row of the tab */
+  double position; /**> Sort key of the tab within its session */
+  char* url; /**> Url of the tab */
+  char* title; /**> Title of the tab */
+} jumanji_db_sqlite_tab_t;
+
+/* progress of an import */
+typedef struct jumanji_db_sqlite_import_s
+{
+  jumanji_db_sqlite_t* database; /**> Database the links are imported into */
+  unsigned int count; /**> Number of imported links */
+} jumanji_db_sqlite_import_t;
+
+/* forward declarations */
+static void jumanji_db_sqlite_free(void* data);
+static sqlite3_stmt* jumanji_db_prepare_statement(sqlite3* session, const char* statement);
+static sqlite3_stmt* jumanji_db_sqlite_statement(jumanji_db_sqlite_t* database, unsigned int index);
+static bool jumanji_db_sqlite_init_frecency(jumanji_db_sqlite_t* database);
+static void jumanji_db_sqlite_frecency(sqlite3_context* context, int argc,
+    sqlite3_value** argv);
+static bool jumanji_db_sqlite_prepare_statements(jumanji_db_sqlite_t* database);
+static bool jumanji_db_sqlite_has_search(jumanji_db_sqlite_t* database, const char* table);
+static sqlite3_int64 jumanji_db_sqlite_search_position(jumanji_db_sqlite_t*
+    database, const char* table);
+static bool jumanji_db_sqlite_search_exec(jumanji_db_sqlite_t* database, const char* sql);
+static bool jumanji_db_sqlite_init_search(jumanji_db_sqlite_t* database, const char* table);
+static bool jumanji_db_sqlite_fill_search(jumanji_db_sqlite_t* database, const
+    char* table, sqlite3_int64 position);
+static void jumanji_db_sqlite_match(jumanji_db_sqlite_t* database, unsigned
+    int find, unsigned int search, const char* input, unsigned int limit,
+    jumanji_db_link_function_t function, void* data);
+static sqlite3_int64 jumanji_db_sqlite_session_id(jumanji_db_sqlite_t* database,
+    const char* name, bool create);
+static GArray* jumanji_db_sqlite_session_tabs(jumanji_db_sqlite_t* database,
+    sqlite3_int64 session);
+static bool jumanji_db_sqlite_session_update(jumanji_db_sqlite_t* database,
+    sqlite3_int64 session, GPtrArray* links);
+static void jumanji_db_sqlite_session_write(jumanji_db_sqlite_t* database,
+    sqlite3_int64 session, GPtrArray* links);
+static void jumanji_db_sqlite_tab_add(jumanji_db_sqlite_t* database,
+    sqlite3_int64 session, double position, jumanji_db_result_link_t* link);
+static void jumanji_db_sqlite_tab_clear(void* data);
+static char* jumanji_db_sqlite_table_sql(const char* sql, const char* table);
+static int jumanji_db_sqlite_pragma(jumanji_db_sqlite_t* database, const char*
+    name);
+static bool jumanji_db_sqlite_merge(jumanji_db_sqlite_t* database);
+static bool jumanji_db_sqlite_vacuum(jumanji_db_sqlite_t* database);
+static void jumanji_db_sqlite_load_marks(jumanji_db_sqlite_t* database);
+static void jumanji_db_sqlite_sync_marks(jumanji_db_sqlite_t* database);
+static bool jumanji_db_sqlite_import(void* data, const char* dir);
+static bool jumanji_db_sqlite_import_bookmark(const char* url, const char*
+    title, int visited, void* data);
+static bool jumanji_db_sqlite_import_history(const char* url, const char*
+    title, int visited, void* data);
+static void jumanji_db_sqlite_import_sessions(jumanji_db_sqlite_t* database,
+    void* plain, const char* dir);
+
+static void*
+jumanji_db_sqlite_init(const char* dir)
 {
   if (dir == NULL) {
     return NULL;
@@ -27,11 +286,17 @@ jumanji_db_init(const char* dir)
     goto error_ret;
   }
 
-  jumanji_database_t* database = g_malloc0(sizeof(jumanji_database_t));
+  jumanji_db_sqlite_t* database = g_malloc0(sizeof(jumanji_db_sqlite_t));
   if (database == NULL) {
     goto error_free;
   }
 
+  database->bookmarks = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+      g_free);
+
+  /* a new database takes over the files of the plain backend */
+  bool created = g_file_test(path, G_FILE_TEST_EXISTS) == false;
+
   /* connect/create to bookmark database */
   static const char SQL_BOOKMARK_INIT[] =
     /* bookmarks table */
@@ -45,8 +310,11 @@ jumanji_db_init(const char* dir)
     "CREATE TABLE IF NOT EXISTS history ("
       "url TEXT PRIMARY KEY,"
       "title TEXT,"
-      "visited INT"
-      ");";
+      "visited INT,"
+      "visit_count INT NOT NULL DEFAULT 1,"
+      "frecency REAL NOT NULL DEFAULT 0"
+      ");"
+    "CREATE INDEX IF NOT EXISTS history_visited ON history (visited);";
 
   static const char SQL_QUICKMARKS_INIT[] =
     /* quickmarks table */
@@ -55,10 +323,58 @@ jumanji_db_init(const char* dir)
       "url TEXT"
       ");";
 
+  static const char SQL_SESSIONS_INIT[] =
+    /* sessions and their tabs, ordered by a sparse position so that a tab
+     * can be inserted without moving the others */
+    "CREATE TABLE IF NOT EXISTS sessions ("
+      "id INTEGER PRIMARY KEY,"
+      "name TEXT UNIQUE NOT NULL"
+      ");"
+    "CREATE TABLE IF NOT EXISTS tabs ("
+      "id INTEGER PRIMARY KEY,"
+      "session INT NOT NULL,"
+      "position REAL NOT NULL,"
+      "url TEXT,"
+      "title TEXT"
+      ");"
+    "CREATE INDEX IF NOT EXISTS tabs_position ON tabs (session, position);";
+
+  static const char SQL_SEARCH_PROGRESS_INIT[] =
+    /* rows up to which the full text indices have been filled */
+    "CREATE TABLE IF NOT EXISTS search_progress ("
+      "name TEXT PRIMARY KEY,"
+      "position INT NOT NULL"
+      ");";
+
   if (sqlite3_open(path, &(database->session)) != SQLITE_OK) {
     goto error_free;
   }
 
+  /* with a write-ahead log readers and the writer do not block each other
+   * and a commit only syncs the log at checkpoints, auto_vacuum only takes
+   * effect before the first table is created */
+  char* pragmas = g_strdup_printf(
+      "PRAGMA auto_vacuum = INCREMENTAL;"
+      "PRAGMA journal_mode = WAL;"
+      "PRAGMA synchronous = NORMAL;"
+      "PRAGMA temp_store = MEMORY;"
+      "PRAGMA cache_size = -%d;"
+      "PRAGMA mmap_size = %d;", CACHE_SIZE, MMAP_SIZE);
+
+  if (sqlite3_exec(database->session, pragmas, NULL, 0, NULL) != SQLITE_OK) {
+    girara_error("Could not configure database: %s\n", path);
+  }
+
+  g_free(pragmas);
+
+  sqlite3_busy_timeout(database->session, BUSY_TIMEOUT);
+
+  if (sqlite3_create_function(database->session, "frecency", 2, SQLITE_UTF8 |
+        SQLITE_DETERMINISTIC, NULL, jumanji_db_sqlite_frecency, NULL, NULL) !=
+      SQLITE_OK) {
+    goto error_free;
+  }
+
   /* initialize database scheme */
   if (sqlite3_exec(database->session, SQL_BOOKMARK_INIT, NULL, 0, NULL) != SQLITE_OK) {
     girara_error("Could not initialize database: %s\n", path);
@@ -75,15 +391,50 @@ jumanji_db_init(const char* dir)
     goto error_free;
   }
 
-  return database;
+  if (sqlite3_exec(database->session, SQL_SESSIONS_INIT, NULL, 0, NULL) != SQLITE_OK) {
+    girara_error("Could not initialize database: %s\n", path);
+    goto error_free;
+  }
 
-error_free:
+  if (sqlite3_exec(database->session, SQL_SEARCH_PROGRESS_INIT, NULL, 0, NULL) != SQLITE_OK) {
+    girara_error("Could not initialize database: %s\n", path);
+    goto error_free;
+  }
 
-  if (database->session != NULL) {
-    sqlite3_close(database->session);
+  if (jumanji_db_sqlite_init_frecency(database) == false) {
+    girara_error("Could not initialize database: %s\n", path);
+    goto error_free;
   }
 
-  g_free(database);
+  database->incremental = jumanji_db_sqlite_pragma(database, "auto_vacuum") == 2;
+
+  /* filling the full text indices over an existing history takes a while,
+   * so it is left to the idle steps and searches fall back to a scan until
+   * both are complete */
+  database->search = jumanji_db_sqlite_search_position(database, "bookmarks")
+    == SEARCH_COMPLETE && jumanji_db_sqlite_search_position(database,
+        "history") == SEARCH_COMPLETE;
+  database->search_pending = (database->search == false);
+
+  if (jumanji_db_sqlite_prepare_statements(database) == false) {
+    goto error_free;
+  }
+
+  jumanji_db_sqlite_load_marks(database);
+
+  /* the import is left to the idle steps as well, so that startup does not
+   * wait for it */
+  if (created == true) {
+    database->import_dir = g_strdup(dir);
+  }
+
+  g_free(path);
+
+  return database;
+
+error_free:
+
+  jumanji_db_sqlite_free(database);
 
 error_ret:
 
@@ -92,414 +443,1385 @@ error_ret:
   return NULL;
 }
 
-bool
-jumanji_db_check_location(const char* dir)
+static bool
+jumanji_db_sqlite_init_frecency(jumanji_db_sqlite_t* database)
 {
-  if (dir == NULL) {
-    return false;
+  /* history tables of older versions only know the last visit */
+  if (sqlite3_table_column_metadata(database->session, NULL, "history",
+        "frecency", NULL, NULL, NULL, NULL, NULL) != SQLITE_OK) {
+    static const char SQL_FRECENCY_MIGRATE[] =
+      "ALTER TABLE history ADD COLUMN visit_count INT NOT NULL DEFAULT 1;"
+      "ALTER TABLE history ADD COLUMN frecency REAL NOT NULL DEFAULT 0;"
+      "UPDATE history SET frecency = visited;";
+
+    if (sqlite3_exec(database->session, SQL_FRECENCY_MIGRATE, NULL, 0, NULL) !=
+        SQLITE_OK) {
+      return false;
+    }
   }
 
-  /* check database file path */
-  char* file = g_build_filename(dir, DATABASE, NULL);
-  if (file == NULL) {
-    return false;
-  }
-  if (g_file_test(file, G_FILE_TEST_EXISTS) == true) {
-    return true;
-  }
-  free(file);
+  static const char SQL_FRECENCY_INDEX[] =
+    "CREATE INDEX IF NOT EXISTS history_frecency ON history (frecency DESC);";
 
-  return false;
+  return sqlite3_exec(database->session, SQL_FRECENCY_INDEX, NULL, 0, NULL) ==
+    SQLITE_OK;
 }
 
-void
-jumanji_db_free(jumanji_database_t* database)
+/*
+ * The frecency of a link is the sum of its visits, each weighted by
+ * 2^((visited - now) / FRECENCY_HALF_LIFE). It is stored as the time at
+ * which a single visit would have the same weight, so that the order of two
+ * links does not change as time goes on and the column can be indexed.
+ */
+static void
+jumanji_db_sqlite_frecency(sqlite3_context* context, int argc, sqlite3_value**
+    argv)
 {
-  if (database == NULL) {
-    return;
-  }
+  double frecency = sqlite3_value_double(argv[0]);
+  double visited  = sqlite3_value_double(argv[1]);
+  double scale    = FRECENCY_HALF_LIFE / G_LN2;
 
-  if (database->session != NULL) {
-    sqlite3_close(database->session);
-  }
+  /* log-sum-exp of both weights */
+  double high = fmax(frecency, visited);
+  double low  = fmin(frecency, visited);
 
-  g_free(database);
+  sqlite3_result_double(context, high + scale * log1p(exp((low - high) / scale)));
 }
 
-sqlite3_stmt*
-jumanji_db_prepare_statement(sqlite3* session, const char* statement)
+static bool
+jumanji_db_sqlite_prepare_statements(jumanji_db_sqlite_t* database)
 {
-  if (session == NULL || statement == NULL) {
-    return false;
-  }
-
-  const char* pz_tail   = NULL;
-  sqlite3_stmt* pp_stmt = NULL;
+  /* statements are prepared once and reused for every call */
+  for (unsigned int i = 0; i < STATEMENT_COUNT; i++) {
+    if (database->statements[i] != NULL || (database->search == false && (i ==
+            STATEMENT_BOOKMARK_SEARCH || i == STATEMENT_HISTORY_SEARCH))) {
+      continue;
+    }
 
-  if (sqlite3_prepare(session, statement, -1, &pp_stmt, &pz_tail) != SQLITE_OK) {
-    girara_error("Failed to prepare query: %s", statement);
-    goto error_free;
-  } else if (pz_tail && *pz_tail != '\0') {
-    girara_error("Unused portion of statement: %s", pz_tail);
-    goto error_free;
+    database->statements[i] = jumanji_db_prepare_statement(database->session,
+        SQL_STATEMENTS[i]);
+    if (database->statements[i] == NULL) {
+      return false;
+    }
   }
 
-  return pp_stmt;
-
-error_free:
+  return true;
+}
 
-  if (pp_stmt != NULL) {
-    sqlite3_finalize(pp_stmt);
-  }
+static bool
+jumanji_db_sqlite_has_search(jumanji_db_sqlite_t* database, const char* table)
+{
+  char* name = g_strdup_printf("%s_search", table);
+  bool exists = sqlite3_table_column_metadata(database->session, NULL, name,
+      NULL, NULL, NULL, NULL, NULL, NULL) == SQLITE_OK;
+  g_free(name);
 
-  return NULL;
+  return exists;
 }
 
-girara_list_t*
-jumanji_db_bookmark_find(jumanji_database_t* database, const char* input)
+/**
+ * Returns the row up to which the full text index of a table has been filled
+ *
+ * @param database The database
+ * @param table The indexed table
+ * @return SEARCH_COMPLETE if it covers every row, -1 if it does not exist
+ */
+static sqlite3_int64
+jumanji_db_sqlite_search_position(jumanji_db_sqlite_t* database, const char*
+    table)
 {
-  if (database == NULL || database->session == NULL || input == NULL) {
-    return NULL;
+  if (jumanji_db_sqlite_has_search(database, table) == false) {
+    return -1;
   }
 
-  /* prepare statement */
-  static const char SQL_HISTORY_FIND[] =
-    "SELECT * FROM bookmarks WHERE "
-    "url LIKE (SELECT '%' || ? || '%') OR "
-    "title LIKE (SELECT '%' || ? || '%');";
-
-  sqlite3_stmt* statement =
-    jumanji_db_prepare_statement(database->session, SQL_HISTORY_FIND);
-
+  sqlite3_stmt* statement = jumanji_db_prepare_statement(database->session,
+      "SELECT position FROM search_progress WHERE name = ?;");
   if (statement == NULL) {
-    return NULL;
-  }
-
-  /* bind values */
-  if (sqlite3_bind_text(statement, 1, input, -1, NULL) != SQLITE_OK ||
-      sqlite3_bind_text(statement, 2, input, -1, NULL) != SQLITE_OK
-      ) {
-    girara_error("Could not bind query parameters");
-    sqlite3_finalize(statement);
-    return NULL;
+    return -1;
   }
 
-  girara_list_t* results = girara_list_new();
-
-  if (results == NULL) {
-    sqlite3_finalize(statement);
-    return NULL;
+  /* an index without progress has been filled at once */
+  sqlite3_int64 position = SEARCH_COMPLETE;
+  if (sqlite3_bind_text(statement, 1, table, -1, NULL) == SQLITE_OK &&
+      sqlite3_step(statement) == SQLITE_ROW) {
+    position = sqlite3_column_int64(statement, 0);
   }
 
-  girara_list_set_free_function(results, jumanji_db_free_result_link);
+  sqlite3_finalize(statement);
 
-  while(sqlite3_step(statement) == SQLITE_ROW) {
-    jumanji_db_result_link_t* link = malloc(sizeof(jumanji_db_result_link_t));
-    if (link == NULL) {
-      sqlite3_finalize(statement);
-      return NULL;
-    }
+  return position;
+}
 
-    char* url   = (char*) sqlite3_column_text(statement, 0);
-    char* title = (char*) sqlite3_column_text(statement, 1);
+static bool
+jumanji_db_sqlite_search_exec(jumanji_db_sqlite_t* database, const char* sql)
+{
+  char* error = NULL;
 
-    link->url     = g_strdup(url);
-    link->title   = g_strdup(title);
-    link->visited = 0;
+  bool result = sqlite3_exec(database->session, "SAVEPOINT search;", NULL, 0,
+      NULL) == SQLITE_OK && sqlite3_exec(database->session, sql, NULL, 0, &error)
+    == SQLITE_OK;
 
-    girara_list_append(results, link);
+  if (result == false) {
+    girara_warning("Could not update full text index: %s", error);
+    sqlite3_exec(database->session, "ROLLBACK TO search;", NULL, 0, NULL);
   }
 
-  sqlite3_finalize(statement);
+  sqlite3_exec(database->session, "RELEASE search;", NULL, 0, NULL);
+  sqlite3_free(error);
 
-  return results;
+  return result;
 }
 
-void
-jumanji_db_bookmark_remove(jumanji_database_t* database, const char* url)
+static bool
+jumanji_db_sqlite_init_search(jumanji_db_sqlite_t* database, const char* table)
 {
-  if (database == NULL || database->session == NULL || url == NULL) {
-    return;
+  /* check if the index already exists */
+  if (jumanji_db_sqlite_has_search(database, table) == true) {
+    return true;
   }
 
-  /* prepare statement */
-  static const char SQL_BOOKMARK_ADD[] =
-    "DELETE FROM bookmarks WHERE url = ?;";
+  /* the index starts out empty and is filled by the idle steps */
+  char* sql   = jumanji_db_sqlite_table_sql(SQL_SEARCH_INIT, table);
+  bool result = jumanji_db_sqlite_search_exec(database, sql);
+  g_free(sql);
 
-  sqlite3_stmt* statement =
-    jumanji_db_prepare_statement(database->session, SQL_BOOKMARK_ADD);
+  return result;
+}
 
-  if (statement == NULL) {
-    return;
-  }
+static bool
+jumanji_db_sqlite_fill_search(jumanji_db_sqlite_t* database, const char* table,
+    sqlite3_int64 position)
+{
+  char* format = jumanji_db_sqlite_table_sql(SQL_SEARCH_CHUNK, table);
+  char* sql    = g_strdup_printf(format, (gint64) position, SEARCH_FILL_ROWS - 1);
+  g_free(format);
 
-  /* bind values */
-  if (sqlite3_bind_text(statement, 1, url, -1, NULL) != SQLITE_OK) {
-    girara_error("Could not bind query parameters");
-    sqlite3_finalize(statement);
-    return;
+  sqlite3_stmt* statement = jumanji_db_prepare_statement(database->session, sql);
+  g_free(sql);
+
+  if (statement == NULL) {
+    return false;
   }
 
-  sqlite3_step(statement);
+  sqlite3_int64 end = sqlite3_step(statement) == SQLITE_ROW ?
+    sqlite3_column_int64(statement, 0) : -1;
   sqlite3_finalize(statement);
-}
 
-void
-jumanji_db_bookmark_add(jumanji_database_t* database, const char* url, const char* title)
-{
-  if (database == NULL || database->session == NULL || url == NULL || title ==
-      NULL) {
-    return;
+  if (end < 0) {
+    return false;
   }
 
-  /* prepare statement */
-  static const char SQL_BOOKMARK_ADD[] =
-    "REPLACE INTO bookmarks (url, title) VALUES (?, ?);";
-
-  sqlite3_stmt* statement = jumanji_db_prepare_statement(database->session,
-      SQL_BOOKMARK_ADD);
-
-  if (statement == NULL) {
-    return;
+  /* once no rows are left the triggers take over all of them */
+  if (end <= position) {
+    end = SEARCH_COMPLETE;
   }
 
-  /* bind values */
-  if (sqlite3_bind_text(statement, 1, url,   -1, NULL) != SQLITE_OK ||
-      sqlite3_bind_text(statement, 2, title, -1, NULL) != SQLITE_OK
-      ) {
-    girara_error("Could not bind query parameters");
-    sqlite3_finalize(statement);
-    return;
-  }
+  format = jumanji_db_sqlite_table_sql(SQL_SEARCH_FILL, table);
+  sql    = g_strdup_printf(format, (gint64) position, (gint64) end, (gint64)
+      end);
+  g_free(format);
 
-  sqlite3_step(statement);
-  sqlite3_finalize(statement);
+  bool result = jumanji_db_sqlite_search_exec(database, sql);
+  g_free(sql);
+
+  return result;
 }
 
-girara_list_t*
-jumanji_db_history_find(jumanji_database_t* database, const char* input)
+static bool
+jumanji_db_sqlite_idle(void* data)
 {
-  if (database == NULL || database->session == NULL || input == NULL) {
-    return NULL;
-  }
+  jumanji_db_sqlite_t* database = (jumanji_db_sqlite_t*) data;
 
-  /* prepare statement */
-  static const char SQL_HISTORY_FIND[] =
-    "SELECT * FROM history WHERE "
-    "url LIKE (SELECT '%' || ? || '%') OR "
-    "title LIKE (SELECT '%' || ? || '%');";
+  if (database == NULL || database->session == NULL) {
+    return false;
+  }
 
-  sqlite3_stmt* statement = jumanji_db_prepare_statement(database->session,
-      SQL_HISTORY_FIND);
+  /* the import drops the indices, so it goes first */
+  if (database->import_dir != NULL) {
+    jumanji_db_sqlite_import(database, database->import_dir);
+    g_free(database->import_dir);
+    database->import_dir = NULL;
 
-  if (statement == NULL) {
-    return NULL;
+    return database->search_pending;
   }
 
-  /* bind values */
-  if (sqlite3_bind_text(statement, 1, input, -1, NULL) != SQLITE_OK ||
-      sqlite3_bind_text(statement, 2, input, -1, NULL) != SQLITE_OK
-      ) {
-    girara_error("Could not bind query parameters");
-    sqlite3_finalize(statement);
-    return NULL;
+  if (database->search_pending == false) {
+    return false;
   }
 
-  girara_list_t* results = girara_list_new();
-
-  if (results == NULL) {
-    sqlite3_finalize(statement);
-    return NULL;
-  }
+  /* a chunk at a time, so that jobs do not wait for the whole index */
+  static const char* const tables[] = { "bookmarks", "history" };
 
-  girara_list_set_free_function(results, jumanji_db_free_result_link);
+  for (unsigned int i = 0; i < G_N_ELEMENTS(tables); i++) {
+    sqlite3_int64 position = jumanji_db_sqlite_search_position(database,
+        tables[i]);
+    if (position == SEARCH_COMPLETE) {
+      continue;
+    }
 
-  while(sqlite3_step(statement) == SQLITE_ROW) {
-    jumanji_db_result_link_t* link = malloc(sizeof(jumanji_db_result_link_t));
-    if (link == NULL) {
-      sqlite3_finalize(statement);
-      return NULL;
+    /* without fts5 searches keep falling back to a scan */
+    if ((position < 0 && jumanji_db_sqlite_init_search(database, tables[i]) ==
+          false) || jumanji_db_sqlite_fill_search(database, tables[i],
+            MAX(position, 0)) == false) {
+      database->search_pending = false;
+      return false;
     }
 
-    char* url   = (char*) sqlite3_column_text(statement, 0);
-    char* title = (char*) sqlite3_column_text(statement, 1);
+    return true;
+  }
 
-    link->url     = g_strdup(url);
-    link->title   = g_strdup(title);
-    link->visited = sqlite3_column_int(statement, 2);
+  database->search_pending = false;
+  database->search         = true;
 
-    girara_list_append(results, link);
+  if (jumanji_db_sqlite_prepare_statements(database) == false) {
+    database->search = false;
   }
 
-  sqlite3_finalize(statement);
-
-  return results;
+  return false;
 }
 
-void
-jumanji_db_history_add(jumanji_database_t* database, const char* url, const char* title)
+static bool
+jumanji_db_sqlite_check_location(const char* dir)
 {
-  if (database == NULL || database->session == NULL || url == NULL || title == NULL) {
-    return;
+  if (dir == NULL) {
+    return false;
   }
 
-  /* add to database */
-  static const char SQL_HISTORY_ADD[] =
-    "REPLACE INTO history (url, title, visited) VALUES (?, ?, ?)";
-
-  sqlite3_stmt* statement =
-    jumanji_db_prepare_statement(database->session, SQL_HISTORY_ADD);
-
-  if (statement == NULL) {
-    return;
+  /* check database file path */
+  char* file = g_build_filename(dir, DATABASE, NULL);
+  if (file == NULL) {
+    return false;
   }
-
-  if (sqlite3_bind_text(statement, 1, url,   -1, NULL) != SQLITE_OK ||
-      sqlite3_bind_text(statement, 2, title, -1, NULL) != SQLITE_OK ||
-      sqlite3_bind_int( statement, 3, time(NULL))      != SQLITE_OK
-      ) {
-    girara_error("Could not bind query parameters");
-    sqlite3_finalize(statement);
-    return;
+  if (g_file_test(file, G_FILE_TEST_EXISTS) == true) {
+    return true;
   }
+  free(file);
 
-  sqlite3_step(statement);
-  sqlite3_finalize(statement);
+  return false;
 }
 
-void
-jumanji_db_history_clean(jumanji_database_t* database, unsigned int age)
+static void
+jumanji_db_sqlite_free(void* data)
 {
-  if (database == NULL || database->session == NULL) {
+  jumanji_db_sqlite_t* database = (jumanji_db_sqlite_t*) data;
+
+  if (database == NULL) {
     return;
   }
 
-  /* prepare statement */
-  static const char SQL_HISTORY_CLEAN[] =
-    "DELETE FROM history WHERE visited >= ?;";
+  for (unsigned int i = 0; i < STATEMENT_COUNT; i++) {
+    if (database->statements[i] != NULL) {
+      sqlite3_finalize(database->statements[i]);
+    }
+  }
 
-  sqlite3_stmt* statement =
-    jumanji_db_prepare_statement(database->session, SQL_HISTORY_CLEAN);
+  if (database->session != NULL) {
+    sqlite3_close(database->session);
+  }
 
-  if (statement == NULL) {
-    return;
+  if (database->bookmarks != NULL) {
+    g_hash_table_destroy(database->bookmarks);
   }
 
-  /* bind values */
-  int visited = time(NULL) - age;
-  if (sqlite3_bind_int(statement, 1, visited) != SQLITE_OK) {
-    girara_error("Could not bind query parameters");
-    sqlite3_finalize(statement);
-    return;
+  for (unsigned int i = 0; i <= G_MAXUINT8; i++) {
+    g_free(database->quickmarks[i]);
   }
 
-  sqlite3_step(statement);
-  sqlite3_finalize(statement);
+  g_free(database->import_dir);
+  g_free(database);
 }
 
-void
-jumanji_db_quickmark_add(jumanji_database_t* database, const char identifier, const char* url)
+static void
+jumanji_db_sqlite_begin(void* data)
 {
-  if (database == NULL || database->session == NULL || url == NULL) {
+  jumanji_db_sqlite_t* database = (jumanji_db_sqlite_t*) data;
+
+  if (database == NULL || database->session == NULL) {
     return;
   }
 
-  /* add to database */
-  static const char SQL_QUICKMARK_ADD[] =
-    "REPLACE INTO quickmarks (identifier, url) VALUES (?, ?)";
+  /* a batch is written in a single transaction, the write lock is taken
+   * up front so that the transaction can not fail half way */
+  if (sqlite3_exec(database->session, "BEGIN IMMEDIATE;", NULL, 0, NULL) != SQLITE_OK) {
+    girara_error("Could not begin transaction");
+  }
+}
 
-  sqlite3_stmt* statement = jumanji_db_prepare_statement(database->session,
-      SQL_QUICKMARK_ADD);
+static void
+jumanji_db_sqlite_commit(void* data)
+{
+  jumanji_db_sqlite_t* database = (jumanji_db_sqlite_t*) data;
 
-  if (statement == NULL) {
+  if (database == NULL || database->session == NULL) {
     return;
   }
 
-  if (sqlite3_bind_blob(statement, 1, &identifier, 1, NULL) != SQLITE_OK ||
-      sqlite3_bind_text(statement, 2, url,        -1, NULL) != SQLITE_OK
-      ) {
-    girara_error("Could not bind query parameters");
-    sqlite3_finalize(statement);
+  if (sqlite3_get_autocommit(database->session) != 0) {
     return;
   }
 
-  sqlite3_step(statement);
-  sqlite3_finalize(statement);
+  if (sqlite3_exec(database->session, "COMMIT;", NULL, 0, NULL) != SQLITE_OK) {
+    girara_error("Could not commit transaction");
+    sqlite3_exec(database->session, "ROLLBACK;", NULL, 0, NULL);
+
+    /* the mirror already contains the mutations of the batch */
+    jumanji_db_sqlite_load_marks(database);
+  }
 }
 
-char*
-jumanji_db_quickmark_find(jumanji_database_t* database, const char identifier)
+static sqlite3_stmt*
+jumanji_db_prepare_statement(sqlite3* session, const char* statement)
 {
-  if (database == NULL || database->session == NULL) {
+  if (session == NULL || statement == NULL) {
     return NULL;
   }
 
-  /* prepare statement */
-  static const char SQL_QUICKMARKS_FIND[] =
-    "SELECT url FROM quickmarks WHERE identifier = ?;";
-
-  sqlite3_stmt* statement =
-    jumanji_db_prepare_statement(database->session, SQL_QUICKMARKS_FIND);
+  const char* pz_tail   = NULL;
+  sqlite3_stmt* pp_stmt = NULL;
 
-  if (statement == NULL) {
-    return NULL;
+  if (sqlite3_prepare_v2(session, statement, -1, &pp_stmt, &pz_tail) != SQLITE_OK) {
+    girara_error("Failed to prepare query: %s", statement);
+    goto error_free;
+  } else if (pz_tail && *pz_tail != '\0') {
+    girara_error("Unused portion of statement: %s", pz_tail);
+    goto error_free;
   }
 
-  /* bind values */
-  if (sqlite3_bind_blob(statement, 1, &identifier, 1, NULL) != SQLITE_OK) {
-    girara_error("Could not bind query parameters");
-    sqlite3_finalize(statement);
-    return NULL;
-  }
+  return pp_stmt;
 
-  char* url = NULL;
-  while(sqlite3_step(statement) == SQLITE_ROW) {
-    url = (char*) sqlite3_column_text(statement, 0);
-    break;
-  }
+error_free:
 
-  sqlite3_finalize(statement);
+  if (pp_stmt != NULL) {
+    sqlite3_finalize(pp_stmt);
+  }
+
+  return NULL;
+}
+
+static sqlite3_stmt*
+jumanji_db_sqlite_statement(jumanji_db_sqlite_t* database, unsigned int index)
+{
+  sqlite3_stmt* statement = database->statements[index];
+
+  /* drop the bindings of the previous call */
+  sqlite3_reset(statement);
+  sqlite3_clear_bindings(statement);
+
+  return statement;
+}
+
+static void
+jumanji_db_sqlite_bookmark_match(void* data, const char* input, unsigned int
+    limit, jumanji_db_link_function_t function, void* function_data)
+{
+  jumanji_db_sqlite_t* database = (jumanji_db_sqlite_t*) data;
+
+  if (database == NULL || database->session == NULL || input == NULL ||
+      function == NULL) {
+    return;
+  }
+
+  jumanji_db_sqlite_match(database, STATEMENT_BOOKMARK_FIND,
+      STATEMENT_BOOKMARK_SEARCH, input, limit, function, function_data);
+}
+
+static void
+jumanji_db_sqlite_bookmark_remove(void* data, const char* url)
+{
+  jumanji_db_sqlite_t* database = (jumanji_db_sqlite_t*) data;
+
+  if (database == NULL || database->session == NULL || url == NULL) {
+    return;
+  }
+
+  sqlite3_stmt* statement = jumanji_db_sqlite_statement(database,
+      STATEMENT_BOOKMARK_REMOVE);
+
+  /* bind values */
+  if (sqlite3_bind_text(statement, 1, url, -1, NULL) != SQLITE_OK) {
+    girara_error("Could not bind query parameters");
+    return;
+  }
+
+  if (sqlite3_step(statement) == SQLITE_DONE) {
+    g_hash_table_remove(database->bookmarks, url);
+  }
+
+  sqlite3_reset(statement);
+}
+
+static void
+jumanji_db_sqlite_bookmark_add(void* data, const char* url, const char* title)
+{
+  jumanji_db_sqlite_t* database = (jumanji_db_sqlite_t*) data;
+
+  if (database == NULL || database->session == NULL || url == NULL || title ==
+      NULL) {
+    return;
+  }
+
+  sqlite3_stmt* statement = jumanji_db_sqlite_statement(database,
+      STATEMENT_BOOKMARK_ADD);
+
+  /* bind values */
+  if (sqlite3_bind_text(statement, 1, url,   -1, NULL) != SQLITE_OK ||
+      sqlite3_bind_text(statement, 2, title, -1, NULL) != SQLITE_OK
+      ) {
+    girara_error("Could not bind query parameters");
+    return;
+  }
+
+  if (sqlite3_step(statement) == SQLITE_DONE) {
+    g_hash_table_replace(database->bookmarks, g_strdup(url), g_strdup(title));
+  }
 
-  return url;
+  sqlite3_reset(statement);
 }
 
-void
-jumanji_db_quickmark_remove(jumanji_database_t* database, const char identifier)
+static bool
+jumanji_db_sqlite_bookmark_exists(void* data, const char* url)
 {
+  jumanji_db_sqlite_t* database = (jumanji_db_sqlite_t*) data;
+
+  if (database == NULL || database->session == NULL || url == NULL) {
+    return false;
+  }
+
+  jumanji_db_sqlite_sync_marks(database);
+
+  return g_hash_table_contains(database->bookmarks, url) == TRUE;
+}
+
+static void
+jumanji_db_sqlite_history_match(void* data, const char* input, unsigned int
+    limit, jumanji_db_link_function_t function, void* function_data)
+{
+  jumanji_db_sqlite_t* database = (jumanji_db_sqlite_t*) data;
+
+  if (database == NULL || database->session == NULL || input == NULL ||
+      function == NULL) {
+    return;
+  }
+
+  jumanji_db_sqlite_match(database, STATEMENT_HISTORY_FIND,
+      STATEMENT_HISTORY_SEARCH, input, limit, function, function_data);
+}
+
+static void
+jumanji_db_sqlite_bookmark_foreach(void* data, jumanji_db_link_function_t
+    function, void* function_data)
+{
+  jumanji_db_sqlite_t* database = (jumanji_db_sqlite_t*) data;
+
+  if (database == NULL || database->session == NULL || function == NULL) {
+    return;
+  }
+
+  jumanji_db_sqlite_sync_marks(database);
+
+  GHashTableIter iter;
+  gpointer url   = NULL;
+  gpointer title = NULL;
+
+  g_hash_table_iter_init(&iter, database->bookmarks);
+  while (g_hash_table_iter_next(&iter, &url, &title) == TRUE) {
+    if (function(url, title, 0, function_data) == false) {
+      return;
+    }
+  }
+}
+
+static void
+jumanji_db_sqlite_history_foreach(void* data, jumanji_db_link_function_t
+    function, void* function_data)
+{
+  jumanji_db_sqlite_t* database = (jumanji_db_sqlite_t*) data;
+
+  if (database == NULL || database->session == NULL || function == NULL) {
+    return;
+  }
+
+  sqlite3_stmt* statement = jumanji_db_sqlite_statement(database,
+      STATEMENT_HISTORY_ALL);
+
+  /* the column texts stay valid until the next step */
+  while (sqlite3_step(statement) == SQLITE_ROW) {
+    const char* url   = (const char*) sqlite3_column_text(statement, 0);
+    const char* title = (const char*) sqlite3_column_text(statement, 1);
+
+    if (url != NULL && function(url, title, sqlite3_column_int(statement, 2),
+          function_data) == false) {
+      break;
+    }
+  }
+
+  /* release the read lock of the statement */
+  sqlite3_reset(statement);
+}
+
+static void
+jumanji_db_sqlite_history_add(void* data, const char* url, const char* title,
+    int visited)
+{
+  jumanji_db_sqlite_t* database = (jumanji_db_sqlite_t*) data;
+
+  if (database == NULL || database->session == NULL || url == NULL || title == NULL) {
+    return;
+  }
+
+  sqlite3_stmt* statement = jumanji_db_sqlite_statement(database,
+      STATEMENT_HISTORY_ADD);
+
+  if (sqlite3_bind_text(statement, 1, url,   -1, NULL) != SQLITE_OK ||
+      sqlite3_bind_text(statement, 2, title, -1, NULL) != SQLITE_OK ||
+      sqlite3_bind_int( statement, 3, visited)         != SQLITE_OK
+      ) {
+    girara_error("Could not bind query parameters");
+    return;
+  }
+
+  sqlite3_step(statement);
+  sqlite3_reset(statement);
+}
+
+static void
+jumanji_db_sqlite_history_clean(void* data, unsigned int age)
+{
+  jumanji_db_sqlite_t* database = (jumanji_db_sqlite_t*) data;
+
   if (database == NULL || database->session == NULL) {
     return;
   }
 
-  /* prepare statement */
-  static const char SQL_QUICKMARK_ADD[] =
-    "DELETE FROM quickmarks WHERE identifier = ?;";
+  sqlite3_stmt* statement = jumanji_db_sqlite_statement(database,
+      STATEMENT_HISTORY_CLEAN);
 
-  sqlite3_stmt* statement = jumanji_db_prepare_statement(database->session,
-      SQL_QUICKMARK_ADD);
+  /* bind values */
+  int visited = time(NULL) - age;
+  if (sqlite3_bind_int(statement, 1, visited) != SQLITE_OK) {
+    girara_error("Could not bind query parameters");
+    return;
+  }
+
+  sqlite3_step(statement);
+  sqlite3_reset(statement);
+}
+
+static bool
+jumanji_db_sqlite_history_expire(void* data, unsigned int age, unsigned int
+    size, unsigned int limit, unsigned int* expired)
+{
+  jumanji_db_sqlite_t* database = (jumanji_db_sqlite_t*) data;
+
+  *expired = 0;
+
+  if (database == NULL || database->session == NULL || limit == 0) {
+    return false;
+  }
+
+  unsigned int removed = 0;
+
+  jumanji_db_sqlite_begin(database);
+
+  if (age > 0) {
+    sqlite3_stmt* statement = jumanji_db_sqlite_statement(database,
+        STATEMENT_HISTORY_EXPIRE_AGE);
+
+    if (sqlite3_bind_int(statement, 1, time(NULL) - age) == SQLITE_OK &&
+        sqlite3_bind_int(statement, 2, limit)            == SQLITE_OK &&
+        sqlite3_step(statement) == SQLITE_DONE) {
+      removed += sqlite3_changes(database->session);
+    }
+
+    sqlite3_reset(statement);
+  }
+
+  if (size > 0 && removed < limit) {
+    sqlite3_stmt* statement = jumanji_db_sqlite_statement(database,
+        STATEMENT_HISTORY_EXPIRE_SIZE);
+
+    if (sqlite3_bind_int(statement, 1, size)            == SQLITE_OK &&
+        sqlite3_bind_int(statement, 2, limit - removed) == SQLITE_OK &&
+        sqlite3_step(statement) == SQLITE_DONE) {
+      removed += sqlite3_changes(database->session);
+    }
+
+    sqlite3_reset(statement);
+  }
+
+  jumanji_db_sqlite_commit(database);
+
+  *expired = removed;
+  if (removed > 0) {
+    database->merge = database->search;
+  }
+
+  /* a full chunk may have left more expired entries */
+  if (removed == limit) {
+    return true;
+  }
+
+  /* the merge frees the pages of the expired index entries */
+  if (database->merge == true) {
+    if (jumanji_db_sqlite_merge(database) == true) {
+      return true;
+    }
+
+    database->merge = false;
+  }
+
+  return jumanji_db_sqlite_vacuum(database);
+}
+
+static int
+jumanji_db_sqlite_pragma(jumanji_db_sqlite_t* database, const char* name)
+{
+  char* sql = g_strdup_printf("PRAGMA %s;", name);
+  sqlite3_stmt* statement = jumanji_db_prepare_statement(database->session, sql);
+  g_free(sql);
 
   if (statement == NULL) {
+    return -1;
+  }
+
+  int value = sqlite3_step(statement) == SQLITE_ROW ?
+    sqlite3_column_int(statement, 0) : -1;
+  sqlite3_finalize(statement);
+
+  return value;
+}
+
+/*
+ * Deleted rows only leave markers in the full text index, which are dropped
+ * once its segments are merged into one. Returns true if the merge has not
+ * finished yet.
+ */
+static bool
+jumanji_db_sqlite_merge(jumanji_db_sqlite_t* database)
+{
+  int changes = sqlite3_total_changes(database->session);
+
+  char* sql = g_strdup_printf("INSERT INTO history_search (history_search, "
+      "rank) VALUES ('merge', -%d);", MERGE_PAGES);
+  bool result = sqlite3_exec(database->session, sql, NULL, 0, NULL) ==
+    SQLITE_OK;
+  g_free(sql);
+
+  /* a merge without work left changes less than two rows */
+  return result == true && sqlite3_total_changes(database->session) - changes
+    >= 2;
+}
+
+/*
+ * Returns free pages to the file system, true if more remain. Databases that
+ * were created without incremental auto_vacuum keep their free pages for new
+ * rows instead, converting them would need a VACUUM that renumbers the rows
+ * the full text indices refer to.
+ */
+static bool
+jumanji_db_sqlite_vacuum(jumanji_db_sqlite_t* database)
+{
+  if (database->incremental == false) {
+    return false;
+  }
+
+  int free_pages = jumanji_db_sqlite_pragma(database, "freelist_count");
+  if (free_pages <= 0) {
+    return false;
+  }
+
+  char* sql = g_strdup_printf("PRAGMA incremental_vacuum(%d);", VACUUM_PAGES);
+  bool result = sqlite3_exec(database->session, sql, NULL, 0, NULL) ==
+    SQLITE_OK;
+  g_free(sql);
+
+  return result == true && free_pages > VACUUM_PAGES;
+}
+
+static void
+jumanji_db_sqlite_quickmark_add(void* data, const char identifier, const char* url)
+{
+  jumanji_db_sqlite_t* database = (jumanji_db_sqlite_t*) data;
+
+  if (database == NULL || database->session == NULL || url == NULL) {
+    return;
+  }
+
+  sqlite3_stmt* statement = jumanji_db_sqlite_statement(database,
+      STATEMENT_QUICKMARK_ADD);
+
+  if (sqlite3_bind_blob(statement, 1, &identifier, 1, SQLITE_TRANSIENT) != SQLITE_OK ||
+      sqlite3_bind_text(statement, 2, url,        -1, NULL) != SQLITE_OK
+      ) {
+    girara_error("Could not bind query parameters");
+    return;
+  }
+
+  if (sqlite3_step(statement) == SQLITE_DONE) {
+    g_free(database->quickmarks[(unsigned char) identifier]);
+    database->quickmarks[(unsigned char) identifier] = g_strdup(url);
+  }
+
+  sqlite3_reset(statement);
+}
+
+static char*
+jumanji_db_sqlite_quickmark_find(void* data, const char identifier)
+{
+  jumanji_db_sqlite_t* database = (jumanji_db_sqlite_t*) data;
+
+  if (database == NULL || database->session == NULL) {
+    return NULL;
+  }
+
+  jumanji_db_sqlite_sync_marks(database);
+
+  return g_strdup(database->quickmarks[(unsigned char) identifier]);
+}
+
+static void
+jumanji_db_sqlite_quickmark_remove(void* data, const char identifier)
+{
+  jumanji_db_sqlite_t* database = (jumanji_db_sqlite_t*) data;
+
+  if (database == NULL || database->session == NULL) {
     return;
   }
 
+  sqlite3_stmt* statement = jumanji_db_sqlite_statement(database,
+      STATEMENT_QUICKMARK_REMOVE);
+
+  /* bind values */
+  if (sqlite3_bind_blob(statement, 1, &identifier, 1, SQLITE_TRANSIENT) != SQLITE_OK) {
+    girara_error("Could not bind query parameters");
+    return;
+  }
+
+  if (sqlite3_step(statement) == SQLITE_DONE) {
+    g_free(database->quickmarks[(unsigned char) identifier]);
+    database->quickmarks[(unsigned char) identifier] = NULL;
+  }
+
+  sqlite3_reset(statement);
+}
+
+static void
+jumanji_db_sqlite_load_marks(jumanji_db_sqlite_t* database)
+{
+  g_hash_table_remove_all(database->bookmarks);
+
+  for (unsigned int i = 0; i <= G_MAXUINT8; i++) {
+    g_free(database->quickmarks[i]);
+    database->quickmarks[i] = NULL;
+  }
+
+  sqlite3_stmt* statement = jumanji_db_sqlite_statement(database,
+      STATEMENT_BOOKMARK_ALL);
+
+  while (sqlite3_step(statement) == SQLITE_ROW) {
+    const char* url   = (const char*) sqlite3_column_text(statement, 0);
+    const char* title = (const char*) sqlite3_column_text(statement, 1);
+
+    if (url != NULL) {
+      g_hash_table_replace(database->bookmarks, g_strdup(url), g_strdup(title));
+    }
+  }
+
+  sqlite3_reset(statement);
+
+  statement = jumanji_db_sqlite_statement(database, STATEMENT_QUICKMARK_ALL);
+
+  while (sqlite3_step(statement) == SQLITE_ROW) {
+    const unsigned char* identifier = sqlite3_column_blob(statement, 0);
+    const char* url = (const char*) sqlite3_column_text(statement, 1);
+
+    if (identifier != NULL && sqlite3_column_bytes(statement, 0) == 1 && url !=
+        NULL) {
+      g_free(database->quickmarks[identifier[0]]);
+      database->quickmarks[identifier[0]] = g_strdup(url);
+    }
+  }
+
+  sqlite3_reset(statement);
+
+  statement = jumanji_db_sqlite_statement(database, STATEMENT_DATA_VERSION);
+  if (sqlite3_step(statement) == SQLITE_ROW) {
+    database->data_version = sqlite3_column_int(statement, 0);
+  }
+
+  sqlite3_reset(statement);
+}
+
+static void
+jumanji_db_sqlite_sync_marks(jumanji_db_sqlite_t* database)
+{
+  /* the version only changes when another connection commits */
+  sqlite3_stmt* statement = jumanji_db_sqlite_statement(database,
+      STATEMENT_DATA_VERSION);
+
+  bool changed = sqlite3_step(statement) == SQLITE_ROW &&
+    sqlite3_column_int(statement, 0) != database->data_version;
+
+  sqlite3_reset(statement);
+
+  if (changed == true) {
+    jumanji_db_sqlite_load_marks(database);
+  }
+}
+
+static void
+jumanji_db_sqlite_match(jumanji_db_sqlite_t* database, unsigned int find,
+    unsigned int search, const char* input, unsigned int limit,
+    jumanji_db_link_function_t function, void* data)
+{
+  /* the trigram index can only match inputs of at least three characters */
+  unsigned int index = find;
+  if (database->search == true && g_utf8_strlen(input, -1) >= SEARCH_MIN_LENGTH) {
+    index = search;
+  }
+
+  sqlite3_stmt* statement = jumanji_db_sqlite_statement(database, index);
+
+  /* a negative limit returns all rows */
+  int rows = (limit == 0 || limit > G_MAXINT) ? -1 : (int) limit;
+
   /* bind values */
-  if (sqlite3_bind_blob(statement, 1, &identifier, 1, NULL) != SQLITE_OK) {
+  if (sqlite3_bind_text(statement, 1, input, -1, NULL) != SQLITE_OK ||
+      sqlite3_bind_int( statement, 2, rows)            != SQLITE_OK
+      ) {
+    girara_error("Could not bind query parameters");
+    return;
+  }
+
+  /* the column texts stay valid until the next step */
+  while (sqlite3_step(statement) == SQLITE_ROW) {
+    const char* url   = (const char*) sqlite3_column_text(statement, 0);
+    const char* title = (const char*) sqlite3_column_text(statement, 1);
+
+    if (function(url, title, sqlite3_column_int(statement, 2), data) == false) {
+      break;
+    }
+  }
+
+  /* release the read lock of the statement */
+  sqlite3_reset(statement);
+}
+
+static void
+jumanji_db_sqlite_save_session(void* data, const char* name, girara_list_t* urls)
+{
+  jumanji_db_sqlite_t* database = (jumanji_db_sqlite_t*) data;
+
+  if (database == NULL || database->session == NULL || name == NULL || urls ==
+      NULL) {
+    return;
+  }
+
+  GPtrArray* links = g_ptr_array_new();
+  if (girara_list_size(urls) > 0) {
+    girara_list_iterator_t* iter = girara_list_iterator(urls);
+    do {
+      jumanji_db_result_link_t* link = girara_list_iterator_data(iter);
+      if (link != NULL && link->url != NULL) {
+        g_ptr_array_add(links, link);
+      }
+    } while (girara_list_iterator_next(iter) != NULL);
+    girara_list_iterator_free(iter);
+  }
+
+  /* the session is changed as a whole or not at all */
+  sqlite3_exec(database->session, "SAVEPOINT session;", NULL, 0, NULL);
+
+  sqlite3_int64 session = jumanji_db_sqlite_session_id(database, name, true);
+  if (session != 0 && jumanji_db_sqlite_session_update(database, session,
+        links) == false) {
+    /* positions ran out of precision, number them again */
+    sqlite3_exec(database->session, "ROLLBACK TO session;", NULL, 0, NULL);
+    jumanji_db_sqlite_session_write(database, session, links);
+  }
+
+  sqlite3_exec(database->session, "RELEASE session;", NULL, 0, NULL);
+
+  g_ptr_array_free(links, TRUE);
+}
+
+static girara_list_t*
+jumanji_db_sqlite_load_session(void* data, const char* name)
+{
+  jumanji_db_sqlite_t* database = (jumanji_db_sqlite_t*) data;
+
+  if (database == NULL || database->session == NULL || name == NULL) {
+    return NULL;
+  }
+
+  sqlite3_int64 session = jumanji_db_sqlite_session_id(database, name, false);
+  if (session == 0) {
+    return NULL;
+  }
+
+  girara_list_t* results = girara_list_new2(jumanji_db_free_result_link);
+  if (results == NULL) {
+    return NULL;
+  }
+
+  GArray* tabs = jumanji_db_sqlite_session_tabs(database, session);
+  for (unsigned int i = 0; i < tabs->len; i++) {
+    jumanji_db_sqlite_tab_t* tab = &g_array_index(tabs, jumanji_db_sqlite_tab_t, i);
+
+    jumanji_db_result_link_t* link = malloc(sizeof(jumanji_db_result_link_t));
+    if (link == NULL) {
+      break;
+    }
+
+    link->url     = g_strdup(tab->url);
+    link->title   = g_strdup(tab->title);
+    link->visited = 0;
+
+    girara_list_append(results, link);
+  }
+
+  g_array_free(tabs, TRUE);
+
+  return results;
+}
+
+static sqlite3_int64
+jumanji_db_sqlite_session_id(jumanji_db_sqlite_t* database, const char* name,
+    bool create)
+{
+  sqlite3_stmt* statement = NULL;
+
+  if (create == true) {
+    statement = jumanji_db_sqlite_statement(database, STATEMENT_SESSION_ADD);
+    if (sqlite3_bind_text(statement, 1, name, -1, NULL) != SQLITE_OK) {
+      girara_error("Could not bind query parameters");
+      return 0;
+    }
+
+    sqlite3_step(statement);
+    sqlite3_reset(statement);
+  }
+
+  statement = jumanji_db_sqlite_statement(database, STATEMENT_SESSION_FIND);
+  if (sqlite3_bind_text(statement, 1, name, -1, NULL) != SQLITE_OK) {
+    girara_error("Could not bind query parameters");
+    return 0;
+  }
+
+  sqlite3_int64 session = 0;
+  if (sqlite3_step(statement) == SQLITE_ROW) {
+    session = sqlite3_column_int64(statement, 0);
+  }
+
+  sqlite3_reset(statement);
+
+  return session;
+}
+
+static GArray*
+jumanji_db_sqlite_session_tabs(jumanji_db_sqlite_t* database, sqlite3_int64
+    session)
+{
+  GArray* tabs = g_array_new(FALSE, FALSE, sizeof(jumanji_db_sqlite_tab_t));
+  g_array_set_clear_func(tabs, jumanji_db_sqlite_tab_clear);
+
+  sqlite3_stmt* statement = jumanji_db_sqlite_statement(database,
+      STATEMENT_SESSION_TABS);
+
+  if (sqlite3_bind_int64(statement, 1, session) != SQLITE_OK) {
+    girara_error("Could not bind query parameters");
+    return tabs;
+  }
+
+  while (sqlite3_step(statement) == SQLITE_ROW) {
+    jumanji_db_sqlite_tab_t tab = {
+      .id       = sqlite3_column_int64(statement, 0),
+      .position = sqlite3_column_double(statement, 1),
+      .url      = g_strdup((const char*) sqlite3_column_text(statement, 2)),
+      .title    = g_strdup((const char*) sqlite3_column_text(statement, 3))
+    };
+
+    g_array_append_val(tabs, tab);
+  }
+
+  sqlite3_reset(statement);
+
+  return tabs;
+}
+
+/*
+ * Stored tabs are matched with the new links by url. The longest run of
+ * matches that is still in order stays untouched, the stored tabs between
+ * two of them are reused for the new links in the same gap and only the
+ * remainder is inserted or removed. Navigating, opening or closing a tab
+ * since the last save therefore writes a single row.
+ */
+static bool
+jumanji_db_sqlite_session_update(jumanji_db_sqlite_t* database, sqlite3_int64
+    session, GPtrArray* links)
+{
+  GArray* tabs = jumanji_db_sqlite_session_tabs(database, session);
+  bool result  = true;
+
+  /* match each link with the first unused stored tab with the same url */
+  GHashTable* unused = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+      (GDestroyNotify) g_queue_free);
+
+  for (unsigned int i = 0; i < tabs->len; i++) {
+    jumanji_db_sqlite_tab_t* tab = &g_array_index(tabs, jumanji_db_sqlite_tab_t, i);
+    if (tab->url == NULL) {
+      continue;
+    }
+
+    GQueue* queue = g_hash_table_lookup(unused, tab->url);
+    if (queue == NULL) {
+      queue = g_queue_new();
+      g_hash_table_insert(unused, tab->url, queue);
+    }
+    g_queue_push_tail(queue, GUINT_TO_POINTER(i));
+  }
+
+  int* match = g_new(int, links->len);
+  for (unsigned int i = 0; i < links->len; i++) {
+    jumanji_db_result_link_t* link = g_ptr_array_index(links, i);
+    GQueue* queue = g_hash_table_lookup(unused, link->url);
+
+    match[i] = (queue != NULL && g_queue_is_empty(queue) == FALSE) ?
+      (int) GPOINTER_TO_UINT(g_queue_pop_head(queue)) : -1;
+  }
+
+  g_hash_table_destroy(unused);
+
+  /* longest increasing subsequence of the matched tabs */
+  int* tails    = g_new(int, links->len + 1);
+  int* previous = g_new(int, links->len + 1);
+  int length    = 0;
+
+  for (unsigned int i = 0; i < links->len; i++) {
+    if (match[i] < 0) {
+      continue;
+    }
+
+    int low = 0, high = length;
+    while (low < high) {
+      int middle = (low + high) / 2;
+      if (match[tails[middle]] < match[i]) {
+        low = middle + 1;
+      } else {
+        high = middle;
+      }
+    }
+
+    previous[i] = (low > 0) ? tails[low - 1] : -1;
+    tails[low]  = i;
+    if (low == length) {
+      length++;
+    }
+  }
+
+  bool* keep = g_new0(bool, links->len + 1);
+  for (int i = (length > 0) ? tails[length - 1] : -1; i >= 0; i = previous[i]) {
+    keep[i] = true;
+  }
+
+  g_free(tails);
+  g_free(previous);
+
+  /* walk the gaps between the kept tabs */
+  unsigned int tab = 0;
+  double lower     = 0;
+
+  for (unsigned int i = 0; i <= links->len; i++) {
+    unsigned int next = i;
+    while (next < links->len && keep[next] == false) {
+      next++;
+    }
+
+    unsigned int end = (next < links->len) ? (unsigned int) match[next] : tabs->len;
+    double upper     = (next < links->len) ?
+      g_array_index(tabs, jumanji_db_sqlite_tab_t, end).position : INFINITY;
+
+    for (; i < next; i++) {
+      jumanji_db_result_link_t* link = g_ptr_array_index(links, i);
+
+      if (tab < end) {
+        jumanji_db_sqlite_tab_t* stored = &g_array_index(tabs,
+            jumanji_db_sqlite_tab_t, tab++);
+
+        sqlite3_stmt* statement = jumanji_db_sqlite_statement(database,
+            STATEMENT_TAB_UPDATE);
+
+        if (sqlite3_bind_text( statement, 1, link->url,   -1, NULL) != SQLITE_OK ||
+            sqlite3_bind_text( statement, 2, link->title, -1, NULL) != SQLITE_OK ||
+            sqlite3_bind_int64(statement, 3, stored->id)          != SQLITE_OK
+           ) {
+          girara_error("Could not bind query parameters");
+          continue;
+        }
+
+        sqlite3_step(statement);
+        sqlite3_reset(statement);
+
+        lower = stored->position;
+      } else {
+        double position = isinf(upper) ? lower + 1 : (lower + upper) / 2;
+        if (position <= lower || position >= upper) {
+          result = false;
+          goto error_free;
+        }
+
+        jumanji_db_sqlite_tab_add(database, session, position, link);
+        lower = position;
+      }
+    }
+
+    /* stored tabs left in the gap were closed */
+    for (; tab < end; tab++) {
+      sqlite3_stmt* statement = jumanji_db_sqlite_statement(database,
+          STATEMENT_TAB_REMOVE);
+
+      if (sqlite3_bind_int64(statement, 1, g_array_index(tabs,
+              jumanji_db_sqlite_tab_t, tab).id) != SQLITE_OK) {
+        girara_error("Could not bind query parameters");
+        continue;
+      }
+
+      sqlite3_step(statement);
+      sqlite3_reset(statement);
+    }
+
+    tab   = end + 1;
+    lower = upper;
+  }
+
+error_free:
+
+  g_free(keep);
+  g_free(match);
+  g_array_free(tabs, TRUE);
+
+  return result;
+}
+
+static void
+jumanji_db_sqlite_session_write(jumanji_db_sqlite_t* database, sqlite3_int64
+    session, GPtrArray* links)
+{
+  sqlite3_stmt* statement = jumanji_db_sqlite_statement(database,
+      STATEMENT_SESSION_CLEAR);
+
+  if (sqlite3_bind_int64(statement, 1, session) != SQLITE_OK) {
     girara_error("Could not bind query parameters");
-    sqlite3_finalize(statement);
     return;
   }
 
   sqlite3_step(statement);
-  sqlite3_finalize(statement);
+  sqlite3_reset(statement);
+
+  for (unsigned int i = 0; i < links->len; i++) {
+    jumanji_db_sqlite_tab_add(database, session, i + 1, g_ptr_array_index(links, i));
+  }
 }
 
-void
-jumanji_db_save_session(jumanji_database_t* database, const char* name, girara_list_t* urls)
+static void
+jumanji_db_sqlite_tab_add(jumanji_db_sqlite_t* database, sqlite3_int64 session,
+    double position, jumanji_db_result_link_t* link)
 {
-  return;
+  sqlite3_stmt* statement = jumanji_db_sqlite_statement(database,
+      STATEMENT_TAB_ADD);
+
+  if (sqlite3_bind_int64( statement, 1, session)           != SQLITE_OK ||
+      sqlite3_bind_double(statement, 2, position)          != SQLITE_OK ||
+      sqlite3_bind_text(  statement, 3, link->url,   -1, NULL) != SQLITE_OK ||
+      sqlite3_bind_text(  statement, 4, link->title, -1, NULL) != SQLITE_OK
+     ) {
+    girara_error("Could not bind query parameters");
+    return;
+  }
+
+  sqlite3_step(statement);
+  sqlite3_reset(statement);
 }
 
-girara_list_t*
-jumanji_db_load_session(jumanji_database_t* database, const char* name)
+static void
+jumanji_db_sqlite_tab_clear(void* data)
 {
-  return NULL;
+  jumanji_db_sqlite_tab_t* tab = (jumanji_db_sqlite_tab_t*) data;
+
+  g_free(tab->url);
+  g_free(tab->title);
 }
+
+static char*
+jumanji_db_sqlite_table_sql(const char* sql, const char* table)
+{
+  gchar** parts = g_strsplit(sql, "$table", -1);
+  char* result  = g_strjoinv(table, parts);
+  g_strfreev(parts);
+
+  return result;
+}
+
+static bool
+jumanji_db_sqlite_import(void* data, const char* dir)
+{
+  jumanji_db_sqlite_t* database = (jumanji_db_sqlite_t*) data;
+
+  if (database == NULL || database->session == NULL || dir == NULL) {
+    return false;
+  }
+
+  const jumanji_db_backend_t* backend = &jumanji_db_plain_backend;
+  if (backend->check_location(dir) == false) {
+    return false;
+  }
+
+  /* reading through the backend also covers its journals and segments, the
+   * files are left as they are */
+  void* plain = jumanji_db_plain_open(dir);
+  if (plain == NULL) {
+    return false;
+  }
+
+  jumanji_db_sqlite_begin(database);
+
+  /* indices are built once after all rows are in instead of per row */
+  sqlite3_exec(database->session, "DROP INDEX IF EXISTS history_frecency;",
+      NULL, 0, NULL);
+
+  /* the full text indices are filled again by the idle steps */
+  char* sql = jumanji_db_sqlite_table_sql(SQL_SEARCH_DROP, "bookmarks");
+  sqlite3_exec(database->session, sql, NULL, 0, NULL);
+  g_free(sql);
+
+  sql = jumanji_db_sqlite_table_sql(SQL_SEARCH_DROP, "history");
+  sqlite3_exec(database->session, sql, NULL, 0, NULL);
+  g_free(sql);
+
+  sqlite3_finalize(database->statements[STATEMENT_BOOKMARK_SEARCH]);
+  sqlite3_finalize(database->statements[STATEMENT_HISTORY_SEARCH]);
+  database->statements[STATEMENT_BOOKMARK_SEARCH] = NULL;
+  database->statements[STATEMENT_HISTORY_SEARCH]  = NULL;
+
+  database->search         = false;
+  database->search_pending = true;
+
+  /* stream the links, history files may hold more than fits a list */
+  jumanji_db_sqlite_import_t bookmarks = { database, 0 };
+  jumanji_db_sqlite_import_t history   = { database, 0 };
+
+  backend->bookmark_foreach(plain, jumanji_db_sqlite_import_bookmark,
+      &bookmarks);
+  backend->history_foreach(plain, jumanji_db_sqlite_import_history, &history);
+
+  for (unsigned int identifier = 1; identifier <= G_MAXUINT8; identifier++) {
+    char* url = backend->quickmark_find(plain, (char) identifier);
+    if (url != NULL) {
+      jumanji_db_sqlite_quickmark_add(database, (char) identifier, url);
+      g_free(url);
+    }
+  }
+
+  jumanji_db_sqlite_import_sessions(database, plain, dir);
+
+  bool result = jumanji_db_sqlite_init_frecency(database);
+
+  jumanji_db_sqlite_commit(database);
+
+  girara_info("Imported %u bookmarks and %u history entries from %s",
+      bookmarks.count, history.count, dir);
+
+  backend->free(plain);
+
+  return result;
+}
+
+static bool
+jumanji_db_sqlite_import_bookmark(const char* url, const char* title, int
+    visited, void* data)
+{
+  (void) visited;
+
+  jumanji_db_sqlite_import_t* import = (jumanji_db_sqlite_import_t*) data;
+
+  jumanji_db_sqlite_bookmark_add(import->database, url, title != NULL ? title :
+      "");
+  import->count++;
+
+  return true;
+}
+
+static bool
+jumanji_db_sqlite_import_history(const char* url, const char* title, int
+    visited, void* data)
+{
+  jumanji_db_sqlite_import_t* import = (jumanji_db_sqlite_import_t*) data;
+
+  sqlite3_stmt* statement = jumanji_db_sqlite_statement(import->database,
+      STATEMENT_HISTORY_IMPORT);
+
+  if (sqlite3_bind_text(statement, 1, url, -1, NULL) != SQLITE_OK ||
+      sqlite3_bind_text(statement, 2, title != NULL ? title : "", -1, NULL) != SQLITE_OK ||
+      sqlite3_bind_int( statement, 3, visited) != SQLITE_OK
+      ) {
+    girara_error("Could not bind query parameters");
+    return true;
+  }
+
+  sqlite3_step(statement);
+  sqlite3_reset(statement);
+  import->count++;
+
+  return true;
+}
+
+static void
+jumanji_db_sqlite_import_sessions(jumanji_db_sqlite_t* database, void* plain,
+    const char* dir)
+{
+  char* session_dir = g_build_filename(dir, PLAIN_SESSION_DIR, NULL);
+  GDir* sessions    = g_dir_open(session_dir, 0, NULL);
+  g_free(session_dir);
+
+  if (sessions == NULL) {
+    return;
+  }
+
+  const char* name = NULL;
+  while ((name = g_dir_read_name(sessions)) != NULL) {
+    girara_list_t* urls = jumanji_db_plain_backend.load_session(plain, name);
+    if (urls != NULL) {
+      jumanji_db_sqlite_save_session(database, name, urls);
+      girara_list_free(urls);
+    }
+  }
+
+  g_dir_close(sessions);
+}
+
+const jumanji_db_backend_t jumanji_db_sqlite_backend = {
+  .name             = "sqlite",
+  .ignore_case      = true,
+  .init             = jumanji_db_sqlite_init,
+  .free             = jumanji_db_sqlite_free,
+  .check_location   = jumanji_db_sqlite_check_location,
+  .begin            = jumanji_db_sqlite_begin,
+  .commit           = jumanji_db_sqlite_commit,
+  .bookmark_add     = jumanji_db_sqlite_bookmark_add,
+  .bookmark_remove  = jumanji_db_sqlite_bookmark_remove,
+  .bookmark_match   = jumanji_db_sqlite_bookmark_match,
+  .bookmark_exists  = jumanji_db_sqlite_bookmark_exists,
+  .history_add      = jumanji_db_sqlite_history_add,
+  .history_clean    = jumanji_db_sqlite_history_clean,
+  .history_expire   = jumanji_db_sqlite_history_expire,
+  .history_match    = jumanji_db_sqlite_history_match,
+  .quickmark_add    = jumanji_db_sqlite_quickmark_add,
+  .quickmark_remove = jumanji_db_sqlite_quickmark_remove,
+  .quickmark_find   = jumanji_db_sqlite_quickmark_find,
+  .save_session     = jumanji_db_sqlite_save_session,
+  .load_session     = jumanji_db_sqlite_load_session,
+  .bookmark_foreach = jumanji_db_sqlite_bookmark_foreach,
+  .history_foreach  = jumanji_db_sqlite_history_foreach,
+  .import           = jumanji_db_sqlite_import,
+  .idle             = jumanji_db_sqlite_idle
+};
@@ -0,0 +1,603 @@
+/* See LICENSE file for license and copyright information */
+
+#include <girara/datastructures.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "database-table.h"
+
+/* size of the memory chunks of a store, larger strings get their own chunk */
+#define STORE_CHUNK_SIZE (64 * 1024)
+
+/* a store is repacked once it holds more unreferenced than referenced string
+ * bytes, but not before they reached this size */
+#define STORE_REPACK_MIN_SIZE (256 * 1024)
+
+/* forward declarations */
+static void jumanji_db_table_free_item(jumanji_db_table_t* table, void* item);
+static void jumanji_db_table_compact(jumanji_db_table_t* table);
+static void* jumanji_db_store_alloc(jumanji_db_store_t* store, gsize size);
+static char* jumanji_db_store_intern(jumanji_db_store_t* store, const char*
+    string);
+static void jumanji_db_store_release(jumanji_db_store_t* store, char* string);
+static void jumanji_db_store_release_link(jumanji_db_store_t* store,
+    jumanji_db_result_link_t* link);
+static void jumanji_db_table_index(jumanji_db_table_t* table, guint position);
+static void jumanji_db_table_drop_index(jumanji_db_table_t* table);
+static GArray* jumanji_db_table_search(jumanji_db_table_t* table, const char*
+    input);
+
+jumanji_db_table_t*
+jumanji_db_table_new(GHashFunc hash_function, GEqualFunc equal_function,
+    jumanji_db_table_key_function_t key_function, girara_free_function_t
+    free_function)
+{
+  jumanji_db_table_t* table = g_malloc0(sizeof(jumanji_db_table_t));
+  if (table == NULL) {
+    return NULL;
+  }
+
+  table->index         = g_hash_table_new(hash_function, equal_function);
+  table->order         = g_ptr_array_new();
+  table->key_function  = key_function;
+  table->free_function = free_function;
+
+  if (table->index == NULL || table->order == NULL) {
+    jumanji_db_table_free(table);
+    return NULL;
+  }
+
+  return table;
+}
+
+void
+jumanji_db_table_free(jumanji_db_table_t* table)
+{
+  if (table == NULL) {
+    return;
+  }
+
+  if (table->order != NULL) {
+    if (table->store == NULL) {
+      for (unsigned int i = 0; i < table->order->len; i++) {
+        jumanji_db_table_free_item(table, g_ptr_array_index(table->order, i));
+      }
+    } else {
+      g_ptr_array_remove(table->store->tables, table);
+    }
+    g_ptr_array_free(table->order, TRUE);
+  }
+
+  if (table->index != NULL) {
+    g_hash_table_destroy(table->index);
+  }
+
+  jumanji_db_table_drop_index(table);
+
+  g_free(table);
+}
+
+static void
+jumanji_db_table_free_item(jumanji_db_table_t* table, void* item)
+{
+  if (item == NULL) {
+    return;
+  }
+
+  if (table->store != NULL) {
+    jumanji_db_store_release_link(table->store, item);
+  } else if (table->free_function != NULL) {
+    table->free_function(item);
+  }
+}
+
+jumanji_db_store_t*
+jumanji_db_store_new(void)
+{
+  jumanji_db_store_t* store = g_malloc0(sizeof(jumanji_db_store_t));
+  if (store == NULL) {
+    return NULL;
+  }
+
+  store->chunks  = g_ptr_array_new_with_free_func(g_free);
+  store->strings = g_hash_table_new(g_str_hash, g_str_equal);
+  store->tables  = g_ptr_array_new();
+
+  return store;
+}
+
+void
+jumanji_db_store_free(jumanji_db_store_t* store)
+{
+  if (store == NULL) {
+    return;
+  }
+
+  g_ptr_array_free(store->chunks, TRUE);
+  g_hash_table_destroy(store->strings);
+  g_ptr_array_free(store->tables, TRUE);
+  g_free(store);
+}
+
+void
+jumanji_db_store_attach(jumanji_db_store_t* store, jumanji_db_table_t* table)
+{
+  table->store = store;
+  g_ptr_array_add(store->tables, table);
+}
+
+static void*
+jumanji_db_store_alloc(jumanji_db_store_t* store, gsize size)
+{
+  /* keep the links aligned, strings are allocated in the same chunks */
+  size = (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+
+  if (size > STORE_CHUNK_SIZE / 4) {
+    void* chunk = g_malloc(size);
+    g_ptr_array_add(store->chunks, chunk);
+    return chunk;
+  }
+
+  if (store->chunk == NULL || store->chunk_used + size > STORE_CHUNK_SIZE) {
+    store->chunk      = g_malloc(STORE_CHUNK_SIZE);
+    store->chunk_used = 0;
+    g_ptr_array_add(store->chunks, store->chunk);
+  }
+
+  void* memory = store->chunk + store->chunk_used;
+  store->chunk_used += size;
+
+  return memory;
+}
+
+static char*
+jumanji_db_store_intern(jumanji_db_store_t* store, const char* string)
+{
+  gpointer key   = NULL;
+  gpointer count = NULL;
+  if (g_hash_table_lookup_extended(store->strings, string, &key, &count) == TRUE) {
+    g_hash_table_insert(store->strings, key,
+        GUINT_TO_POINTER(GPOINTER_TO_UINT(count) + 1));
+    return key;
+  }
+
+  size_t size = strlen(string) + 1;
+  char* copy  = memcpy(jumanji_db_store_alloc(store, size), string, size);
+
+  g_hash_table_insert(store->strings, copy, GUINT_TO_POINTER(1));
+  store->string_size += size;
+
+  return copy;
+}
+
+static void
+jumanji_db_store_release(jumanji_db_store_t* store, char* string)
+{
+  if (string == NULL) {
+    return;
+  }
+
+  guint count = GPOINTER_TO_UINT(g_hash_table_lookup(store->strings, string));
+  if (count > 1) {
+    g_hash_table_insert(store->strings, string, GUINT_TO_POINTER(count - 1));
+    return;
+  }
+
+  /* the memory is reclaimed by the next repack */
+  g_hash_table_remove(store->strings, string);
+  store->dead_size += strlen(string) + 1;
+}
+
+static void
+jumanji_db_store_release_link(jumanji_db_store_t* store,
+    jumanji_db_result_link_t* link)
+{
+  jumanji_db_store_release(store, link->url);
+  jumanji_db_store_release(store, link->title);
+
+  *(jumanji_db_result_link_t**) link = store->free_links;
+  store->free_links = link;
+}
+
+void
+jumanji_db_store_repack(jumanji_db_store_t* store)
+{
+  if (store == NULL || store->dead_size < STORE_REPACK_MIN_SIZE ||
+      store->dead_size < store->string_size - store->dead_size) {
+    return;
+  }
+
+  GPtrArray* chunks   = store->chunks;
+  GHashTable* strings = store->strings;
+
+  store->chunks      = g_ptr_array_new_with_free_func(g_free);
+  store->strings     = g_hash_table_new(g_str_hash, g_str_equal);
+  store->chunk       = NULL;
+  store->free_links  = NULL;
+  store->string_size = 0;
+  store->dead_size   = 0;
+
+  /* copy the live links into new chunks, the positions stay the same */
+  for (unsigned int i = 0; i < store->tables->len; i++) {
+    jumanji_db_table_t* table = g_ptr_array_index(store->tables, i);
+
+    g_hash_table_remove_all(table->index);
+    for (unsigned int j = 0; j < table->order->len; j++) {
+      jumanji_db_result_link_t* link = g_ptr_array_index(table->order, j);
+      if (link == NULL) {
+        continue;
+      }
+
+      link = jumanji_db_link_new(store, link->url, link->title, link->visited);
+      g_ptr_array_index(table->order, j) = link;
+      g_hash_table_insert(table->index, (gpointer) table->key_function(link),
+          GUINT_TO_POINTER(j));
+    }
+  }
+
+  g_ptr_array_free(chunks, TRUE);
+  g_hash_table_destroy(strings);
+}
+
+void*
+jumanji_db_table_lookup(jumanji_db_table_t* table, const void* key)
+{
+  if (table == NULL) {
+    return NULL;
+  }
+
+  gpointer position = NULL;
+  if (g_hash_table_lookup_extended(table->index, key, NULL, &position) == FALSE) {
+    return NULL;
+  }
+
+  return g_ptr_array_index(table->order, GPOINTER_TO_UINT(position));
+}
+
+void
+jumanji_db_table_insert(jumanji_db_table_t* table, void* item)
+{
+  if (table == NULL || item == NULL) {
+    return;
+  }
+
+  const void* key = table->key_function(item);
+
+  /* replace an existing item with the same key */
+  gpointer position = NULL;
+  if (g_hash_table_lookup_extended(table->index, key, NULL, &position) == TRUE) {
+    void* old_item = g_ptr_array_index(table->order, GPOINTER_TO_UINT(position));
+    g_ptr_array_index(table->order, GPOINTER_TO_UINT(position)) = item;
+    /* the index does not copy keys, so point it to the key of the new item */
+    g_hash_table_replace(table->index, (gpointer) key, position);
+
+    jumanji_db_table_free_item(table, old_item);
+
+    /* trigrams of the old item stay, searches verify their candidates */
+    jumanji_db_table_index(table, GPOINTER_TO_UINT(position));
+    return;
+  }
+
+  g_hash_table_insert(table->index, (gpointer) key,
+      GUINT_TO_POINTER(table->order->len));
+  g_ptr_array_add(table->order, item);
+
+  jumanji_db_table_index(table, table->order->len - 1);
+}
+
+static void
+jumanji_db_table_compact(jumanji_db_table_t* table)
+{
+  unsigned int position = 0;
+
+  for (unsigned int i = 0; i < table->order->len; i++) {
+    void* item = g_ptr_array_index(table->order, i);
+    if (item == NULL) {
+      continue;
+    }
+
+    g_ptr_array_index(table->order, position) = item;
+    g_hash_table_insert(table->index, (gpointer) table->key_function(item),
+        GUINT_TO_POINTER(position));
+    position++;
+  }
+
+  g_ptr_array_set_size(table->order, position);
+  table->removed = 0;
+
+  /* the positions have changed, the next search rebuilds the index */
+  jumanji_db_table_drop_index(table);
+}
+
+bool
+jumanji_db_table_remove(jumanji_db_table_t* table, const void* key)
+{
+  if (table == NULL) {
+    return false;
+  }
+
+  gpointer position = NULL;
+  if (g_hash_table_lookup_extended(table->index, key, NULL, &position) == FALSE) {
+    return false;
+  }
+
+  void* item = g_ptr_array_index(table->order, GPOINTER_TO_UINT(position));
+  g_hash_table_remove(table->index, key);
+  g_ptr_array_index(table->order, GPOINTER_TO_UINT(position)) = NULL;
+
+  jumanji_db_table_free_item(table, item);
+
+  /* compact the order array once half of it is unused */
+  if (++table->removed > table->order->len / 2) {
+    jumanji_db_table_compact(table);
+  }
+
+  return true;
+}
+
+void
+jumanji_db_table_clear(jumanji_db_table_t* table)
+{
+  for (unsigned int i = 0; i < table->order->len; i++) {
+    jumanji_db_table_free_item(table, g_ptr_array_index(table->order, i));
+  }
+
+  g_ptr_array_set_size(table->order, 0);
+  g_hash_table_remove_all(table->index);
+  table->removed = 0;
+
+  jumanji_db_table_drop_index(table);
+}
+
+void
+jumanji_db_free_positions(gpointer data)
+{
+  g_array_free((GArray*) data, TRUE);
+}
+
+void
+jumanji_db_trigrams_add(GHashTable* trigrams, const char* text, guint position)
+{
+  if (text == NULL) {
+    return;
+  }
+
+  for (; text[0] != '\0' && text[1] != '\0' && text[2] != '\0'; text++) {
+    gpointer trigram  = GUINT_TO_POINTER(TRIGRAM(text));
+    GArray* positions = g_hash_table_lookup(trigrams, trigram);
+
+    if (positions == NULL) {
+      positions = g_array_new(FALSE, FALSE, sizeof(guint));
+      g_hash_table_insert(trigrams, trigram, positions);
+    }
+
+    /* new items are appended, so inserting in the middle is only needed when
+     * an item is replaced */
+    if (positions->len == 0 ||
+        g_array_index(positions, guint, positions->len - 1) < position) {
+      g_array_append_val(positions, position);
+      continue;
+    }
+
+    guint low  = 0;
+    guint high = positions->len;
+    while (low < high) {
+      guint middle = (low + high) / 2;
+      if (g_array_index(positions, guint, middle) < position) {
+        low = middle + 1;
+      } else {
+        high = middle;
+      }
+    }
+
+    if (g_array_index(positions, guint, low) != position) {
+      g_array_insert_val(positions, low, position);
+    }
+  }
+}
+
+static void
+jumanji_db_table_index(jumanji_db_table_t* table, guint position)
+{
+  if (table->trigrams == NULL) {
+    return;
+  }
+
+  jumanji_db_result_link_t* link = g_ptr_array_index(table->order, position);
+  if (link != NULL) {
+    jumanji_db_trigrams_add(table->trigrams, link->url,   position);
+    jumanji_db_trigrams_add(table->trigrams, link->title, position);
+  }
+}
+
+static void
+jumanji_db_table_drop_index(jumanji_db_table_t* table)
+{
+  if (table->trigrams != NULL) {
+    g_hash_table_destroy(table->trigrams);
+    table->trigrams = NULL;
+  }
+}
+
+static gint
+jumanji_db_compare_positions(gconstpointer a, gconstpointer b)
+{
+  return (gint) (*(GArray**) a)->len - (gint) (*(GArray**) b)->len;
+}
+
+static bool
+jumanji_db_contains_position(GArray* positions, guint position, guint* start)
+{
+  /* the candidates are ascending, so the search continues where the last one
+   * ended */
+  guint low  = *start;
+  guint high = positions->len;
+  while (low < high) {
+    guint middle = (low + high) / 2;
+    if (g_array_index(positions, guint, middle) < position) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  *start = low;
+
+  return low < positions->len && g_array_index(positions, guint, low) == position;
+}
+
+static GArray*
+jumanji_db_table_search(jumanji_db_table_t* table, const char* input)
+{
+  if (table->trigrams == NULL) {
+    table->trigrams = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+        NULL, jumanji_db_free_positions);
+
+    for (guint i = 0; i < table->order->len; i++) {
+      jumanji_db_table_index(table, i);
+    }
+  }
+
+  /* the candidates are the positions listed for every trigram of the input */
+  GPtrArray* lists = g_ptr_array_new();
+  for (const char* text = input; text[1] != '\0' && text[2] != '\0'; text++) {
+    GArray* positions = g_hash_table_lookup(table->trigrams,
+        GUINT_TO_POINTER(TRIGRAM(text)));
+    if (positions == NULL) {
+      g_ptr_array_free(lists, TRUE);
+      return g_array_new(FALSE, FALSE, sizeof(guint));
+    }
+    g_ptr_array_add(lists, positions);
+  }
+
+  /* intersect starting with the shortest list */
+  g_ptr_array_sort(lists, jumanji_db_compare_positions);
+
+  GArray* shortest   = g_ptr_array_index(lists, 0);
+  GArray* candidates = g_array_sized_new(FALSE, FALSE, sizeof(guint),
+      shortest->len);
+  g_array_append_vals(candidates, shortest->data, shortest->len);
+
+  for (guint i = 1; i < lists->len && candidates->len > 0; i++) {
+    GArray* positions = g_ptr_array_index(lists, i);
+    guint start = 0;
+    guint count = 0;
+
+    for (guint j = 0; j < candidates->len; j++) {
+      guint position = g_array_index(candidates, guint, j);
+      if (jumanji_db_contains_position(positions, position, &start) == true) {
+        g_array_index(candidates, guint, count++) = position;
+      }
+    }
+
+    g_array_set_size(candidates, count);
+  }
+
+  g_ptr_array_free(lists, TRUE);
+
+  return candidates;
+}
+
+const void*
+jumanji_db_link_key(const void* item)
+{
+  return ((const jumanji_db_result_link_t*) item)->url;
+}
+
+const void*
+jumanji_db_quickmark_key(const void* item)
+{
+  return GINT_TO_POINTER(((const jumanji_db_quickmark_t*) item)->identifier);
+}
+
+jumanji_db_result_link_t*
+jumanji_db_link_new(jumanji_db_store_t* store, const char* url, const char*
+    title, int visited)
+{
+  /* links of a store share the strings of other links */
+  if (store != NULL) {
+    jumanji_db_result_link_t* link = store->free_links;
+    if (link != NULL) {
+      store->free_links = *(jumanji_db_result_link_t**) link;
+    } else {
+      link = jumanji_db_store_alloc(store, sizeof(jumanji_db_result_link_t));
+    }
+
+    link->url     = jumanji_db_store_intern(store, url);
+    link->title   = (title != NULL) ? jumanji_db_store_intern(store, title) : NULL;
+    link->visited = visited;
+
+    return link;
+  }
+
+  /* the strings are stored behind the link, so it is freed with free() */
+  size_t url_size   = strlen(url) + 1;
+  size_t title_size = (title != NULL) ? strlen(title) + 1 : 0;
+
+  jumanji_db_result_link_t* link = malloc(sizeof(jumanji_db_result_link_t) +
+      url_size + title_size);
+  if (link == NULL) {
+    return NULL;
+  }
+
+  link->url     = memcpy((char*) (link + 1), url, url_size);
+  link->title   = (title != NULL) ? memcpy(link->url + url_size, title, title_size) : NULL;
+  link->visited = visited;
+
+  return link;
+}
+
+jumanji_db_quickmark_t*
+jumanji_db_quickmark_new(char identifier, const char* url)
+{
+  size_t url_size = strlen(url) + 1;
+
+  jumanji_db_quickmark_t* quickmark = malloc(sizeof(jumanji_db_quickmark_t) +
+      url_size);
+  if (quickmark == NULL) {
+    return NULL;
+  }
+
+  quickmark->identifier = identifier;
+  quickmark->url        = memcpy((char*) (quickmark + 1), url, url_size);
+
+  return quickmark;
+}
+
+bool
+jumanji_db_table_match(jumanji_db_table_t* table, const char* input,
+    jumanji_db_link_function_t function, void* data)
+{
+  if (table == NULL || input == NULL || function == NULL ||
+      table->order->len == 0) {
+    return true;
+  }
+
+  /* inputs with at least one trigram only verify the candidates of the index */
+  GArray* candidates = NULL;
+  if (table->searchable == true && strlen(input) >= 3) {
+    candidates = jumanji_db_table_search(table, input);
+  }
+
+  bool more = true;
+
+  guint length = (candidates != NULL) ? candidates->len : table->order->len;
+  for (guint i = 0; i < length && more == true; i++) {
+    guint position = (candidates != NULL) ? g_array_index(candidates, guint, i) : i;
+    jumanji_db_result_link_t* link = (jumanji_db_result_link_t*)
+      g_ptr_array_index(table->order, position);
+    if (link == NULL) {
+      continue;
+    }
+
+    if (strstr(link->url, input) != NULL || (link->title && strstr(link->title, input)) ) {
+      more = function(link->url, link->title, link->visited, data);
+    }
+  }
+
+  if (candidates != NULL) {
+    g_array_free(candidates, TRUE);
+  }
+
+  return more;
+}
@@ -0,0 +1,208 @@
+/* See LICENSE file for license and copyright information */
+
+#ifndef DATABASE_TABLE_H
+#define DATABASE_TABLE_H
+
+#include <stdbool.h>
+#include <glib.h>
+#include <girara/types.h>
+
+#include "database.h"
+
+/* packs the three bytes at text into a trigram key */
+#define TRIGRAM(text) ((guint) (guchar) (text)[0] << 16 | \
+    (guint) (guchar) (text)[1] << 8 | (guint) (guchar) (text)[2])
+
+typedef const void* (*jumanji_db_table_key_function_t)(const void* item);
+
+/* decides whether a link with the given url is skipped by a search */
+typedef bool (*jumanji_db_exclude_function_t)(const char* url, void* data);
+
+/* links and interned strings shared by the link tables */
+typedef struct jumanji_db_store_s
+{
+  GPtrArray* chunks; /**> Memory chunks, all freed at once */
+  char* chunk; /**> Chunk that allocations are taken from */
+  gsize chunk_used; /**> Used bytes of the current chunk */
+  jumanji_db_result_link_t* free_links; /**> Released links, chained through
+                                          their first field */
+  GHashTable* strings; /**> Maps an interned string to its reference count */
+  gsize string_size; /**> Bytes of interned strings */
+  gsize dead_size; /**> Bytes of strings that are no longer referenced */
+  GPtrArray* tables; /**> Tables whose links belong to the store */
+} jumanji_db_store_t;
+
+/* in-memory table */
+typedef struct jumanji_db_table_s
+{
+  GHashTable* index; /**> Maps a key to its position in the order array */
+  GPtrArray* order; /**> Items in insertion order, removed items are NULL */
+  unsigned int removed; /**> Number of removed slots in the order array */
+  jumanji_db_table_key_function_t key_function; /**> Returns the key of an item */
+  girara_free_function_t free_function; /**> Function to free an item */
+  jumanji_db_store_t* store; /**> Store of the links, NULL if the items are
+                               freed with the free function */
+  bool searchable; /**> The items are links that are searched by substring */
+  GHashTable* trigrams; /**> Maps a trigram to the sorted positions of the links
+                          containing it, built by the first search */
+} jumanji_db_table_t;
+
+typedef struct jumanji_db_quickmark_s
+{
+  char identifier; /**> Quickmark identifier */
+  char* url; /**> Url */
+} jumanji_db_quickmark_t;
+
+/**
+ * Creates a new table
+ *
+ * @param hash_function Hash function of the keys
+ * @param equal_function Compares two keys
+ * @param key_function Returns the key of an item
+ * @param free_function Frees an item
+ * @return The table or NULL if an error occured
+ */
+jumanji_db_table_t* jumanji_db_table_new(GHashFunc hash_function,
+    GEqualFunc equal_function, jumanji_db_table_key_function_t key_function,
+    girara_free_function_t free_function);
+
+/**
+ * Frees a table and its items. Items of a store are freed with the store.
+ *
+ * @param table The table
+ */
+void jumanji_db_table_free(jumanji_db_table_t* table);
+
+/**
+ * Looks up an item
+ *
+ * @param table The table
+ * @param key The key of the item
+ * @return The item or NULL if it does not exist
+ */
+void* jumanji_db_table_lookup(jumanji_db_table_t* table, const void* key);
+
+/**
+ * Inserts an item, replacing an item with the same key
+ *
+ * @param table The table
+ * @param item The item, owned by the table afterwards
+ */
+void jumanji_db_table_insert(jumanji_db_table_t* table, void* item);
+
+/**
+ * Removes an item
+ *
+ * @param table The table
+ * @param key The key of the item
+ * @return true if an item has been removed
+ */
+bool jumanji_db_table_remove(jumanji_db_table_t* table, const void* key);
+
+/**
+ * Removes all items
+ *
+ * @param table The table
+ */
+void jumanji_db_table_clear(jumanji_db_table_t* table);
+
+/**
+ * Calls a function for every link whose url or title contains the input
+ *
+ * @param table Table of links
+ * @param input The data that the links should match
+ * @param function Receives the links
+ * @param data Custom data passed to the function
+ * @return false if the function stopped the search
+ */
+bool jumanji_db_table_match(jumanji_db_table_t* table, const char* input,
+    jumanji_db_link_function_t function, void* data);
+
+/**
+ * Adds the trigrams of a text to a trigram index
+ *
+ * @param trigrams Maps a trigram to a sorted GArray of guint positions
+ * @param text The text, may be NULL
+ * @param position Position of the item the text belongs to
+ */
+void jumanji_db_trigrams_add(GHashTable* trigrams, const char* text, guint
+    position);
+
+/**
+ * Frees the positions of a trigram index
+ *
+ * @param data GArray of positions
+ */
+void jumanji_db_free_positions(gpointer data);
+
+/**
+ * Key function of link tables
+ *
+ * @param item The link
+ * @return The url of the link
+ */
+const void* jumanji_db_link_key(const void* item);
+
+/**
+ * Key function of quickmark tables
+ *
+ * @param item The quickmark
+ * @return The identifier of the quickmark
+ */
+const void* jumanji_db_quickmark_key(const void* item);
+
+/**
+ * Creates a store
+ *
+ * @return The store or NULL if an error occured
+ */
+jumanji_db_store_t* jumanji_db_store_new(void);
+
+/**
+ * Frees a store and all links allocated from it
+ *
+ * @param store The store
+ */
+void jumanji_db_store_free(jumanji_db_store_t* store);
+
+/**
+ * Lets a table free its links through the store
+ *
+ * @param store The store
+ * @param table Table of links
+ */
+void jumanji_db_store_attach(jumanji_db_store_t* store, jumanji_db_table_t*
+    table);
+
+/**
+ * Moves the links of the attached tables into new memory once most strings
+ * of the store are no longer referenced
+ *
+ * @param store The store
+ */
+void jumanji_db_store_repack(jumanji_db_store_t* store);
+
+/**
+ * Creates a link
+ *
+ * @param store Store to allocate the link from, or NULL to allocate a link
+ *        that is freed with free()
+ * @param url The url
+ * @param title The title, may be NULL
+ * @param visited Last time the link has been visited
+ * @return The link or NULL if an error occured
+ */
+jumanji_db_result_link_t* jumanji_db_link_new(jumanji_db_store_t* store,
+    const char* url, const char* title, int visited);
+
+/**
+ * Creates a quickmark that is freed with free()
+ *
+ * @param identifier The identifier
+ * @param url The url
+ * @return The quickmark or NULL if an error occured
+ */
+jumanji_db_quickmark_t* jumanji_db_quickmark_new(char identifier, const char*
+    url);
+
+#endif // DATABASE_TABLE_H
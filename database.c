@@ -1,8 +1,1185 @@
 /* See LICENSE file for license and copyright information */
 
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <girara/datastructures.h>
 
 #include "database.h"
+#include "database-backend.h"
+#include "database-fuzzy.h"
+
+/* pending mutations are written after this many seconds without a flush */
+#define FLUSH_TIMEOUT 2
+/* ... or as soon as this many mutations are pending */
+#define FLUSH_THRESHOLD 64
+
+/* history entries are expired in chunks of this size ... */
+#define EXPIRE_CHUNK 256
+/* ... and looked for again after this many seconds */
+#define EXPIRE_INTERVAL (60 * 60)
+
+/* fuzzy searches check for cancellation and their deadline after this many
+ * links */
+#define FUZZY_CANCEL_INTERVAL 1024
+/* time in us a fuzzy search may scan while its caller waits */
+#define FUZZY_WAIT_TIME (20 * 1000)
+
+typedef enum jumanji_db_mutation_type_e
+{
+  BOOKMARK_ADD,
+  BOOKMARK_REMOVE,
+  HISTORY_ADD,
+  HISTORY_CLEAN,
+  QUICKMARK_ADD,
+  QUICKMARK_REMOVE
+} jumanji_db_mutation_type_t;
+
+typedef struct jumanji_db_mutation_s
+{
+  jumanji_db_mutation_type_t type; /**> Kind of mutation */
+  char* url; /**> Url */
+  char* title; /**> Title */
+  int visited; /**> Time of the visit */
+  unsigned int age; /**> Age of history entries to clean */
+  char identifier; /**> Quickmark identifier */
+} jumanji_db_mutation_t;
+
+typedef enum jumanji_db_job_type_e
+{
+  JOB_INIT,
+  JOB_FREE,
+  JOB_WRITE,
+  JOB_BOOKMARK_FIND,
+  JOB_BOOKMARK_EXISTS,
+  JOB_HISTORY_FIND,
+  JOB_QUICKMARK_FIND,
+  JOB_SAVE_SESSION,
+  JOB_LOAD_SESSION,
+  JOB_IMPORT,
+  JOB_EXPIRE
+} jumanji_db_job_type_t;
+
+/* request to the database thread */
+typedef struct jumanji_db_job_s
+{
+  jumanji_db_job_type_t type; /**> Kind of job */
+  char* input; /**> Directory, search input or session name */
+  char identifier; /**> Quickmark identifier */
+  GPtrArray* mutations; /**> Mutations to write */
+  girara_list_t* urls; /**> Session urls */
+  unsigned int age; /**> Maximal age of history entries */
+  unsigned int size; /**> Maximal number of history entries */
+  unsigned int limit; /**> Maximal number of matching links, 0 for no limit */
+  unsigned int count; /**> Number of matching links passed to the function */
+  jumanji_db_link_function_t link_function; /**> Receives matching links */
+  void* link_data; /**> Data passed to the link function */
+  GCancellable* cancellable; /**> Cancels the job, may be NULL */
+  bool fuzzy; /**> Fills up the matching links with the best fuzzy matches */
+  bool stopped; /**> The link function has stopped the search */
+  bool truncated; /**> The fuzzy search stopped at its deadline */
+  GHashTable* passed; /**> Urls passed by the exact search of a fuzzy one */
+
+  void* result; /**> Result of the job */
+  jumanji_db_find_callback_t find_callback; /**> Callback for list results */
+  jumanji_db_quickmark_callback_t quickmark_callback; /**> Callback for quickmarks */
+  void* user_data; /**> Data passed to the callback */
+
+  bool synchronous; /**> The caller waits for the job */
+  bool done; /**> Set once a synchronous job has finished */
+  GMutex mutex; /**> Protects done */
+  GCond cond; /**> Signaled once done is set */
+} jumanji_db_job_t;
+
+struct jumanji_database_s
+{
+  const jumanji_db_backend_t* backend; /**> Storage backend */
+  void* data; /**> Backend data, only used by the database thread */
+
+  GThread* thread; /**> Database thread */
+  GMainContext* context; /**> Main context of the database thread */
+  GMainLoop* loop; /**> Main loop of the database thread */
+  GAsyncQueue* jobs; /**> Jobs for the database thread */
+
+  GPtrArray* pending; /**> Mutations that have not been written yet */
+  GHashTable* pending_history; /**> Pending history mutations by url */
+  guint flush_source; /**> Timeout that writes pending mutations */
+
+  unsigned int expire_age; /**> Maximal age of history entries */
+  unsigned int expire_size; /**> Maximal number of history entries */
+  GSource* expire_source; /**> Idle source that expires the next chunk */
+  GSource* expire_timer; /**> Timeout that restarts the expiry */
+  GSource* idle_source; /**> Idle source that runs work deferred by the backend */
+
+  volatile gint revision; /**> Changed whenever data is added or removed */
+};
+
+/* state of a fuzzy search */
+typedef struct jumanji_db_fuzzy_search_s
+{
+  jumanji_database_t* database; /**> The database */
+  jumanji_db_job_t* job; /**> The search job */
+  jumanji_db_fuzzy_t fuzzy; /**> The prepared input */
+  jumanji_db_fuzzy_top_t* top; /**> Best links so far */
+  unsigned int scanned; /**> Number of scanned links */
+  gint64 deadline; /**> Monotonic time at which the scan stops, 0 for none */
+} jumanji_db_fuzzy_search_t;
+
+static gpointer jumanji_db_thread(gpointer data);
+static void jumanji_db_flush(jumanji_database_t* database);
+static void jumanji_db_mutation_free(void* data);
+static void jumanji_db_job_push(jumanji_database_t* database, jumanji_db_job_t* job);
+static void* jumanji_db_job_wait(jumanji_database_t* database, jumanji_db_job_t* job);
+static jumanji_database_t* jumanji_db_init_backend(const jumanji_db_backend_t*
+    backend, const char* dir);
+static void jumanji_db_expire_start(jumanji_database_t* database);
+static void jumanji_db_expire_stop(jumanji_database_t* database);
+static void jumanji_db_idle_start(jumanji_database_t* database);
+static void jumanji_db_idle_stop(jumanji_database_t* database);
+static bool jumanji_db_job_match_link(const char* url, const char* title, int
+    visited, void* data);
+static bool jumanji_db_job_collect_link(const char* url, const char* title, int
+    visited, void* data);
+static void jumanji_db_job_fuzzy(jumanji_database_t* database, jumanji_db_job_t*
+    job, void (*foreach)(void* data, jumanji_db_link_function_t function, void*
+      function_data));
+static bool jumanji_db_job_fuzzy_link(const char* url, const char* title, int
+    visited, void* data);
+
+jumanji_database_t*
+jumanji_db_init(const char* dir)
+{
+  if (dir == NULL) {
+    return NULL;
+  }
+
+  return jumanji_db_init_backend(&jumanji_db_backend, dir);
+}
+
+jumanji_database_t*
+jumanji_db_init_ephemeral(void)
+{
+  return jumanji_db_init_backend(&jumanji_db_memory_backend, NULL);
+}
+
+static jumanji_database_t*
+jumanji_db_init_backend(const jumanji_db_backend_t* backend, const char* dir)
+{
+  jumanji_database_t* database = g_malloc0(sizeof(jumanji_database_t));
+  if (database == NULL) {
+    return NULL;
+  }
+
+  database->backend         = backend;
+  database->pending         = g_ptr_array_new_with_free_func(jumanji_db_mutation_free);
+  database->pending_history = g_hash_table_new(g_str_hash, g_str_equal);
+  database->context         = g_main_context_new();
+  database->loop            = g_main_loop_new(database->context, FALSE);
+  database->jobs            = g_async_queue_new();
+  database->thread          = g_thread_new("database", jumanji_db_thread, database);
+
+  /* the storage is opened by the database thread, so that its file monitors
+   * are dispatched there as well */
+  jumanji_db_job_t job = { .type = JOB_INIT, .input = (char*) dir };
+  if (jumanji_db_job_wait(database, &job) == NULL) {
+    jumanji_db_free(database);
+    return NULL;
+  }
+
+  return database;
+}
+
+bool
+jumanji_db_check_location(const char* dir)
+{
+  return jumanji_db_backend.check_location(dir);
+}
+
+void
+jumanji_db_free(jumanji_database_t* database)
+{
+  if (database == NULL) {
+    return;
+  }
+
+  /* write pending mutations, close the storage and stop the thread */
+  jumanji_db_flush(database);
+
+  jumanji_db_job_t job = { .type = JOB_FREE };
+  jumanji_db_job_wait(database, &job);
+  g_thread_join(database->thread);
+
+  g_async_queue_unref(database->jobs);
+  g_main_loop_unref(database->loop);
+  g_main_context_unref(database->context);
+
+  g_hash_table_destroy(database->pending_history);
+  g_ptr_array_free(database->pending, TRUE);
+  g_free(database);
+}
+
+static gpointer
+jumanji_db_thread(gpointer data)
+{
+  jumanji_database_t* database = (jumanji_database_t*) data;
+
+  g_main_context_push_thread_default(database->context);
+  g_main_loop_run(database->loop);
+  g_main_context_pop_thread_default(database->context);
+
+  return NULL;
+}
+
+static void
+jumanji_db_write(jumanji_database_t* database, GPtrArray* mutations)
+{
+  const jumanji_db_backend_t* backend = database->backend;
+
+  backend->begin(database->data);
+
+  for (unsigned int i = 0; i < mutations->len; i++) {
+    jumanji_db_mutation_t* mutation = g_ptr_array_index(mutations, i);
+
+    switch (mutation->type) {
+      case BOOKMARK_ADD:
+        backend->bookmark_add(database->data, mutation->url, mutation->title);
+        break;
+      case BOOKMARK_REMOVE:
+        backend->bookmark_remove(database->data, mutation->url);
+        break;
+      case HISTORY_ADD:
+        backend->history_add(database->data, mutation->url, mutation->title,
+            mutation->visited);
+        break;
+      case HISTORY_CLEAN:
+        backend->history_clean(database->data, mutation->age);
+        break;
+      case QUICKMARK_ADD:
+        backend->quickmark_add(database->data, mutation->identifier, mutation->url);
+        break;
+      case QUICKMARK_REMOVE:
+        backend->quickmark_remove(database->data, mutation->identifier);
+        break;
+    }
+  }
+
+  backend->commit(database->data);
+}
+
+static void
+jumanji_db_job_run(jumanji_database_t* database, jumanji_db_job_t* job)
+{
+  const jumanji_db_backend_t* backend = database->backend;
+
+  /* searches that were cancelled while queued are not started at all */
+  if (job->cancellable != NULL &&
+      g_cancellable_is_cancelled(job->cancellable) == TRUE) {
+    return;
+  }
+
+  switch (job->type) {
+    case JOB_INIT:
+      database->data = backend->init(job->input);
+      job->result    = database->data;
+      jumanji_db_idle_start(database);
+      break;
+    case JOB_FREE:
+      jumanji_db_expire_stop(database);
+      jumanji_db_idle_stop(database);
+      if (database->data != NULL) {
+        backend->free(database->data);
+        database->data = NULL;
+      }
+      g_main_loop_quit(database->loop);
+      break;
+    case JOB_WRITE:
+      jumanji_db_write(database, job->mutations);
+      break;
+    case JOB_BOOKMARK_FIND:
+      if (job->fuzzy == true) {
+        job->passed = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+            NULL);
+      }
+      backend->bookmark_match(database->data, job->input, job->limit,
+          jumanji_db_job_match_link, job);
+      if (job->fuzzy == true) {
+        jumanji_db_job_fuzzy(database, job, backend->bookmark_foreach);
+        g_hash_table_destroy(job->passed);
+        job->passed = NULL;
+      }
+      break;
+    case JOB_BOOKMARK_EXISTS:
+      job->result = GINT_TO_POINTER(backend->bookmark_exists(database->data,
+            job->input));
+      break;
+    case JOB_HISTORY_FIND:
+      if (job->fuzzy == true) {
+        job->passed = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+            NULL);
+      }
+      backend->history_match(database->data, job->input, job->limit,
+          jumanji_db_job_match_link, job);
+      if (job->fuzzy == true) {
+        jumanji_db_job_fuzzy(database, job, backend->history_foreach);
+        g_hash_table_destroy(job->passed);
+        job->passed = NULL;
+      }
+      break;
+    case JOB_QUICKMARK_FIND:
+      job->result = backend->quickmark_find(database->data, job->identifier);
+      break;
+    case JOB_SAVE_SESSION:
+      backend->save_session(database->data, job->input, job->urls);
+      break;
+    case JOB_LOAD_SESSION:
+      job->result = backend->load_session(database->data, job->input);
+      break;
+    case JOB_IMPORT:
+      job->result = GINT_TO_POINTER(backend->import(database->data, job->input));
+      /* the import may leave work to the idle steps as well */
+      jumanji_db_idle_start(database);
+      break;
+    case JOB_EXPIRE:
+      database->expire_age  = job->age;
+      database->expire_size = job->size;
+      jumanji_db_expire_start(database);
+      break;
+  }
+}
+
+static bool
+jumanji_db_job_match_link(const char* url, const char* title, int visited,
+    void* data)
+{
+  jumanji_db_job_t* job = (jumanji_db_job_t*) data;
+
+  if (job->limit != 0 && job->count >= job->limit) {
+    return false;
+  }
+
+  if (job->cancellable != NULL &&
+      g_cancellable_is_cancelled(job->cancellable) == TRUE) {
+    return false;
+  }
+
+  job->count++;
+
+  if (job->passed != NULL) {
+    g_hash_table_add(job->passed, g_strdup(url));
+  }
+
+  if (job->link_function(url, title, visited, job->link_data) == false) {
+    job->stopped = true;
+    return false;
+  }
+
+  return job->limit == 0 || job->count < job->limit;
+}
+
+static void
+jumanji_db_job_fuzzy(jumanji_database_t* database, jumanji_db_job_t* job,
+    void (*foreach)(void* data, jumanji_db_link_function_t function, void*
+      function_data))
+{
+  if (foreach == NULL || job->stopped == true ||
+      (job->limit != 0 && job->count >= job->limit)) {
+    return;
+  }
+
+  jumanji_db_fuzzy_search_t search = { .database = database, .job = job };
+  if (jumanji_db_fuzzy_init(&search.fuzzy, job->input) == false) {
+    return;
+  }
+
+  /* a waiting caller only gets the fuzzy matches among the links that are
+   * passed first, the asynchronous searches scan all of them */
+  if (job->synchronous == true) {
+    search.deadline = g_get_monotonic_time() + FUZZY_WAIT_TIME;
+  }
+
+  /* the links that were passed already leave this many places */
+  search.top = jumanji_db_fuzzy_top_new((job->limit != 0) ? job->limit -
+      job->count : 0);
+
+  foreach(database->data, jumanji_db_job_fuzzy_link, &search);
+  jumanji_db_fuzzy_top_foreach(search.top, jumanji_db_job_match_link, job);
+
+  jumanji_db_fuzzy_top_free(search.top);
+}
+
+static bool
+jumanji_db_job_fuzzy_link(const char* url, const char* title, int visited,
+    void* data)
+{
+  jumanji_db_fuzzy_search_t* search = (jumanji_db_fuzzy_search_t*) data;
+  jumanji_db_job_t* job             = search->job;
+
+  if (++search->scanned % FUZZY_CANCEL_INTERVAL == 0) {
+    if (job->cancellable != NULL &&
+        g_cancellable_is_cancelled(job->cancellable) == TRUE) {
+      return false;
+    }
+
+    if (search->deadline != 0 && g_get_monotonic_time() >= search->deadline) {
+      job->truncated = true;
+      return false;
+    }
+  }
+
+  int score = jumanji_db_fuzzy_score_link(&search->fuzzy, url, title);
+  if (score < 0 || jumanji_db_fuzzy_top_accepts(search->top, score, visited)
+      == false) {
+    return true;
+  }
+
+  /* the exact search may skip links that contain the input, e.g. the cold
+   * ones of a short input, only the ones it passed are left out */
+  if (g_hash_table_contains(job->passed, url) == FALSE) {
+    jumanji_db_fuzzy_top_add(search->top, score, url, title, visited);
+  }
+
+  return true;
+}
+
+static bool
+jumanji_db_job_collect_link(const char* url, const char* title, int visited,
+    void* data)
+{
+  jumanji_db_result_link_t* link = malloc(sizeof(jumanji_db_result_link_t));
+  if (link == NULL) {
+    return false;
+  }
+
+  link->url     = g_strdup(url);
+  link->title   = g_strdup(title);
+  link->visited = visited;
+
+  girara_list_append((girara_list_t*) data, link);
+
+  return true;
+}
+
+static void
+jumanji_db_job_init_find(jumanji_db_job_t* job, const char* input)
+{
+  /* the matching links are copied into the result list */
+  job->input         = (char*) input;
+  job->result        = girara_list_new2(jumanji_db_free_result_link);
+  job->link_function = jumanji_db_job_collect_link;
+  job->link_data     = job->result;
+}
+
+static gboolean
+cb_jumanji_db_expire(gpointer data)
+{
+  jumanji_database_t* database = (jumanji_database_t*) data;
+
+  unsigned int expired = 0;
+  bool more            = false;
+
+  /* backends without chunked expiry only remove entries that are too old,
+   * all at once */
+  if (database->backend->history_expire != NULL) {
+    more = database->backend->history_expire(database->data,
+        database->expire_age, database->expire_size, EXPIRE_CHUNK, &expired);
+  } else {
+    database->backend->history_clean(database->data, database->expire_age);
+    g_atomic_int_inc(&database->revision);
+  }
+
+  /* removed links may have been returned by earlier searches, the steps that
+   * only reclaim space change nothing */
+  if (expired > 0) {
+    g_atomic_int_inc(&database->revision);
+  }
+
+  if (more == true) {
+    return TRUE;
+  }
+
+  g_source_unref(database->expire_source);
+  database->expire_source = NULL;
+
+  return FALSE;
+}
+
+static gboolean
+cb_jumanji_db_expire_timer(gpointer data)
+{
+  jumanji_db_expire_start((jumanji_database_t*) data);
+
+  return TRUE;
+}
+
+static void
+jumanji_db_expire_start(jumanji_database_t* database)
+{
+  if (database->data == NULL) {
+    return;
+  }
+
+  unsigned int size = (database->backend->history_expire != NULL) ?
+    database->expire_size : 0;
+  if (database->expire_age == 0 && size == 0) {
+    jumanji_db_expire_stop(database);
+    return;
+  }
+
+  /* chunks are only expired while no job is waiting, jobs are dispatched
+   * with a higher priority */
+  if (database->expire_source == NULL) {
+    database->expire_source = g_idle_source_new();
+    g_source_set_priority(database->expire_source, G_PRIORITY_LOW);
+    g_source_set_callback(database->expire_source, cb_jumanji_db_expire,
+        database, NULL);
+    g_source_attach(database->expire_source, database->context);
+  }
+
+  if (database->expire_timer == NULL) {
+    database->expire_timer = g_timeout_source_new_seconds(EXPIRE_INTERVAL);
+    g_source_set_callback(database->expire_timer, cb_jumanji_db_expire_timer,
+        database, NULL);
+    g_source_attach(database->expire_timer, database->context);
+  }
+}
+
+static void
+jumanji_db_expire_stop(jumanji_database_t* database)
+{
+  if (database->expire_source != NULL) {
+    g_source_destroy(database->expire_source);
+    g_source_unref(database->expire_source);
+    database->expire_source = NULL;
+  }
+
+  if (database->expire_timer != NULL) {
+    g_source_destroy(database->expire_timer);
+    g_source_unref(database->expire_timer);
+    database->expire_timer = NULL;
+  }
+}
+
+static gboolean
+cb_jumanji_db_idle(gpointer data)
+{
+  jumanji_database_t* database = (jumanji_database_t*) data;
+
+  if (database->backend->idle(database->data) == true) {
+    return TRUE;
+  }
+
+  /* the deferred work may change what earlier searches returned */
+  g_atomic_int_inc(&database->revision);
+
+  g_source_unref(database->idle_source);
+  database->idle_source = NULL;
+
+  return FALSE;
+}
+
+static void
+jumanji_db_idle_start(jumanji_database_t* database)
+{
+  if (database->backend->idle == NULL || database->data == NULL ||
+      database->idle_source != NULL) {
+    return;
+  }
+
+  /* like expiry, deferred work only runs while no job is waiting */
+  database->idle_source = g_idle_source_new();
+  g_source_set_priority(database->idle_source, G_PRIORITY_LOW);
+  g_source_set_callback(database->idle_source, cb_jumanji_db_idle, database,
+      NULL);
+  g_source_attach(database->idle_source, database->context);
+}
+
+static void
+jumanji_db_idle_stop(jumanji_database_t* database)
+{
+  if (database->idle_source != NULL) {
+    g_source_destroy(database->idle_source);
+    g_source_unref(database->idle_source);
+    database->idle_source = NULL;
+  }
+}
+
+static gboolean
+cb_jumanji_db_job_done(gpointer data)
+{
+  jumanji_db_job_t* job = (jumanji_db_job_t*) data;
+
+  /* the results of a cancelled search may be incomplete */
+  if (job->cancellable != NULL &&
+      g_cancellable_is_cancelled(job->cancellable) == TRUE) {
+    if (job->result != NULL) {
+      girara_list_free(job->result);
+      job->result = NULL;
+    }
+  }
+
+  if (job->find_callback != NULL) {
+    job->find_callback(job->result, job->user_data);
+  } else if (job->quickmark_callback != NULL) {
+    job->quickmark_callback(job->result, job->user_data);
+  }
+
+  if (job->cancellable != NULL) {
+    g_object_unref(job->cancellable);
+  }
+
+  g_free(job->input);
+  g_free(job);
+
+  return FALSE;
+}
+
+static gboolean
+cb_jumanji_db_run_jobs(gpointer data)
+{
+  jumanji_database_t* database = (jumanji_database_t*) data;
+
+  jumanji_db_job_t* job = NULL;
+  while ((job = g_async_queue_try_pop(database->jobs)) != NULL) {
+    jumanji_db_job_run(database, job);
+
+    if (job->synchronous == true) {
+      g_mutex_lock(&job->mutex);
+      job->done = true;
+      g_cond_signal(&job->cond);
+      g_mutex_unlock(&job->mutex);
+    } else if (job->type == JOB_WRITE) {
+      g_ptr_array_free(job->mutations, TRUE);
+      g_free(job);
+    } else {
+      /* results are handed to the callback on the main loop */
+      g_idle_add(cb_jumanji_db_job_done, job);
+    }
+  }
+
+  return FALSE;
+}
+
+static void
+jumanji_db_job_push(jumanji_database_t* database, jumanji_db_job_t* job)
+{
+  /* jobs are run in the order they were queued */
+  g_async_queue_push(database->jobs, job);
+  g_main_context_invoke(database->context, cb_jumanji_db_run_jobs, database);
+}
+
+static void*
+jumanji_db_job_wait(jumanji_database_t* database, jumanji_db_job_t* job)
+{
+  job->synchronous = true;
+  g_mutex_init(&job->mutex);
+  g_cond_init(&job->cond);
+
+  jumanji_db_job_push(database, job);
+
+  g_mutex_lock(&job->mutex);
+  while (job->done == false) {
+    g_cond_wait(&job->cond, &job->mutex);
+  }
+  g_mutex_unlock(&job->mutex);
+
+  g_mutex_clear(&job->mutex);
+  g_cond_clear(&job->cond);
+
+  return job->result;
+}
+
+static void
+jumanji_db_job_push_find(jumanji_database_t* database, jumanji_db_job_type_t
+    type, const char* input, unsigned int limit, bool fuzzy, GCancellable*
+    cancellable, jumanji_db_find_callback_t callback, void* user_data)
+{
+  jumanji_db_job_t* job = g_malloc0(sizeof(jumanji_db_job_t));
+
+  job->type          = type;
+  job->limit         = limit;
+  job->fuzzy         = fuzzy;
+  job->cancellable   = (cancellable != NULL) ? g_object_ref(cancellable) : NULL;
+  job->find_callback = callback;
+  job->user_data     = user_data;
+  jumanji_db_job_init_find(job, g_strdup(input));
+
+  jumanji_db_job_push(database, job);
+}
+
+static gboolean
+cb_jumanji_db_flush(gpointer data)
+{
+  jumanji_database_t* database = (jumanji_database_t*) data;
+
+  database->flush_source = 0;
+  jumanji_db_flush(database);
+
+  return FALSE;
+}
+
+static void
+jumanji_db_flush(jumanji_database_t* database)
+{
+  if (database->flush_source != 0) {
+    g_source_remove(database->flush_source);
+    database->flush_source = 0;
+  }
+
+  if (database->pending->len == 0) {
+    return;
+  }
+
+  /* the batch is written by the database thread */
+  jumanji_db_job_t* job = g_malloc0(sizeof(jumanji_db_job_t));
+  job->type      = JOB_WRITE;
+  job->mutations = database->pending;
+
+  database->pending = g_ptr_array_new_with_free_func(jumanji_db_mutation_free);
+  g_hash_table_remove_all(database->pending_history);
+
+  jumanji_db_job_push(database, job);
+}
+
+static void
+jumanji_db_queue(jumanji_database_t* database, jumanji_db_mutation_t* mutation)
+{
+  /* repeated visits of an url are merged as long as no other mutation has
+   * been queued in between */
+  if (mutation->type == HISTORY_ADD) {
+    g_hash_table_insert(database->pending_history, mutation->url, mutation);
+  } else {
+    g_hash_table_remove_all(database->pending_history);
+  }
+
+  g_ptr_array_add(database->pending, mutation);
+  g_atomic_int_inc(&database->revision);
+
+  if (database->pending->len >= FLUSH_THRESHOLD) {
+    jumanji_db_flush(database);
+  } else if (database->flush_source == 0) {
+    database->flush_source = g_timeout_add_seconds(FLUSH_TIMEOUT,
+        cb_jumanji_db_flush, database);
+  }
+}
+
+static jumanji_db_mutation_t*
+jumanji_db_mutation_new(jumanji_db_mutation_type_t type, const char* url,
+    const char* title)
+{
+  jumanji_db_mutation_t* mutation = g_malloc0(sizeof(jumanji_db_mutation_t));
+
+  mutation->type  = type;
+  mutation->url   = g_strdup(url);
+  mutation->title = g_strdup(title);
+
+  return mutation;
+}
+
+static void
+jumanji_db_mutation_free(void* data)
+{
+  if (data == NULL) {
+    return;
+  }
+
+  jumanji_db_mutation_t* mutation = (jumanji_db_mutation_t*) data;
+  g_free(mutation->url);
+  g_free(mutation->title);
+  g_free(mutation);
+}
+
+void
+jumanji_db_bookmark_add(jumanji_database_t* database, const char* url, const char* title)
+{
+  if (database == NULL || url == NULL) {
+    return;
+  }
+
+  jumanji_db_queue(database, jumanji_db_mutation_new(BOOKMARK_ADD, url, title));
+}
+
+girara_list_t*
+jumanji_db_bookmark_find(jumanji_database_t* database, const char* input)
+{
+  if (database == NULL || input == NULL) {
+    return NULL;
+  }
+
+  jumanji_db_flush(database);
+
+  jumanji_db_job_t job = { .type = JOB_BOOKMARK_FIND };
+  jumanji_db_job_init_find(&job, input);
+
+  return jumanji_db_job_wait(database, &job);
+}
+
+void
+jumanji_db_bookmark_match(jumanji_database_t* database, const char* input,
+    unsigned int limit, jumanji_db_link_function_t function, void* data)
+{
+  if (database == NULL || input == NULL || function == NULL) {
+    return;
+  }
+
+  jumanji_db_flush(database);
+
+  jumanji_db_job_t job = { .type = JOB_BOOKMARK_FIND, .input = (char*) input,
+    .limit = limit, .link_function = function, .link_data = data };
+  jumanji_db_job_wait(database, &job);
+}
+
+bool
+jumanji_db_bookmark_match_fuzzy(jumanji_database_t* database, const char* input,
+    unsigned int limit, jumanji_db_link_function_t function, void* data)
+{
+  if (database == NULL || input == NULL || function == NULL) {
+    return true;
+  }
+
+  jumanji_db_flush(database);
+
+  jumanji_db_job_t job = { .type = JOB_BOOKMARK_FIND, .input = (char*) input,
+    .limit = limit, .fuzzy = true, .link_function = function, .link_data =
+      data };
+  jumanji_db_job_wait(database, &job);
+
+  return job.truncated == false;
+}
+
+bool
+jumanji_db_bookmark_exists(jumanji_database_t* database, const char* url)
+{
+  if (database == NULL || url == NULL) {
+    return false;
+  }
+
+  jumanji_db_flush(database);
+
+  jumanji_db_job_t job = { .type = JOB_BOOKMARK_EXISTS, .input = (char*) url };
+
+  return GPOINTER_TO_INT(jumanji_db_job_wait(database, &job)) != 0;
+}
+
+void
+jumanji_db_bookmark_find_async(jumanji_database_t* database, const char* input,
+    unsigned int limit, GCancellable* cancellable, jumanji_db_find_callback_t
+    callback, void* data)
+{
+  if (database == NULL || input == NULL || callback == NULL) {
+    return;
+  }
+
+  jumanji_db_flush(database);
+  jumanji_db_job_push_find(database, JOB_BOOKMARK_FIND, input, limit, false,
+      cancellable, callback, data);
+}
+
+void
+jumanji_db_bookmark_find_fuzzy_async(jumanji_database_t* database, const char*
+    input, unsigned int limit, GCancellable* cancellable,
+    jumanji_db_find_callback_t callback, void* data)
+{
+  if (database == NULL || input == NULL || callback == NULL) {
+    return;
+  }
+
+  jumanji_db_flush(database);
+  jumanji_db_job_push_find(database, JOB_BOOKMARK_FIND, input, limit, true,
+      cancellable, callback, data);
+}
+
+void
+jumanji_db_bookmark_remove(jumanji_database_t* database, const char* url)
+{
+  if (database == NULL || url == NULL) {
+    return;
+  }
+
+  jumanji_db_queue(database, jumanji_db_mutation_new(BOOKMARK_REMOVE, url, NULL));
+}
+
+void
+jumanji_db_history_add(jumanji_database_t* database, const char* url, const char* title)
+{
+  if (database == NULL || url == NULL) {
+    return;
+  }
+
+  jumanji_db_mutation_t* mutation = g_hash_table_lookup(database->pending_history, url);
+  if (mutation != NULL) {
+    g_free(mutation->title);
+    mutation->title   = g_strdup(title);
+    mutation->visited = time(NULL);
+    return;
+  }
+
+  mutation          = jumanji_db_mutation_new(HISTORY_ADD, url, title);
+  mutation->visited = time(NULL);
+
+  jumanji_db_queue(database, mutation);
+}
+
+girara_list_t*
+jumanji_db_history_find(jumanji_database_t* database, const char* input)
+{
+  if (database == NULL || input == NULL) {
+    return NULL;
+  }
+
+  jumanji_db_flush(database);
+
+  jumanji_db_job_t job = { .type = JOB_HISTORY_FIND };
+  jumanji_db_job_init_find(&job, input);
+
+  return jumanji_db_job_wait(database, &job);
+}
+
+void
+jumanji_db_history_match(jumanji_database_t* database, const char* input,
+    unsigned int limit, jumanji_db_link_function_t function, void* data)
+{
+  if (database == NULL || input == NULL || function == NULL) {
+    return;
+  }
+
+  jumanji_db_flush(database);
+
+  jumanji_db_job_t job = { .type = JOB_HISTORY_FIND, .input = (char*) input,
+    .limit = limit, .link_function = function, .link_data = data };
+  jumanji_db_job_wait(database, &job);
+}
+
+bool
+jumanji_db_history_match_fuzzy(jumanji_database_t* database, const char* input,
+    unsigned int limit, jumanji_db_link_function_t function, void* data)
+{
+  if (database == NULL || input == NULL || function == NULL) {
+    return true;
+  }
+
+  jumanji_db_flush(database);
+
+  jumanji_db_job_t job = { .type = JOB_HISTORY_FIND, .input = (char*) input,
+    .limit = limit, .fuzzy = true, .link_function = function, .link_data =
+      data };
+  jumanji_db_job_wait(database, &job);
+
+  return job.truncated == false;
+}
+
+void
+jumanji_db_history_find_async(jumanji_database_t* database, const char* input,
+    unsigned int limit, GCancellable* cancellable, jumanji_db_find_callback_t
+    callback, void* data)
+{
+  if (database == NULL || input == NULL || callback == NULL) {
+    return;
+  }
+
+  jumanji_db_flush(database);
+  jumanji_db_job_push_find(database, JOB_HISTORY_FIND, input, limit, false,
+      cancellable, callback, data);
+}
+
+void
+jumanji_db_history_find_fuzzy_async(jumanji_database_t* database, const char*
+    input, unsigned int limit, GCancellable* cancellable,
+    jumanji_db_find_callback_t callback, void* data)
+{
+  if (database == NULL || input == NULL || callback == NULL) {
+    return;
+  }
+
+  jumanji_db_flush(database);
+  jumanji_db_job_push_find(database, JOB_HISTORY_FIND, input, limit, true,
+      cancellable, callback, data);
+}
+
+bool
+jumanji_db_link_matches(jumanji_database_t* database, const char* url,
+    const char* title, const char* input)
+{
+  if (database == NULL || url == NULL || input == NULL) {
+    return false;
+  }
+
+  if (database->backend->ignore_case == false) {
+    return strstr(url, input) != NULL || (title != NULL && strstr(title,
+          input) != NULL);
+  }
+
+  char* key_input = g_utf8_casefold(input, -1);
+  char* key_url   = g_utf8_casefold(url, -1);
+  char* key_title = (title != NULL) ? g_utf8_casefold(title, -1) : NULL;
+
+  bool result = strstr(key_url, key_input) != NULL || (key_title != NULL &&
+      strstr(key_title, key_input) != NULL);
+
+  g_free(key_input);
+  g_free(key_url);
+  g_free(key_title);
+
+  return result;
+}
+
+int
+jumanji_db_link_score(jumanji_database_t* database, const char* url, const
+    char* title, const char* input)
+{
+  if (database == NULL || url == NULL || input == NULL) {
+    return -1;
+  }
+
+  jumanji_db_fuzzy_t fuzzy;
+  if (jumanji_db_fuzzy_init(&fuzzy, input) == false) {
+    return -1;
+  }
+
+  return jumanji_db_fuzzy_score_link(&fuzzy, url, title);
+}
+
+unsigned int
+jumanji_db_revision(jumanji_database_t* database)
+{
+  if (database == NULL) {
+    return 0;
+  }
+
+  return g_atomic_int_get(&database->revision);
+}
+
+void
+jumanji_db_history_clean(jumanji_database_t* database, unsigned int age)
+{
+  if (database == NULL) {
+    return;
+  }
+
+  jumanji_db_mutation_t* mutation = jumanji_db_mutation_new(HISTORY_CLEAN, NULL, NULL);
+  mutation->age = age;
+
+  jumanji_db_queue(database, mutation);
+}
+
+void
+jumanji_db_history_expire(jumanji_database_t* database, unsigned int age,
+    unsigned int size)
+{
+  if (database == NULL) {
+    return;
+  }
+
+  jumanji_db_job_t* job = g_malloc0(sizeof(jumanji_db_job_t));
+  job->type = JOB_EXPIRE;
+  job->age  = age;
+  job->size = size;
+
+  jumanji_db_job_push(database, job);
+}
+
+void
+jumanji_db_quickmark_add(jumanji_database_t* database, const char identifier, const char* url)
+{
+  if (database == NULL || url == NULL) {
+    return;
+  }
+
+  jumanji_db_mutation_t* mutation = jumanji_db_mutation_new(QUICKMARK_ADD, url, NULL);
+  mutation->identifier = identifier;
+
+  jumanji_db_queue(database, mutation);
+}
+
+char*
+jumanji_db_quickmark_find(jumanji_database_t* database, const char identifier)
+{
+  if (database == NULL) {
+    return NULL;
+  }
+
+  jumanji_db_flush(database);
+
+  jumanji_db_job_t job = { .type = JOB_QUICKMARK_FIND, .identifier = identifier };
+
+  return jumanji_db_job_wait(database, &job);
+}
+
+void
+jumanji_db_quickmark_find_async(jumanji_database_t* database, const char
+    identifier, jumanji_db_quickmark_callback_t callback, void* data)
+{
+  if (database == NULL || callback == NULL) {
+    return;
+  }
+
+  jumanji_db_flush(database);
+
+  jumanji_db_job_t* job = g_malloc0(sizeof(jumanji_db_job_t));
+
+  job->type               = JOB_QUICKMARK_FIND;
+  job->identifier         = identifier;
+  job->quickmark_callback = callback;
+  job->user_data          = data;
+
+  jumanji_db_job_push(database, job);
+}
+
+void
+jumanji_db_quickmark_remove(jumanji_database_t* database, const char identifier)
+{
+  if (database == NULL) {
+    return;
+  }
+
+  jumanji_db_mutation_t* mutation = jumanji_db_mutation_new(QUICKMARK_REMOVE, NULL, NULL);
+  mutation->identifier = identifier;
+
+  jumanji_db_queue(database, mutation);
+}
+
+void
+jumanji_db_save_session(jumanji_database_t* database, const char* name, girara_list_t* urls)
+{
+  if (database == NULL || name == NULL) {
+    return;
+  }
+
+  jumanji_db_flush(database);
+
+  jumanji_db_job_t job = { .type = JOB_SAVE_SESSION, .input = (char*) name,
+    .urls = urls };
+  jumanji_db_job_wait(database, &job);
+}
+
+girara_list_t*
+jumanji_db_load_session(jumanji_database_t* database, const char* name)
+{
+  if (database == NULL || name == NULL) {
+    return NULL;
+  }
+
+  jumanji_db_flush(database);
+
+  jumanji_db_job_t job = { .type = JOB_LOAD_SESSION, .input = (char*) name };
+
+  return jumanji_db_job_wait(database, &job);
+}
+
+bool
+jumanji_db_import(jumanji_database_t* database, const char* dir)
+{
+  if (database == NULL || dir == NULL || database->backend->import == NULL) {
+    return false;
+  }
+
+  /* write pending mutations first, imported links never replace newer visits */
+  jumanji_db_flush(database);
+  g_atomic_int_inc(&database->revision);
+
+  jumanji_db_job_t job = { .type = JOB_IMPORT, .input = (char*) dir };
+
+  return jumanji_db_job_wait(database, &job) != NULL;
+}
 
 void
 jumanji_db_free_result_link(void* data)
@@ -14,6 +14,35 @@ typedef struct jumanji_db_result_link_s
   int visited; /**> Last time the link has been visited */
 } jumanji_db_result_link_t;
 
+/**
+ * Receives matching links one by one
+ *
+ * @param url The url of the link, only valid during the call
+ * @param title The title of the link, may be NULL, only valid during the call
+ * @param visited Last time the link has been visited
+ * @param data Custom data
+ * @return false to stop the search
+ */
+typedef bool (*jumanji_db_link_function_t)(const char* url, const char* title,
+    int visited, void* data);
+
+/**
+ * Receives the result of an asynchronous search
+ *
+ * @param results List of jumanji_db_result_link_t, owned by the callback, or
+ *        NULL if an error occured or the search has been cancelled
+ * @param data Custom data
+ */
+typedef void (*jumanji_db_find_callback_t)(girara_list_t* results, void* data);
+
+/**
+ * Receives the result of an asynchronous quickmark lookup
+ *
+ * @param url Url of the quickmark, owned by the callback, or NULL
+ * @param data Custom data
+ */
+typedef void (*jumanji_db_quickmark_callback_t)(char* url, void* data);
+
 /**
  * Creates a new database object
  *
@@ -22,6 +51,14 @@ typedef struct jumanji_db_result_link_s
  */
 jumanji_database_t* jumanji_db_init(const char* dir);
 
+/**
+ * Creates a new database object that keeps all data in memory and never
+ * touches the disk
+ *
+ * @return Database object or NULL if an error occured
+ */
+jumanji_database_t* jumanji_db_init_ephemeral(void);
+
 /**
  * Check if files in the old location still exist
  *
@@ -56,6 +93,77 @@ void jumanji_db_bookmark_add(jumanji_database_t* database, const char* url, cons
  */
 girara_list_t* jumanji_db_bookmark_find(jumanji_database_t* database, const char* input);
 
+/**
+ * Calls a function for every bookmark that matches the input, without copying
+ * the bookmarks. The function is called from the database thread while the
+ * caller waits, so it must not use the database itself.
+ *
+ * @param session The databases session
+ * @param input The data that the bookmark should match
+ * @param limit Maximal number of bookmarks, 0 for no limit
+ * @param function Receives the bookmarks
+ * @param data Custom data passed to the function
+ */
+void jumanji_db_bookmark_match(jumanji_database_t* database, const char* input,
+    unsigned int limit, jumanji_db_link_function_t function, void* data);
+
+/**
+ * Like jumanji_db_bookmark_match, but fills up the bookmarks that match the input
+ * with the bookmarks that contain its characters in order, regardless of case.
+ * The latter are passed after the former, the best ones first. They are only
+ * looked for among as many bookmarks as can be scanned in a few milliseconds,
+ * jumanji_db_bookmark_find_fuzzy_async scans all of them.
+ *
+ * @param session The databases session
+ * @param input The data that the bookmark should match
+ * @param limit Maximal number of bookmarks, 0 for no limit
+ * @param function Receives the bookmarks
+ * @param data Custom data passed to the function
+ * @return false if the time ran out before all bookmarks were scanned
+ */
+bool jumanji_db_bookmark_match_fuzzy(jumanji_database_t* database, const char*
+    input, unsigned int limit, jumanji_db_link_function_t function, void*
+    data);
+
+/**
+ * Checks if a url is bookmarked
+ *
+ * @param session The databases session
+ * @param url The exact url of the bookmark
+ * @return true if the url is bookmarked
+ */
+bool jumanji_db_bookmark_exists(jumanji_database_t* database, const char* url);
+
+/**
+ * Find bookmarks without blocking, the callback is invoked from the main loop.
+ * A cancelled search stops as soon as possible, its callback is still invoked.
+ *
+ * @param session The databases session
+ * @param input The data that the bookmark should match
+ * @param limit Maximal number of bookmarks, 0 for no limit
+ * @param cancellable Cancels the search, may be NULL
+ * @param callback Receives the results
+ * @param data Custom data passed to the callback
+ */
+void jumanji_db_bookmark_find_async(jumanji_database_t* database, const char* input,
+    unsigned int limit, GCancellable* cancellable, jumanji_db_find_callback_t
+    callback, void* data);
+
+/**
+ * Like jumanji_db_bookmark_find_async, but finds the bookmarks of
+ * jumanji_db_bookmark_match_fuzzy
+ *
+ * @param session The databases session
+ * @param input The data that the bookmark should match
+ * @param limit Maximal number of bookmarks, 0 for no limit
+ * @param cancellable Cancels the search, may be NULL
+ * @param callback Receives the results
+ * @param data Custom data passed to the callback
+ */
+void jumanji_db_bookmark_find_fuzzy_async(jumanji_database_t* database, const char*
+    input, unsigned int limit, GCancellable* cancellable,
+    jumanji_db_find_callback_t callback, void* data);
+
 /**
  * Removes a saved bookmark
  *
@@ -83,13 +191,127 @@ void jumanji_db_history_add(jumanji_database_t* database, const char* url, const
 girara_list_t* jumanji_db_history_find(jumanji_database_t* database, const char* input);
 
 /**
- * Cleans the history
+ * Calls a function for every history item that matches the input, without
+ * copying the items. The function is called from the database thread while
+ * the caller waits, so it must not use the database itself.
+ *
+ * @param session The databases session
+ * @param input The data that the history item should match
+ * @param limit Maximal number of history items, 0 for no limit
+ * @param function Receives the history items
+ * @param data Custom data passed to the function
+ */
+void jumanji_db_history_match(jumanji_database_t* database, const char* input,
+    unsigned int limit, jumanji_db_link_function_t function, void* data);
+
+/**
+ * Like jumanji_db_history_match, but fills up the history items that match the input
+ * with the history items that contain its characters in order, regardless of case.
+ * The latter are passed after the former, the best ones first. They are only
+ * looked for among as many history items as can be scanned in a few
+ * milliseconds, the most recent or frecent first,
+ * jumanji_db_history_find_fuzzy_async scans all of them.
+ *
+ * @param session The databases session
+ * @param input The data that the history item should match
+ * @param limit Maximal number of history items, 0 for no limit
+ * @param function Receives the history items
+ * @param data Custom data passed to the function
+ * @return false if the time ran out before all history items were scanned
+ */
+bool jumanji_db_history_match_fuzzy(jumanji_database_t* database, const char*
+    input, unsigned int limit, jumanji_db_link_function_t function, void*
+    data);
+
+/**
+ * Find history without blocking, the callback is invoked from the main loop.
+ * A cancelled search stops as soon as possible, its callback is still invoked.
+ *
+ * @param session The databases session
+ * @param input The data that the history item should match
+ * @param limit Maximal number of history items, 0 for no limit
+ * @param cancellable Cancels the search, may be NULL
+ * @param callback Receives the results
+ * @param data Custom data passed to the callback
+ */
+void jumanji_db_history_find_async(jumanji_database_t* database, const char* input,
+    unsigned int limit, GCancellable* cancellable, jumanji_db_find_callback_t
+    callback, void* data);
+
+/**
+ * Like jumanji_db_history_find_async, but finds the history items of
+ * jumanji_db_history_match_fuzzy
+ *
+ * @param session The databases session
+ * @param input The data that the history item should match
+ * @param limit Maximal number of history items, 0 for no limit
+ * @param cancellable Cancels the search, may be NULL
+ * @param callback Receives the results
+ * @param data Custom data passed to the callback
+ */
+void jumanji_db_history_find_fuzzy_async(jumanji_database_t* database, const char*
+    input, unsigned int limit, GCancellable* cancellable,
+    jumanji_db_find_callback_t callback, void* data);
+
+/**
+ * Checks if a link matches an input the way the searches of the database
+ * match it, for example to narrow down earlier results
+ *
+ * @param session The databases session
+ * @param url The url of the link
+ * @param title The title of the link, may be NULL
+ * @param input The data that the link should match
+ * @return true if the link matches the input
+ */
+bool jumanji_db_link_matches(jumanji_database_t* database, const char* url,
+    const char* title, const char* input);
+
+/**
+ * Scores how well a link matches an input the way the fuzzy searches of the
+ * database score it
+ *
+ * @param session The databases session
+ * @param url The url of the link
+ * @param title The title of the link, may be NULL
+ * @param input The data that the link should match
+ * @return The score or -1 if the link does not contain the characters of the
+ *         input in order
+ */
+int jumanji_db_link_score(jumanji_database_t* database, const char* url,
+    const char* title, const char* input);
+
+/**
+ * Returns a number that changes whenever this database session adds or
+ * removes data, so that results of earlier searches can be checked for
+ * staleness
+ *
+ * @param session The databases session
+ * @return The current revision
+ */
+unsigned int jumanji_db_revision(jumanji_database_t* database);
+
+/**
+ * Removes the history entries that have not been visited for age seconds
  *
  * @param session The database session
  * @param age The age of the entries in seconds
  */
 void jumanji_db_history_clean(jumanji_database_t* database, unsigned int age);
 
+/**
+ * Keeps the history within the given limits. Entries that have not been
+ * visited for age seconds and all but the size most frecent entries are
+ * removed in small chunks whenever the database is idle, now and
+ * periodically afterwards. Backends without chunked expiry only limit the
+ * age, they remove the old entries at once.
+ *
+ * @param session The database session
+ * @param age The maximal age of the entries in seconds, 0 for no limit
+ * @param size The maximal number of entries, 0 for no limit
+ */
+void jumanji_db_history_expire(jumanji_database_t* database, unsigned int age,
+    unsigned int size);
+
 /**
  * Saves a new quickmark (or overwrites an existing one)
  *
@@ -108,6 +330,18 @@ void jumanji_db_quickmark_add(jumanji_database_t* database, const char identifie
  */
 char* jumanji_db_quickmark_find(jumanji_database_t* database, const char identifier);
 
+/**
+ * Finds a quickmark without blocking, the callback is invoked from the main
+ * loop
+ *
+ * @param session The database session
+ * @param identifier The quickmark identifier
+ * @param callback Receives the url of the quickmark
+ * @param data Custom data passed to the callback
+ */
+void jumanji_db_quickmark_find_async(jumanji_database_t* database, const char identifier,
+    jumanji_db_quickmark_callback_t callback, void* data);
+
 /**
  * Remove a quickmark
  *
@@ -140,4 +374,14 @@ void jumanji_db_save_session(jumanji_database_t* database, const char* name, gir
  */
 girara_list_t* jumanji_db_load_session(jumanji_database_t* database, const char* name);
 
+/**
+ * Imports bookmarks, history, quickmarks and sessions that were stored by the
+ * plain backend
+ *
+ * @param database The database session
+ * @param dir Directory of the plain files
+ * @return true if no error occured
+ */
+bool jumanji_db_import(jumanji_database_t* database, const char* dir);
+
 #endif // DATABASE_H
@@ -11,6 +11,7 @@
 
 #include "adblock.h"
 #include "callbacks.h"
+#include "completion.h"
 #include "soup.h"
 #include "config.h"
 #include "database.h"
@@ -30,14 +31,22 @@
 #define JUMANJI_SESSION_DIR          "sessions"
 #define JUMANJI_DEFAULT_SESSION_FILE "default_session"
 
+/* characters that g_shell_parse_argv treats specially within a word */
+#define SHELL_CHARACTERS " \t\n\r'\"\\"
+
+/* forward declarations */
+static char* jumanji_build_url_from_input(const char* input);
+
 jumanji_t*
 jumanji_init(int argc, char* argv[])
 {
   /* parse command line options */
   gchar* config_dir = NULL, *data_dir = NULL;
+  gboolean ephemeral = FALSE;
   GOptionEntry entries[] = {
     { "config-dir", 'c', 0, G_OPTION_ARG_FILENAME, &config_dir, "Path to the config directory", "path" },
     { "data-dir",   'd', 0, G_OPTION_ARG_FILENAME, &data_dir,   "Path to the data directory",   "path" },
+    { "private",    'p', 0, G_OPTION_ARG_NONE,     &ephemeral,  "Keep history, bookmarks and sessions in memory only", NULL },
     { NULL }
   };
 
@@ -103,6 +112,10 @@ jumanji_init(int argc, char* argv[])
 
   girara_list_set_free_function(jumanji->global.search_engines, jumanji_search_engine_free);
 
+  /* both indices point to the search engines of the list */
+  jumanji->global.search_engine_index = g_hash_table_new(g_str_hash, g_str_equal);
+  jumanji->global.search_engine_order = g_ptr_array_new();
+
   jumanji->global.proxies = girara_list_new();
   if (jumanji->global.proxies == NULL) {
     goto error_free;
@@ -193,6 +206,7 @@ jumanji_init(int argc, char* argv[])
   /* connect additional signals */
   g_signal_connect(G_OBJECT(jumanji->ui.session->gtk.tabs), "switch-page",  G_CALLBACK(cb_jumanji_tab_changed), jumanji);
   g_signal_connect(G_OBJECT(jumanji->ui.session->gtk.tabs), "page-removed", G_CALLBACK(cb_jumanji_tab_removed), jumanji);
+  g_signal_connect(G_OBJECT(jumanji->ui.session->gtk.inputbar_entry), "changed", G_CALLBACK(cb_jumanji_inputbar_changed), jumanji);
 
   /* statusbar */
   jumanji->ui.statusbar.url = girara_statusbar_item_add(jumanji->ui.session, TRUE, TRUE, TRUE, NULL);
@@ -231,18 +245,26 @@ jumanji_init(int argc, char* argv[])
   }
 
   /* database */
-  if (jumanji_db_check_location(jumanji->config.config_dir) == true) {
+  if (ephemeral == FALSE &&
+      jumanji_db_check_location(jumanji->config.config_dir) == true) {
     girara_warning("Data files have been detected in the old data directory "
         "%s. Please move them to the new data directory %s.",
         jumanji->config.config_dir, jumanji->config.data_dir);
   }
 
-  jumanji->database = jumanji_db_init(jumanji->config.data_dir);
+  if (ephemeral == TRUE) {
+    jumanji->database = jumanji_db_init_ephemeral();
+  } else {
+    jumanji->database = jumanji_db_init(jumanji->config.data_dir);
+  }
   if (jumanji->database == NULL) {
     girara_error("Could not initialize database");
     goto error_free;
   }
 
+  /* history limits, later changes are applied by the setting callback */
+  cb_settings_history(jumanji->ui.session, NULL, INT, NULL, NULL);
+
   /* custom stylesheet */
   char* user_stylesheet_uri = NULL;
   girara_setting_get(jumanji->ui.session, "user-stylesheet-uri", &user_stylesheet_uri);
@@ -344,6 +366,14 @@ jumanji_free(jumanji_t* jumanji)
   }
 
   /* free search engines */
+  if (jumanji->global.search_engine_index != NULL) {
+    g_hash_table_destroy(jumanji->global.search_engine_index);
+  }
+
+  if (jumanji->global.search_engine_order != NULL) {
+    g_ptr_array_free(jumanji->global.search_engine_order, TRUE);
+  }
+
   girara_list_free(jumanji->global.search_engines);
 
   /* free proxies */
@@ -366,6 +396,18 @@ jumanji_free(jumanji_t* jumanji)
     jumanji_db_free(jumanji->database);
   }
 
+  /* free completion cache, a running prefetch only finds it cancelled */
+  cc_open_cancel(jumanji);
+  g_free(jumanji->completion.input);
+
+  if (jumanji->completion.bookmarks != NULL) {
+    g_ptr_array_free(jumanji->completion.bookmarks, TRUE);
+  }
+
+  if (jumanji->completion.history != NULL) {
+    g_ptr_array_free(jumanji->completion.history, TRUE);
+  }
+
   /* free user stylesheet uri */
   if (jumanji->global.user_stylesheet_uri) {
     g_free(jumanji->global.user_stylesheet_uri);
@@ -549,6 +591,15 @@ jumanji_build_url_from_string(jumanji_t* jumanji, const char* string)
     return NULL;
   }
 
+  /* a single word that is no search does not need to be split up */
+  if (string[0] != '\0' && string[0] != '#' && strpbrk(string,
+        SHELL_CHARACTERS) == NULL) {
+    char* url = jumanji_build_url_from_input(string);
+    if (url != NULL) {
+      return url;
+    }
+  }
+
   girara_list_t* list = build_girara_list(string);
   if (list == NULL) {
     return NULL;
@@ -587,20 +638,10 @@ jumanji_build_url(jumanji_t* jumanji, girara_list_t* list)
 
     /* search matching search engine */
     if (girara_list_size(jumanji->global.search_engines) > 0) {
-      girara_list_iterator_t* iter = girara_list_iterator(jumanji->global.search_engines);
-      do {
-        jumanji_search_engine_t* search_engine = (jumanji_search_engine_t*) girara_list_iterator_data(iter);
-
-        if (search_engine == NULL) {
-          continue;
-        }
-
-        if (!g_strcmp0(search_engine->identifier, identifier)) {
-          search_url = g_strdup(search_engine->url);
-          break;
-        }
-      } while (girara_list_iterator_next(iter));
-      girara_list_iterator_free(iter);
+      jumanji_search_engine_t* search_engine = jumanji_search_engine_find(jumanji, identifier);
+      if (search_engine != NULL) {
+        search_url = g_strdup(search_engine->url);
+      }
 
       /* if no search engine matches, we use the default one (first one) */
       if (search_url == NULL) {
@@ -622,15 +663,11 @@ jumanji_build_url(jumanji_t* jumanji, girara_list_t* list)
   } else {
     char* input = (char*) girara_list_nth(list, 0);
 
-    /* file path */
-    if (input[0] == '/' || strncmp(input, "./", 2) == 0) {
-      url = g_strconcat("file://", input, NULL);
-    /* special case: about: */
-    } else if (strncmp(input, "about:", 6) == 0) {
-      url = g_strdup(input);
+    url = jumanji_build_url_from_input(input);
+
     /* uri does not contain any '.', ':', '/' nor starts with localhost so the default
      * search engine will be used */
-    } else if (strpbrk(input, ".:/") == NULL && strncmp(input, "localhost", 9) != 0 ) {
+    if (url == NULL) {
       if (girara_list_size(jumanji->global.search_engines) > 0) {
         jumanji_search_engine_t* search_engine = (jumanji_search_engine_t*) girara_list_nth(jumanji->global.search_engines, 0);
         char* search_url = search_engine ? g_strdup(search_engine->url) : NULL;
@@ -642,15 +679,30 @@ jumanji_build_url(jumanji_t* jumanji, girara_list_t* list)
       } else {
         girara_notify(jumanji->ui.session, GIRARA_WARNING, "Could not process input. No search engine has been defined.");
       }
-    /* just use the url as it is */
-    } else {
-      url = strstr(input, "://") ? g_strdup(input) : g_strconcat("http://", input, NULL);
     }
   }
 
   return url;
 }
 
+static char*
+jumanji_build_url_from_input(const char* input)
+{
+  /* file path */
+  if (input[0] == '/' || strncmp(input, "./", 2) == 0) {
+    return g_strconcat("file://", input, NULL);
+  /* special case: about: */
+  } else if (strncmp(input, "about:", 6) == 0) {
+    return g_strdup(input);
+  /* a search for the default search engine */
+  } else if (strpbrk(input, ".:/") == NULL && strncmp(input, "localhost", 9) != 0 ) {
+    return NULL;
+  }
+
+  /* just use the url as it is */
+  return strstr(input, "://") ? g_strdup(input) : g_strconcat("http://", input, NULL);
+}
+
 char*
 jumanji_build_search_engine_url(const char* search_url, girara_list_t* list, bool all_arguments)
 {
@@ -704,6 +756,98 @@ jumanji_last_closed_free(void* data)
   free(data);
 }
 
+bool
+jumanji_search_engine_add(jumanji_t* jumanji, const char* identifier, const
+    char* url)
+{
+  if (jumanji == NULL || identifier == NULL || url == NULL ||
+      jumanji->global.search_engines == NULL) {
+    return false;
+  }
+
+  /* change existing search engine */
+  jumanji_search_engine_t* search_engine = jumanji_search_engine_find(jumanji, identifier);
+  if (search_engine != NULL) {
+    g_free(search_engine->url);
+    search_engine->url = g_strdup(url);
+    return true;
+  }
+
+  /* create new entry */
+  search_engine = malloc(sizeof(jumanji_search_engine_t));
+  if (search_engine == NULL) {
+    return false;
+  }
+
+  search_engine->url        = g_strdup(url);
+  search_engine->identifier = g_strdup(identifier);
+
+  girara_list_append(jumanji->global.search_engines, search_engine);
+  g_hash_table_insert(jumanji->global.search_engine_index,
+      search_engine->identifier, search_engine);
+
+  /* keep the order sorted, search engines are only added while the
+   * configuration is read */
+  unsigned int position = 0;
+  jumanji_search_engine_prefix(jumanji, identifier, &position);
+  g_ptr_array_add(jumanji->global.search_engine_order, NULL);
+
+  GPtrArray* order = jumanji->global.search_engine_order;
+  memmove(&order->pdata[position + 1], &order->pdata[position], (order->len -
+        position - 1) * sizeof(gpointer));
+  order->pdata[position] = search_engine;
+
+  return true;
+}
+
+jumanji_search_engine_t*
+jumanji_search_engine_find(jumanji_t* jumanji, const char* identifier)
+{
+  if (jumanji == NULL || identifier == NULL ||
+      jumanji->global.search_engine_index == NULL) {
+    return NULL;
+  }
+
+  return g_hash_table_lookup(jumanji->global.search_engine_index, identifier);
+}
+
+unsigned int
+jumanji_search_engine_prefix(jumanji_t* jumanji, const char* prefix, unsigned
+    int* first)
+{
+  if (jumanji == NULL || prefix == NULL || first == NULL ||
+      jumanji->global.search_engine_order == NULL) {
+    return 0;
+  }
+
+  GPtrArray* order = jumanji->global.search_engine_order;
+
+  /* the first identifier that is not smaller than the prefix */
+  unsigned int begin = 0;
+  unsigned int end   = order->len;
+  while (begin < end) {
+    unsigned int middle = begin + (end - begin) / 2;
+    jumanji_search_engine_t* search_engine = g_ptr_array_index(order, middle);
+    if (strcmp(search_engine->identifier, prefix) < 0) {
+      begin = middle + 1;
+    } else {
+      end = middle;
+    }
+  }
+
+  *first = begin;
+
+  size_t length = strlen(prefix);
+  for (end = begin; end < order->len; end++) {
+    jumanji_search_engine_t* search_engine = g_ptr_array_index(order, end);
+    if (strncmp(search_engine->identifier, prefix, length) != 0) {
+      break;
+    }
+  }
+
+  return end - begin;
+}
+
 void
 jumanji_search_engine_free(void* data)
 {
@@ -52,7 +52,9 @@ typedef struct jumanji_s
   {
     WebKitWebSettings* browser_settings; /*>> Browser settings */
     gchar* user_stylesheet_uri;
-    girara_list_t* search_engines; /**> Search engines */
+    girara_list_t* search_engines; /**> Search engines, the default one first */
+    GHashTable* search_engine_index; /**> Search engines by identifier */
+    GPtrArray* search_engine_order; /**> Search engines sorted by identifier */
     girara_list_t* proxies; /**> Proxies */
     girara_list_t* marks; /**> Marker */
     girara_list_t* last_closed; /**> Last closed tabs */
@@ -87,6 +89,19 @@ typedef struct jumanji_s
     GString* input; /**> Input buffer */
   } hints;
 
+  struct
+  {
+    char* input; /**> Input of the previous completion */
+    unsigned int revision; /**> Database revision of the previous completion */
+    bool partial; /**> The previous completion did not scan all links */
+    GPtrArray* bookmarks; /**> Bookmarks of the previous completion */
+    GPtrArray* history; /**> History items of the previous completion */
+    char* pending; /**> Input that is prefetched once typing pauses */
+    guint timeout; /**> Timeout that starts the prefetch */
+    unsigned int generation; /**> Changed whenever a prefetch is superseded */
+    GCancellable* cancellable; /**> Cancels the running prefetch */
+  } completion;
+
   jumanji_database_t* database; /**> The database */
 } jumanji_t;
 
@@ -215,6 +230,39 @@ void jumanji_window_new(jumanji_t* jumanji, char* uri);
  */
 void jumanji_last_closed_free(void* data);
 
+/**
+ * Adds a search engine or changes the url of an existing one
+ *
+ * @param jumanji The jumanji session
+ * @param identifier Identifier of the search engine
+ * @param url Search url that contains %s
+ * @return true if no error occured
+ */
+bool jumanji_search_engine_add(jumanji_t* jumanji, const char* identifier,
+    const char* url);
+
+/**
+ * Finds a search engine
+ *
+ * @param jumanji The jumanji session
+ * @param identifier Identifier of the search engine
+ * @return The search engine or NULL if it does not exist
+ */
+jumanji_search_engine_t* jumanji_search_engine_find(jumanji_t* jumanji, const
+    char* identifier);
+
+/**
+ * Finds the search engines whose identifiers start with a prefix, they are
+ * consecutive in jumanji->global.search_engine_order
+ *
+ * @param jumanji The jumanji session
+ * @param prefix The prefix
+ * @param first Set to the position of the first matching search engine
+ * @return Number of matching search engines
+ */
+unsigned int jumanji_search_engine_prefix(jumanji_t* jumanji, const char*
+    prefix, unsigned int* first);
+
 /**
  * Free a search engine
  *
@@ -426,15 +426,13 @@ sc_toggle_bookmark(girara_session_t* session, girara_argument_t* argument, girar
 
   gchar* escaped_url = g_markup_escape_text(url, -1);
 
-  girara_list_t* results = jumanji_db_bookmark_find(jumanji->database, url);
-  if (results && girara_list_size(results) > 0) {
+  if (jumanji_db_bookmark_exists(jumanji->database, url) == true) {
     jumanji_db_bookmark_remove(jumanji->database, url);
     girara_notify(session, GIRARA_INFO, "Removed bookmark: %s", escaped_url);
   } else {
     jumanji_db_bookmark_add(jumanji->database, url, title);
     girara_notify(session, GIRARA_INFO, "Added bookmark: %s", escaped_url);
   }
-  girara_list_free(results);
   g_free(escaped_url);
 
   return false;